@@ -0,0 +1,206 @@
+#include "aggregates.h"
+#include <QDebug>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QSqlRecord>
+
+namespace {
+// 按源表现算的汇总，重建和校验共用
+QString appointmentCountsSql()
+{
+    return QString("SELECT doctor_id, %1, COALESCE(status, ''), COUNT(*) FROM appointments GROUP BY 1, 2, 3")
+        .arg(Aggregates::localDaySql("scheduled_at"));
+}
+
+const char *const kMedicationCountsSql =
+    "SELECT medication_name, COUNT(*) FROM prescriptions GROUP BY medication_name";
+
+// 汇总表与源表并在一起分组，两边计数不同的就是不一致的行：每个源表只扫一遍
+QString appointmentDiffSql()
+{
+    return QString(R"(
+        SELECT doctor_id, day, status, SUM(stored), SUM(expected)
+        FROM (SELECT doctor_id, day, status, n AS stored, 0 AS expected FROM stats_appointments_daily
+              UNION ALL
+              SELECT doctor_id, %1, COALESCE(status, ''), 0, 1 FROM appointments)
+        GROUP BY 1, 2, 3
+        HAVING SUM(stored) <> SUM(expected)
+    )").arg(Aggregates::localDaySql("scheduled_at"));
+}
+
+const char *const kMedicationDiffSql = R"(
+        SELECT medication_name, SUM(stored), SUM(expected)
+        FROM (SELECT medication_name, n AS stored, 0 AS expected FROM stats_medications
+              UNION ALL
+              SELECT medication_name, 0, 1 FROM prescriptions)
+        GROUP BY 1
+        HAVING SUM(stored) <> SUM(expected)
+    )";
+
+const char *const kIcdDiffSql = R"(
+        SELECT code, SUM(stored), SUM(expected)
+        FROM (SELECT code, n AS stored, 0 AS expected FROM stats_icd_codes
+              UNION ALL
+              SELECT code, 0, 1 FROM diagnosis_codes)
+        GROUP BY 1
+        HAVING SUM(stored) <> SUM(expected)
+    )";
+
+// v8 的 migration step 也调用 rebuild()，那时还没有 diagnosis_codes（v9 才建）
+bool hasDiagnosisCodes(QSqlDatabase &db)
+{
+    QSqlQuery q(db);
+    return q.exec("SELECT 1 FROM sqlite_master WHERE type = 'table' AND name = 'diagnosis_codes'") && q.next();
+}
+
+// 按 icd_codes 重新拆分。清空和写入时 stats_icd_codes 的触发器照常增减，之后整表重算，不影响结果
+bool rebuildDiagnosisCodes(QSqlDatabase &db)
+{
+    QSqlQuery q(db);
+    if (!q.exec("DELETE FROM diagnosis_codes")) {
+        qWarning() << "rebuild diagnosis codes: clear error:" << q.lastError().text();
+        return false;
+    }
+    QSqlQuery rows(db);
+    rows.setForwardOnly(true);
+    if (!rows.exec("SELECT id, patient_id, created_at, icd_codes FROM diagnoses WHERE icd_codes IS NOT NULL")) {
+        qWarning() << "rebuild diagnosis codes: read error:" << rows.lastError().text();
+        return false;
+    }
+    if (!q.prepare("INSERT INTO diagnosis_codes (diagnosis_id, code, patient_id, created_at) VALUES (?, ?, ?, ?)")) {
+        qWarning() << "rebuild diagnosis codes: prepare error:" << q.lastError().text();
+        return false;
+    }
+    while (rows.next()) {
+        for (const QString &code : Aggregates::icdCodes(rows.value(3).toString())) {
+            q.bindValue(0, rows.value(0));
+            q.bindValue(1, code);
+            q.bindValue(2, rows.value(1));
+            q.bindValue(3, rows.value(2));
+            if (!q.exec()) {
+                qWarning() << "rebuild diagnosis codes: insert error:" << q.lastError().text();
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// diagnosis_codes 与按 icd_codes 拆出来的结果比较：两边都按诊断 id 有序读取、逐条诊断归并，内存占用与行数无关
+int diffDiagnosisCodes(QSqlDatabase &db, QStringList *mismatches, int maxMismatches)
+{
+    QSqlQuery d(db);
+    d.setForwardOnly(true);
+    QSqlQuery c(db);
+    c.setForwardOnly(true);
+    if (!d.exec("SELECT id, patient_id, created_at, COALESCE(icd_codes, '') FROM diagnoses ORDER BY id")
+        || !c.exec("SELECT diagnosis_id, code, patient_id, created_at FROM diagnosis_codes ORDER BY diagnosis_id, code")) {
+        qWarning() << "verify diagnosis_codes error:" << d.lastError().text() << c.lastError().text();
+        return -1;
+    }
+    int count = 0;
+    auto note = [&](qint64 id, const QString &what) {
+        if (mismatches && mismatches->size() < maxMismatches)
+            *mismatches << QString("diagnosis_codes (%1): %2").arg(QString::number(id), what);
+        ++count;
+    };
+    bool more = c.next();
+    while (d.next()) {
+        const qint64 id = d.value(0).toLongLong();
+        // 诊断已经不在了的行
+        for (; more && c.value(0).toLongLong() < id; more = c.next())
+            note(c.value(0).toLongLong(), "orphan " + c.value(1).toString());
+        QStringList expected = Aggregates::icdCodes(d.value(3).toString());
+        expected.sort();
+        QStringList stored;
+        bool stale = false;
+        for (; more && c.value(0).toLongLong() == id; more = c.next()) {
+            stored << c.value(1).toString();
+            if (c.value(2) != d.value(1) || c.value(3) != d.value(2)) stale = true;
+        }
+        if (stored != expected)
+            note(id, QString("stored %1, expected %2").arg(stored.join(','), expected.join(',')));
+        else if (stale)
+            note(id, "stale patient_id / created_at");
+    }
+    for (; more; more = c.next())
+        note(c.value(0).toLongLong(), "orphan " + c.value(1).toString());
+    return count;
+}
+
+// 结果的最后两列是 汇总表里的值、现算的值，前面是键
+int collectDiffs(QSqlDatabase &db, const char *table, const QString &sql, QStringList *mismatches, int maxMismatches)
+{
+    QSqlQuery q(db);
+    q.setForwardOnly(true);
+    if (!q.exec(sql)) {
+        qWarning() << "verify" << table << "error:" << q.lastError().text();
+        return -1;
+    }
+    const int keys = q.record().count() - 2;
+    int count = 0;
+    while (q.next()) {
+        if (mismatches && mismatches->size() < maxMismatches) {
+            QStringList key;
+            for (int i = 0; i < keys; ++i) key << q.value(i).toString();
+            *mismatches << QString("%1 (%2): stored %3, expected %4")
+                               .arg(table, key.join(", "), q.value(keys).toString(), q.value(keys + 1).toString());
+        }
+        ++count;
+    }
+    return count;
+}
+}
+
+QStringList Aggregates::icdCodes(const QString &text)
+{
+    QStringList codes;
+    for (QString code : text.split(QLatin1Char(','))) {
+        code.remove(QLatin1Char(' '));
+        code = code.toUpper();
+        if (!code.isEmpty() && !codes.contains(code)) codes << code;
+    }
+    return codes;
+}
+
+QString Aggregates::localDaySql(const QString &column)
+{
+    return QString("CAST(strftime('%s', %1, 'unixepoch', 'localtime') AS INTEGER) / 86400").arg(column);
+}
+
+bool Aggregates::rebuild(QSqlDatabase &db)
+{
+    // 没有 diagnosis_codes 时（v8 升级中）stats_icd_codes 先留空，v9 的 step 建好表后再重建一次
+    const bool codes = hasDiagnosisCodes(db);
+    if (codes && !rebuildDiagnosisCodes(db)) return false;
+    QSqlQuery q(db);
+    QStringList fill = {
+        "DELETE FROM stats_appointments_daily",
+        "INSERT INTO stats_appointments_daily (doctor_id, day, status, n) " + appointmentCountsSql(),
+        "DELETE FROM stats_medications",
+        QString("INSERT INTO stats_medications (medication_name, n) ") + kMedicationCountsSql,
+        "DELETE FROM stats_icd_codes",
+    };
+    if (codes) fill << "INSERT INTO stats_icd_codes (code, n) SELECT code, COUNT(*) FROM diagnosis_codes GROUP BY code";
+    for (const QString &sql : fill) {
+        if (!q.exec(sql)) {
+            qWarning() << "rebuild aggregates error:" << q.lastError().text();
+            return false;
+        }
+    }
+    qDebug() << "aggregates rebuilt";
+    return true;
+}
+
+int Aggregates::verify(QSqlDatabase &db, QStringList *mismatches, int maxMismatches)
+{
+    const int appointments = collectDiffs(db, "stats_appointments_daily", appointmentDiffSql(), mismatches, maxMismatches);
+    if (appointments < 0) return -1;
+    const int medications = collectDiffs(db, "stats_medications", kMedicationDiffSql, mismatches, maxMismatches);
+    if (medications < 0) return -1;
+    const int icd = collectDiffs(db, "stats_icd_codes", kIcdDiffSql, mismatches, maxMismatches);
+    if (icd < 0) return -1;
+    const int codes = diffDiagnosisCodes(db, mismatches, maxMismatches);
+    if (codes < 0) return -1;
+    return appointments + medications + icd + codes;
+}
@@ -0,0 +1,33 @@
+#ifndef AGGREGATES_H
+#define AGGREGATES_H
+#include<QSqlDatabase>
+#include<QString>
+#include<QStringList>
+
+// 管理端统计用的汇总表（schema v8），查询只读汇总表，读取量与结果行数成正比：
+//   stats_appointments_daily  医生 × 日期 × 状态 的预约数
+//   stats_medications         每种药的处方数
+//   stats_icd_codes           每个 ICD 编码的诊断数（一条诊断里同一个编码只算一次）
+//
+// 都由触发器在同一语句里增减，外键级联删掉的行也会触发。诊断的 icd_codes 是逗号分隔的列表，
+// 触发器里拆不开（触发器里不能用 WITH），所以插入时由 Database::execInsert 按 icdCodes() 拆开写进
+// diagnosis_codes（schema v9，一个编码一行），stats_icd_codes 的触发器挂在 diagnosis_codes 上。
+// 绕过 Database 插入诊断、或者直接改了 icd_codes 之后要 rebuild()，verify() 可以检查是否一致。
+//
+// 日期是写入时本机时区的日期（1970-01-01 起的天数，与 date_of_birth 相同），改了时区也要 rebuild()
+class Aggregates
+{
+public:
+    // icd_codes -> 编码列表：逗号分隔，去掉空格，转大写，去重，保持原顺序。写 diagnosis_codes 都经过这里
+    static QStringList icdCodes(const QString &text);
+    // 时间戳列（Unix 秒）-> 本地日期天数的 SQL 表达式，触发器、重建、校验共用
+    static QString localDaySql(const QString &column);
+
+    // 清空并按源表重建 diagnosis_codes 和三张汇总表。调用方负责事务（migration 的 step 也用它）
+    static bool rebuild(QSqlDatabase &db);
+    // 与源表现算的结果逐行比较（diagnosis_codes 与 icd_codes 逐条诊断比较），不一致的行写进 mismatches（最多 maxMismatches 条）。
+    // 返回不一致的行数，出错返回 -1。要扫描全部源表，只用于维护
+    static int verify(QSqlDatabase &db, QStringList *mismatches = nullptr, int maxMismatches = 100);
+};
+
+#endif // AGGREGATES_H
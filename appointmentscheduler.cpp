@@ -0,0 +1,238 @@
+#include "appointmentscheduler.h"
+#include "database.h"
+#include <algorithm>
+#include <vector>
+
+namespace {
+QMutex g_optionsMutex;
+AppointmentScheduler::Options g_options;
+
+QDateTime utc(qint64 secs)
+{
+    return QDateTime::fromSecsSinceEpoch(secs, Qt::UTC);
+}
+}
+
+void AppointmentScheduler::setOptions(const Options &options)
+{
+    QMutexLocker lock(&g_optionsMutex);
+    g_options = options;
+}
+
+AppointmentScheduler &AppointmentScheduler::instance()
+{
+    static AppointmentScheduler inst;
+    return inst;
+}
+
+AppointmentScheduler::AppointmentScheduler()
+{
+    {
+        QMutexLocker lock(&g_optionsMutex);
+        opts = g_options;
+    }
+    opts.slotMinutes = qBound(1, opts.slotMinutes, 24 * 60);
+    opts.dayStartMinute = qBound(0, opts.dayStartMinute, 24 * 60);
+    opts.dayEndMinute = qBound(opts.dayStartMinute, opts.dayEndMinute, 24 * 60);
+    opts.searchDays = qMax(1, opts.searchDays);
+}
+
+bool AppointmentScheduler::overlaps(const Intervals &booked, qint64 start, qint64 end)
+{
+    auto it = booked.upper_bound(start);
+    if (it != booked.end() && it->first < end) return true;
+    if (it != booked.begin() && std::prev(it)->second > start) return true;
+    return false;
+}
+
+// 插入并与相交的区间合并，保持互不重叠（合并后不再知道是哪条预约，取消时整份重新加载）
+void AppointmentScheduler::addInterval(Intervals &booked, qint64 start, qint64 end)
+{
+    auto it = booked.upper_bound(start);
+    if (it != booked.begin()) {
+        auto prev = std::prev(it);
+        if (prev->second >= start) {
+            start = prev->first;
+            end = qMax(end, prev->second);
+            booked.erase(prev);
+        }
+    }
+    while (it != booked.end() && it->first <= end) {
+        end = qMax(end, it->second);
+        it = booked.erase(it);
+    }
+    booked.emplace(start, end);
+}
+
+std::shared_ptr<AppointmentScheduler::DoctorSchedule> AppointmentScheduler::scheduleFor(int doctorId)
+{
+    QMutexLocker lock(&mapMutex);
+    std::shared_ptr<DoctorSchedule> &s = doctors[doctorId];
+    if (!s) s = std::make_shared<DoctorSchedule>();
+    return s;
+}
+
+bool AppointmentScheduler::ensureLoaded(int doctorId, DoctorSchedule &s)
+{
+    if (s.loaded) return true;
+    // 过去的预约不影响排班，只加载最近一天以后的（一天是时长上限）
+    QVector<AppointmentRecord> rows;
+    if (!Database::instance().bookedSlotsForDoctor(doctorId, QDateTime::currentDateTimeUtc().addDays(-1), rows)) return false;
+    s.booked.clear();
+    for (const AppointmentRecord &a : rows) {
+        const qint64 start = a.scheduledAt.toSecsSinceEpoch();
+        addInterval(s.booked, start, start + qint64(qMax(1, a.durationMinutes)) * 60);
+    }
+    s.loaded = true;
+    QMutexLocker lock(&mapMutex);
+    ++counters.loads;
+    return true;
+}
+
+bool AppointmentScheduler::isFree(int doctorId, const QDateTime &start, int durationMinutes)
+{
+    if (durationMinutes <= 0) durationMinutes = opts.slotMinutes;
+    const qint64 s0 = start.toSecsSinceEpoch();
+    std::shared_ptr<DoctorSchedule> s = scheduleFor(doctorId);
+    QMutexLocker lock(&s->mutex);
+    if (!ensureLoaded(doctorId, *s)) return false;
+    return !overlaps(s->booked, s0, s0 + qint64(durationMinutes) * 60);
+}
+
+// 按工作日、工作时间逐个号检查，每个号一次 O(log n)
+QVector<AppointmentScheduler::Slot> AppointmentScheduler::freeSlotsLocked(int doctorId, const DoctorSchedule &s,
+                                                                         const QDateTime &from, int count) const
+{
+    QVector<Slot> out;
+    const qint64 earliest = qMax(from.toSecsSinceEpoch(), QDateTime::currentSecsSinceEpoch());
+    const qint64 slotSecs = qint64(opts.slotMinutes) * 60;
+    QDate day = QDateTime::fromSecsSinceEpoch(earliest).date(); // 本地日期
+    for (int d = 0; d < opts.searchDays && out.size() < count; ++d, day = day.addDays(1)) {
+        if (!(opts.workdayMask & (1 << (day.dayOfWeek() - 1)))) continue;
+        for (int m = opts.dayStartMinute; m + opts.slotMinutes <= opts.dayEndMinute; m += opts.slotMinutes) {
+            const qint64 start = QDateTime(day, QTime(0, 0).addSecs(m * 60), Qt::LocalTime).toSecsSinceEpoch();
+            if (start < earliest || overlaps(s.booked, start, start + slotSecs)) continue;
+            Slot slot;
+            slot.doctorId = doctorId;
+            slot.start = utc(start);
+            slot.end = utc(start + slotSecs);
+            out.append(slot);
+            if (out.size() >= count) break;
+        }
+    }
+    return out;
+}
+
+QVector<AppointmentScheduler::Slot> AppointmentScheduler::nextFreeSlots(int doctorId, const QDateTime &from, int count)
+{
+    if (count <= 0) return QVector<Slot>();
+    std::shared_ptr<DoctorSchedule> s = scheduleFor(doctorId);
+    QMutexLocker lock(&s->mutex);
+    if (!ensureLoaded(doctorId, *s)) return QVector<Slot>();
+    return freeSlotsLocked(doctorId, *s, from, count);
+}
+
+// 每个医生各取前 count 个空档，再按时间归并取前 count 个
+QVector<AppointmentScheduler::Slot> AppointmentScheduler::nextFreeSlotsForSpecialty(const QString &specialty,
+                                                                                   const QDateTime &from, int count)
+{
+    QVector<Slot> all;
+    if (count <= 0) return all;
+    QVector<int> doctorIds;
+    if (!Database::instance().doctorsForSpecialty(specialty, doctorIds)) return all;
+    for (int doctorId : doctorIds) all += nextFreeSlots(doctorId, from, count);
+    std::sort(all.begin(), all.end(), [](const Slot &a, const Slot &b) {
+        return a.start != b.start ? a.start < b.start : a.doctorId < b.doctorId;
+    });
+    if (all.size() > count) all.resize(count);
+    return all;
+}
+
+AppointmentScheduler::BookResult AppointmentScheduler::book(int patientId, int doctorId, const QDateTime &start,
+                                                            const QString &reason, int durationMinutes)
+{
+    BookResult result;
+    if (durationMinutes <= 0) durationMinutes = opts.slotMinutes;
+    if (durationMinutes > 24 * 60 || !start.isValid()) return result;
+    const qint64 s0 = start.toSecsSinceEpoch();
+    const qint64 s1 = s0 + qint64(durationMinutes) * 60;
+    if (s0 < QDateTime::currentSecsSinceEpoch()) {
+        result.status = InPast;
+        return result;
+    }
+
+    std::shared_ptr<DoctorSchedule> s = scheduleFor(doctorId);
+    QMutexLocker lock(&s->mutex); // 同一医生的检查和写入串行
+    if (!ensureLoaded(doctorId, *s)) return result;
+    if (overlaps(s->booked, s0, s1)) {
+        QMutexLocker statsLock(&mapMutex);
+        ++counters.indexConflicts;
+        result.status = Conflict;
+        return result;
+    }
+
+    AppointmentRecord r;
+    r.patientId = patientId;
+    r.doctorId = doctorId;
+    r.scheduledAt = utc(s0);
+    r.durationMinutes = durationMinutes;
+    r.reason = reason;
+    bool conflict = false;
+    if (!Database::instance().insertAppointmentIfFree(r, conflict)) {
+        if (conflict) {
+            // 索引没看到的预约（别的进程或绕过排班写入），重新加载
+            s->loaded = false;
+            ensureLoaded(doctorId, *s);
+            QMutexLocker statsLock(&mapMutex);
+            ++counters.staleConflicts;
+            result.status = Conflict;
+        }
+        return result;
+    }
+    addInterval(s->booked, s0, s1);
+    {
+        QMutexLocker statsLock(&mapMutex);
+        ++counters.bookings;
+    }
+    result.status = Booked;
+    result.appointmentId = r.id;
+    return result;
+}
+
+void AppointmentScheduler::invalidate(int doctorId)
+{
+    std::shared_ptr<DoctorSchedule> s;
+    {
+        QMutexLocker lock(&mapMutex);
+        auto it = doctors.find(doctorId);
+        if (it == doctors.end()) return;
+        s = it->second;
+    }
+    // 不在持有 mapMutex 时拿医生的锁（book() 是先医生锁再 mapMutex）
+    QMutexLocker lock(&s->mutex);
+    s->loaded = false;
+    s->booked.clear();
+}
+
+void AppointmentScheduler::invalidateAll()
+{
+    std::vector<std::shared_ptr<DoctorSchedule>> all;
+    {
+        QMutexLocker lock(&mapMutex);
+        all.reserve(doctors.size());
+        for (const auto &kv : doctors) all.push_back(kv.second);
+    }
+    for (const auto &s : all) {
+        QMutexLocker lock(&s->mutex);
+        s->loaded = false;
+        s->booked.clear();
+    }
+}
+
+AppointmentScheduler::Stats AppointmentScheduler::stats() const
+{
+    QMutexLocker lock(&mapMutex);
+    Stats st = counters;
+    st.cachedDoctors = int(doctors.size());
+    return st;
+}
@@ -0,0 +1,93 @@
+#ifndef APPOINTMENTSCHEDULER_H
+#define APPOINTMENTSCHEDULER_H
+
+#include <QDateTime>
+#include <QMutex>
+#include <QString>
+#include <QVector>
+#include <map>
+#include <memory>
+#include <unordered_map>
+
+// 排班：每个医生一份内存里的已约时段索引（有序、互不重叠的区间，std::map 按开始时间），
+// 冲突检查和找空档都是 O(log n)，不用每次扫 appointments。
+//
+// 索引按医生懒加载（只加载最近一天以后的预约），之后由 book() 同步更新；绕过排班写入的预约
+// （Database::insertAppointment）会让对应医生的索引失效，下次用到时重新加载。
+// book() 持有该医生的锁完成"查索引 -> 事务里再查一次表 -> 写入"，同一医生的并发预约串行，
+// 不同医生互不影响；表里的那次检查保证即使索引过时（别的进程写入）也不会重复预约。
+//
+// 索引里的时间是 Unix 秒，和 appointments.scheduled_at 一致；工作时间按本地时间解释
+class AppointmentScheduler
+{
+public:
+    struct Options {
+        int slotMinutes = 30;
+        int dayStartMinute = 8 * 60;     // 本地时间 08:00
+        int dayEndMinute = 17 * 60;      // 本地时间 17:00（最后一个号的结束时间）
+        int workdayMask = 0x1f;          // bit0 = 周一 ... bit6 = 周日，默认周一到周五
+        int searchDays = 60;             // 找空档最多往后看这么多天
+    };
+    // 要在第一次 instance() 之前设置
+    static void setOptions(const Options &options);
+
+    static AppointmentScheduler &instance();
+    AppointmentScheduler(const AppointmentScheduler &) = delete;
+    AppointmentScheduler &operator=(const AppointmentScheduler &) = delete;
+
+    struct Slot {
+        int doctorId = 0;
+        QDateTime start;
+        QDateTime end;
+    };
+
+    enum BookStatus { Booked, Conflict, InPast, Error };
+    struct BookResult {
+        BookStatus status = Error;
+        int appointmentId = 0;
+    };
+
+    // durationMinutes <= 0 表示 Options::slotMinutes
+    bool isFree(int doctorId, const QDateTime &start, int durationMinutes = 0);
+    QVector<Slot> nextFreeSlots(int doctorId, const QDateTime &from, int count);
+    QVector<Slot> nextFreeSlotsForSpecialty(const QString &specialty, const QDateTime &from, int count);
+    // 检查并预约，可以在任何线程调用
+    BookResult book(int patientId, int doctorId, const QDateTime &start, const QString &reason,
+                    int durationMinutes = 0);
+
+    // 让某个医生（或全部）的索引失效，下次用到时从表里重新加载
+    void invalidate(int doctorId);
+    void invalidateAll();
+
+    struct Stats {
+        quint64 loads = 0;
+        quint64 bookings = 0;
+        quint64 indexConflicts = 0;   // 索引直接判定冲突
+        quint64 staleConflicts = 0;   // 索引说空闲、表里却有冲突（索引过时，已重新加载）
+        int cachedDoctors = 0;
+    };
+    Stats stats() const;
+
+private:
+    typedef std::map<qint64, qint64> Intervals; // 开始 -> 结束（UTC 秒，半开区间）
+
+    struct DoctorSchedule {
+        QMutex mutex;
+        bool loaded = false;
+        Intervals booked;
+    };
+
+    AppointmentScheduler();
+    std::shared_ptr<DoctorSchedule> scheduleFor(int doctorId);
+    bool ensureLoaded(int doctorId, DoctorSchedule &s); // 调用方持有 s.mutex
+    QVector<Slot> freeSlotsLocked(int doctorId, const DoctorSchedule &s, const QDateTime &from, int count) const;
+    static bool overlaps(const Intervals &booked, qint64 start, qint64 end);
+    static void addInterval(Intervals &booked, qint64 start, qint64 end);
+
+    Options opts;
+    mutable QMutex mapMutex;  // 只保护 doctors 本身，不在持有它时访问数据库
+    std::unordered_map<int, std::shared_ptr<DoctorSchedule>> doctors;
+    Stats counters;           // 受 mapMutex 保护
+};
+
+#endif // APPOINTMENTSCHEDULER_H
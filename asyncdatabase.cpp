@@ -0,0 +1,164 @@
+#include "asyncdatabase.h"
+#include "passwordhasher.h"
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QThread>
+
+namespace {
+// 单调时钟，用来算排队和执行耗时
+qint64 nowNs()
+{
+    static QElapsedTimer clock;
+    static std::once_flag started;
+    std::call_once(started, [] { clock.start(); });
+    return clock.nsecsElapsed();
+}
+}
+
+AsyncDatabase &AsyncDatabase::instance()
+{
+    static AsyncDatabase inst;
+    return inst;
+}
+
+AsyncDatabase::AsyncDatabase()
+{
+    worker = QThread::create([this] { workerLoop(); });
+    worker->setObjectName("DatabaseWorker");
+    worker->start();
+}
+
+AsyncDatabase::~AsyncDatabase()
+{
+    shutdown();
+}
+
+void AsyncDatabase::shutdown()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (stopping) return;
+        stopping = true;
+    }
+    cond.notify_all();
+    worker->wait();
+    delete worker;
+    worker = nullptr;
+}
+
+void AsyncDatabase::enqueue(std::function<void(Database &)> run)
+{
+    int depth;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (stopping) {
+            qWarning() << "AsyncDatabase: task dropped after shutdown";
+            return;
+        }
+        queue.push_back(Task{ std::move(run), nowNs() });
+        depth = int(queue.size());
+        st.queueDepth = depth;
+    }
+    cond.notify_one();
+    emit queueDepthChanged(depth);
+}
+
+void AsyncDatabase::workerLoop()
+{
+    // 本线程的连接在第一次 instance() 时打开，线程退出时由 QThreadStorage 关闭
+    Database &db = Database::instance();
+    for (;;) {
+        Task task;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cond.wait(lock, [this] { return stopping || !queue.empty(); });
+            if (queue.empty()) return; // stopping 且已清空
+            task = std::move(queue.front());
+            queue.pop_front();
+            st.queueDepth = int(queue.size());
+        }
+        const qint64 startNs = nowNs();
+        task.run(db);
+        const qint64 endNs = nowNs();
+
+        const qint64 waitUs = (startNs - task.enqueuedNs) / 1000;
+        const qint64 runUs = (endNs - startNs) / 1000;
+        int depth;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ++st.completed;
+            totalWaitUs += waitUs;
+            totalRunUs += runUs;
+            st.maxWaitUs = qMax(st.maxWaitUs, waitUs);
+            st.maxRunUs = qMax(st.maxRunUs, runUs);
+            depth = st.queueDepth;
+        }
+        emit queueDepthChanged(depth);
+        // 队列空了再截断 -wal：等读者的时间不落在任何一次写上
+        if (depth == 0) db.checkpointIfIdle();
+    }
+}
+
+AsyncDatabase::Stats AsyncDatabase::stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    Stats s = st;
+    if (s.completed > 0) {
+        s.avgWaitUs = totalWaitUs / qint64(s.completed);
+        s.avgRunUs = totalRunUs / qint64(s.completed);
+    }
+    return s;
+}
+
+void AsyncDatabase::fetchRows(std::function<QSqlQueryModel *(Database &)> makeModel, QObject *context,
+                              std::function<void(QVector<QSqlRecord>)> done)
+{
+    post<QVector<QSqlRecord>>([makeModel](Database &db) {
+        QVector<QSqlRecord> rows;
+        QSqlQueryModel *model = makeModel(db);
+        if (!model) return rows;
+        while (model->canFetchMore()) model->fetchMore();
+        rows.reserve(model->rowCount());
+        for (int i = 0; i < model->rowCount(); ++i) rows.append(model->record(i));
+        delete model;
+        return rows;
+    }, context, done);
+}
+
+void AsyncDatabase::login(const QString &username, const QString &password, const QString &expectedRole,
+                          QObject *context, std::function<void(AuthResult)> done)
+{
+    post<AuthResult>([username](Database &db) {
+        return db.lookupLogin(username);
+    }, context, [this, password, expectedRole, context, done](AuthResult r) {
+        if (r.status != AuthResult::Ok) {
+            done(r);
+            return;
+        }
+        // 验密不占数据库线程，多个登录可以在线程池里并行
+        PasswordHasher::instance().verifyAsync(password, r.user.passwordHash, context,
+                                               [this, r, expectedRole, done](PasswordHasher::VerifyResult v) {
+            AuthResult out = r;
+            if (v.ok && !v.rehash.isEmpty()) {
+                const int userId = out.user.id;
+                const QString rehash = v.rehash;
+                enqueue([userId, rehash](Database &db) { db.updatePasswordHash(userId, rehash); });
+            }
+            Database::judgeLogin(out, v.ok, expectedRole);
+            done(out);
+        });
+    });
+}
+
+void AsyncDatabase::registerAccount(const RegistrationRequest &req, QObject *context,
+                                    std::function<void(RegistrationResult)> done)
+{
+    PasswordHasher::instance().hashAsync(req.password, context, [this, req, context, done](QString hash) {
+        RegistrationRequest withHash = req;
+        withHash.passwordHash = hash;
+        withHash.password.clear();
+        post<RegistrationResult>([withHash](Database &db) {
+            return db.registerAccount(withHash);
+        }, context, done);
+    });
+}
@@ -0,0 +1,102 @@
+#ifndef ASYNCDATABASE_H
+#define ASYNCDATABASE_H
+
+#include <QObject>
+#include <QPointer>
+#include <QSqlQueryModel>
+#include <QSqlRecord>
+#include <QVector>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include "database.h"
+
+class QThread;
+
+// 数据库后台线程：一个专用线程持有自己的 Database 连接，按提交顺序执行任务，
+// UI 线程只负责投递任务和接收结果，不会因为磁盘慢或等锁而卡住。
+// instance() 必须先在 UI 线程调用一次（回调都在 AsyncDatabase 所在的线程执行）
+class AsyncDatabase : public QObject
+{
+    Q_OBJECT
+
+public:
+    static AsyncDatabase &instance();
+    ~AsyncDatabase();
+
+    // 在后台线程执行 job，结果通过 std::future 取回（适合非 UI 代码）
+    template <typename R>
+    std::future<R> submit(std::function<R(Database &)> job)
+    {
+        auto task = std::make_shared<std::packaged_task<R(Database &)>>(std::move(job));
+        std::future<R> f = task->get_future();
+        enqueue([task](Database &db) { (*task)(db); });
+        return f;
+    }
+
+    // 在后台线程执行 job，完成后在 UI 线程调用 done；context 被销毁则不回调。
+    // R 需要显式写出：post<QString>(...)
+    template <typename R>
+    void post(std::function<R(Database &)> job, QObject *context, std::function<void(R)> done)
+    {
+        QPointer<QObject> guard(context);
+        enqueue([this, job, guard, done](Database &db) {
+            R result = job(db);
+            QMetaObject::invokeMethod(this, [guard, done, result]() {
+                if (guard) done(result);
+            }, Qt::QueuedConnection);
+        });
+    }
+
+    // 模型查询：在后台线程建模型并取完所有行，只把 QSqlRecord（不依赖连接）交回 UI 线程
+    void fetchRows(std::function<QSqlQueryModel *(Database &)> makeModel, QObject *context,
+                   std::function<void(QVector<QSqlRecord>)> done);
+
+    // 登录：数据库线程读一次 users → 哈希线程池验密 → UI 线程回调；
+    // 存储的是旧哈希时，新哈希在线程池里算好后再由数据库线程写回
+    void login(const QString &username, const QString &password, const QString &expectedRole,
+               QObject *context, std::function<void(AuthResult)> done);
+    // 注册：先在哈希线程池里算密码哈希，再到数据库线程执行 registerAccount
+    void registerAccount(const RegistrationRequest &req, QObject *context,
+                         std::function<void(RegistrationResult)> done);
+
+    struct Stats {
+        int queueDepth = 0;      // 等待中的任务数
+        quint64 completed = 0;
+        qint64 avgWaitUs = 0;    // 排队时间
+        qint64 maxWaitUs = 0;
+        qint64 avgRunUs = 0;     // 执行时间
+        qint64 maxRunUs = 0;
+    };
+    Stats stats() const;
+
+    // 执行完已排队的任务后停止后台线程（析构时自动调用）
+    void shutdown();
+
+signals:
+    void queueDepthChanged(int depth);
+
+private:
+    struct Task {
+        std::function<void(Database &)> run;
+        qint64 enqueuedNs = 0;
+    };
+
+    AsyncDatabase();
+    void enqueue(std::function<void(Database &)> run);
+    void workerLoop();
+
+    QThread *worker = nullptr;
+    mutable std::mutex mutex;
+    std::condition_variable cond;
+    std::deque<Task> queue;
+    bool stopping = false;
+    Stats st;
+    qint64 totalWaitUs = 0;
+    qint64 totalRunUs = 0;
+};
+
+#endif // ASYNCDATABASE_H
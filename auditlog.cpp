@@ -0,0 +1,245 @@
+#include "auditlog.h"
+#include "database.h"
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QThread>
+#include <thread>
+
+namespace {
+QMutex g_optionsMutex;
+AuditLog::Options g_options;
+
+size_t roundUpPow2(int n)
+{
+    size_t v = 2;
+    while (v < size_t(qMax(2, n))) v <<= 1;
+    return v;
+}
+}
+
+void AuditLog::setOptions(const Options &options)
+{
+    QMutexLocker lock(&g_optionsMutex);
+    g_options = options;
+}
+
+AuditLog &AuditLog::instance()
+{
+    static AuditLog inst;
+    return inst;
+}
+
+AuditLog::AuditLog()
+{
+    {
+        QMutexLocker lock(&g_optionsMutex);
+        opts = g_options;
+    }
+    opts.batchSize = qMax(1, opts.batchSize);
+    opts.flushIntervalMs = qMax(1, opts.flushIntervalMs);
+    const size_t capacity = roundUpPow2(opts.capacity);
+    mask = capacity - 1;
+    cells.reset(new Cell[capacity]);
+    for (size_t i = 0; i < capacity; ++i) cells[i].seq.store(i, std::memory_order_relaxed);
+
+    writer = QThread::create([this] { writerLoop(); });
+    writer->setObjectName("AuditWriter");
+    writer->start();
+
+    // 没有显式 shutdown() 时，在事件循环结束前把缓冲区写完
+    if (QCoreApplication *app = QCoreApplication::instance())
+        QObject::connect(app, &QCoreApplication::aboutToQuit, [] { AuditLog::instance().shutdown(); });
+}
+
+AuditLog::~AuditLog()
+{
+    shutdown();
+}
+
+bool AuditLog::tryPush(AuditRecord &event)
+{
+    size_t pos = enqueuePos.load(std::memory_order_relaxed);
+    Cell *cell;
+    for (;;) {
+        cell = &cells[pos & mask];
+        const size_t seq = cell->seq.load(std::memory_order_acquire);
+        const intptr_t diff = intptr_t(seq) - intptr_t(pos);
+        if (diff == 0) {
+            if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+        } else if (diff < 0) {
+            return false; // 满了
+        } else {
+            pos = enqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+    cell->rec = std::move(event);
+    cell->seq.store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+bool AuditLog::tryPop(AuditRecord &out)
+{
+    const size_t pos = dequeuePos.load(std::memory_order_relaxed);
+    Cell &cell = cells[pos & mask];
+    const size_t seq = cell.seq.load(std::memory_order_acquire);
+    if (intptr_t(seq) - intptr_t(pos + 1) < 0) return false; // 空，或生产者还没写完这一格
+    out = std::move(cell.rec);
+    cell.rec.details = QString(); // Qt5 的移动赋值是交换，别让旧字符串留在槽位里
+    cell.seq.store(pos + mask + 1, std::memory_order_release);
+    dequeuePos.store(pos + 1, std::memory_order_relaxed);
+    return true;
+}
+
+size_t AuditLog::approxSize() const
+{
+    const size_t head = enqueuePos.load(std::memory_order_relaxed);
+    const size_t tail = dequeuePos.load(std::memory_order_relaxed);
+    return head > tail ? head - tail : 0;
+}
+
+bool AuditLog::record(AuditRecord event)
+{
+    if (stopping.load(std::memory_order_relaxed)) {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    if (event.userId == 0) event.userId = actor.load(std::memory_order_relaxed);
+    if (event.createdAtMs == 0) event.createdAtMs = QDateTime::currentMSecsSinceEpoch();
+
+    while (!tryPush(event)) {
+        if (opts.policy == DropNewest || stopping.load(std::memory_order_relaxed)) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        // Block：叫醒写入线程腾位置
+        wake.notify_one();
+        std::this_thread::yield();
+    }
+    enqueued.fetch_add(1, std::memory_order_relaxed);
+    // 不拿锁直接通知：偶尔错过也只是等到下一个 flushIntervalMs
+    if (approxSize() >= size_t(opts.batchSize)) wake.notify_one();
+    return true;
+}
+
+bool AuditLog::record(const char *action, const char *objectType, qint64 objectId, const QString &details)
+{
+    AuditRecord event;
+    event.action = action;
+    event.objectType = objectType;
+    event.objectId = objectId;
+    event.details = details;
+    return record(std::move(event));
+}
+
+void AuditLog::writerLoop()
+{
+    Database &db = Database::instance();
+    QVector<AuditRecord> batch;
+    batch.reserve(opts.batchSize + 1);
+    quint64 reportedDrops = 0;
+    int failuresInRow = 0;
+
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(wakeMutex);
+            wake.wait_for(lock, std::chrono::milliseconds(opts.flushIntervalMs), [this] {
+                return stopping.load() || approxSize() >= size_t(opts.batchSize);
+            });
+        }
+        const bool stop = stopping.load();
+
+        // 把缓冲区写空，每个事务最多 batchSize 条
+        for (;;) {
+            AuditRecord e;
+            while (batch.size() < opts.batchSize && tryPop(e)) batch.append(std::move(e));
+            // 有被丢弃的事件时补一条记录，审计里能看出缺口
+            const quint64 reportedBefore = reportedDrops;
+            const quint64 drops = dropped.load(std::memory_order_relaxed);
+            const int synthetic = drops > reportedDrops ? 1 : 0;
+            if (synthetic) {
+                AuditRecord gap;
+                gap.action = "audit_dropped";
+                gap.objectType = "audit_logs";
+                gap.details = QString::number(drops - reportedDrops);
+                gap.createdAtMs = QDateTime::currentMSecsSinceEpoch();
+                batch.append(gap);
+                reportedDrops = drops;
+            }
+            if (batch.isEmpty()) break;
+
+            if (!db.insertAuditEvents(batch)) {
+                failedBatches.fetch_add(1, std::memory_order_relaxed);
+                if (synthetic) {
+                    batch.removeLast(); // 下一轮按最新的丢弃数重新补
+                    reportedDrops = reportedBefore;
+                }
+                break;
+            }
+            written.fetch_add(quint64(batch.size() - synthetic), std::memory_order_relaxed);
+            batches.fetch_add(1, std::memory_order_relaxed);
+            batch.clear();
+            failuresInRow = 0;
+        }
+
+        if (!batch.isEmpty()) {
+            // 写失败（多半是数据库被别的连接长时间锁住）：保留这一批下次重试；
+            // 停止时最多再试几次，避免退出卡死
+            if (stop && ++failuresInRow >= 3) {
+                qWarning() << "AuditLog: giving up on" << batch.size() << "audit events at shutdown";
+                batch.clear();
+            }
+            continue;
+        }
+        if (stop && approxSize() == 0) return;
+    }
+}
+
+bool AuditLog::flush(int timeoutMs)
+{
+    const quint64 target = enqueued.load();
+    QElapsedTimer timer;
+    timer.start();
+    while (written.load() < target) {
+        if (timer.elapsed() >= timeoutMs || !writer) return false;
+        wake.notify_one();
+        QThread::msleep(2);
+    }
+    return true;
+}
+
+void AuditLog::shutdown()
+{
+    std::lock_guard<std::mutex> lock(shutdownMutex);
+    if (!writer) return;
+    stopping = true;
+    wake.notify_all();
+    writer->wait();
+    delete writer;
+    writer = nullptr;
+
+    // 写入线程退出前那一刻才入队的事件，在这里用调用线程的连接补写
+    QVector<AuditRecord> rest;
+    AuditRecord e;
+    while (tryPop(e)) rest.append(std::move(e));
+    if (!rest.isEmpty()) {
+        if (Database::instance().insertAuditEvents(rest)) written.fetch_add(quint64(rest.size()));
+        else qWarning() << "AuditLog: lost" << rest.size() << "audit events at shutdown";
+    }
+    const Stats s = stats();
+    qDebug() << "AuditLog: stopped, written" << s.written << "dropped" << s.dropped << "failed batches" << s.failedBatches;
+}
+
+AuditLog::Stats AuditLog::stats() const
+{
+    Stats s;
+    s.enqueued = enqueued.load();
+    s.dropped = dropped.load();
+    s.written = written.load();
+    s.batches = batches.load();
+    s.failedBatches = failedBatches.load();
+    s.queued = int(approxSize());
+    return s;
+}
@@ -0,0 +1,94 @@
+#ifndef AUDITLOG_H
+#define AUDITLOG_H
+
+#include <QVector>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include "records.h"
+
+class QThread;
+
+// 审计日志：调用方把事件放进无锁环形缓冲区就返回（一次 CAS，不加锁、不碰数据库），
+// 后台线程攒够 batchSize 条或每隔 flushIntervalMs 把缓冲区里的事件一个事务写进 audit_logs。
+//
+// 缓冲区满时按 policy 处理：DropNewest 丢掉新事件并计数（写入线程随后补一条 audit_dropped 记录丢了多少），
+// Block 让调用方等到有空位为止。shutdown()（程序退出前 aboutToQuit 时自动调用）会把已入队的事件全部写完。
+// Database 的写操作会自动记审计；事务里的事件在提交后才入队，回滚的不记。
+class AuditLog
+{
+public:
+    enum OverflowPolicy { DropNewest, Block };
+
+    struct Options {
+        int capacity = 8192;          // 向上取 2 的幂
+        int batchSize = 256;
+        int flushIntervalMs = 250;
+        OverflowPolicy policy = DropNewest;
+    };
+    // 要在第一次 instance() 之前设置
+    static void setOptions(const Options &options);
+
+    static AuditLog &instance();
+    ~AuditLog();
+    AuditLog(const AuditLog &) = delete;
+    AuditLog &operator=(const AuditLog &) = delete;
+
+    // 可以在任何线程调用；返回 false 表示事件被丢弃
+    bool record(AuditRecord event);
+    bool record(const char *action, const char *objectType, qint64 objectId, const QString &details = QString());
+
+    // 之后 userId 为 0 的事件都记在这个用户名下（登录成功时设置）
+    void setActor(int userId) { actor.store(userId, std::memory_order_relaxed); }
+
+    // 等到目前为止入队的事件都写完（或 timeoutMs 到期），返回是否写完
+    bool flush(int timeoutMs = 5000);
+    // 写完所有已入队的事件后停止后台线程，之后的 record() 都会被丢弃
+    void shutdown();
+
+    struct Stats {
+        quint64 enqueued = 0;
+        quint64 dropped = 0;
+        quint64 written = 0;
+        quint64 batches = 0;
+        quint64 failedBatches = 0;
+        int queued = 0;               // 缓冲区里还没写的事件（近似值）
+    };
+    Stats stats() const;
+
+private:
+    // Vyukov 有界队列：多个生产者用 CAS 抢位置，每个槽位的序号表示它当前可写还是可读。
+    // 这里只有写入线程一个消费者
+    struct Cell {
+        std::atomic<size_t> seq;
+        AuditRecord rec;
+    };
+
+    AuditLog();
+    bool tryPush(AuditRecord &event);
+    bool tryPop(AuditRecord &out);
+    size_t approxSize() const;
+    void writerLoop();
+
+    Options opts;
+    std::unique_ptr<Cell[]> cells;
+    size_t mask = 0;
+    alignas(64) std::atomic<size_t> enqueuePos{0};
+    alignas(64) std::atomic<size_t> dequeuePos{0};
+
+    std::atomic<int> actor{0};
+    std::atomic<bool> stopping{false};
+    std::atomic<quint64> enqueued{0};
+    std::atomic<quint64> dropped{0};
+    std::atomic<quint64> written{0};
+    std::atomic<quint64> batches{0};
+    std::atomic<quint64> failedBatches{0};
+
+    std::mutex wakeMutex;            // 只用于等待，生产者不拿这把锁
+    std::condition_variable wake;
+    std::mutex shutdownMutex;
+    QThread *writer = nullptr;
+};
+
+#endif // AUDITLOG_H
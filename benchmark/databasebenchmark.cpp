@@ -0,0 +1,505 @@
+#include "databasebenchmark.h"
+#include "../aggregates.h"
+#include "../changenotifier.h"
+#include "../database.h"
+#include "../passwordhasher.h"
+#include "../recordcache.h"
+#include <QDateTime>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QSqlQueryModel>
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <memory>
+#include <new>
+
+namespace {
+// dbbench 进程里所有 operator new 的次数，measure() 用它算每次操作的分配数
+std::atomic<quint64> g_allocations{0};
+
+double percentileUs(const QVector<qint64> &sortedNs, double p)
+{
+    if (sortedNs.isEmpty()) return 0;
+    const int idx = qBound(0, int(p * sortedNs.size() + 0.999999) - 1, sortedNs.size() - 1);
+    return sortedNs.at(idx) / 1000.0;
+}
+
+// 模型默认只取前 256 行，benchmark 要算的是取完整个结果的时间
+bool drain(QSqlQueryModel *model)
+{
+    if (!model) return false;
+    std::unique_ptr<QSqlQueryModel> owner(model);
+    while (model->canFetchMore()) model->fetchMore();
+    return !model->lastError().isValid();
+}
+}
+
+void *operator new(std::size_t size)
+{
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void *p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+QJsonObject DatabaseBenchmark::OpResult::toJson() const
+{
+    QJsonObject o;
+    o["name"] = name;
+    o["ops"] = ops;
+    o["errors"] = errors;
+    o["rowsPerOp"] = double(rowsPerOp);
+    o["totalMs"] = totalMs;
+    o["opsPerSec"] = opsPerSec;
+    o["meanUs"] = meanUs;
+    o["p50Us"] = p50Us;
+    o["p90Us"] = p90Us;
+    o["p99Us"] = p99Us;
+    o["maxUs"] = maxUs;
+    o["allocsPerOp"] = allocsPerOp;
+    return o;
+}
+
+DatabaseBenchmark::DatabaseBenchmark(const Options &options, const DataGenerator::Summary &dataset)
+    : opts(options), data(dataset), rng(options.seed),
+      runTag(QString::number(QDateTime::currentMSecsSinceEpoch(), 36))
+{
+}
+
+DatabaseBenchmark::OpResult DatabaseBenchmark::measure(const char *name, int iterations, const std::function<bool(int)> &op)
+{
+    OpResult r;
+    r.name = QString::fromUtf8(name);
+    const int warmup = qMin(opts.warmup, iterations);
+    for (int i = 0; i < warmup; ++i) op(i);
+
+    QVector<qint64> samples;
+    samples.reserve(iterations);
+    QElapsedTimer timer;
+    const quint64 allocsBefore = g_allocations.load(std::memory_order_relaxed);
+    for (int i = warmup; i < warmup + iterations; ++i) {
+        timer.start();
+        const bool ok = op(i);
+        samples.append(timer.nsecsElapsed());
+        if (!ok) ++r.errors;
+    }
+    r.ops = samples.size();
+    if (samples.isEmpty()) return r;
+    r.allocsPerOp = double(g_allocations.load(std::memory_order_relaxed) - allocsBefore) / r.ops;
+
+    qint64 total = 0;
+    for (qint64 ns : samples) total += ns;
+    std::sort(samples.begin(), samples.end());
+    r.totalMs = total / 1e6;
+    r.opsPerSec = total > 0 ? r.ops * 1e9 / double(total) : 0;
+    r.meanUs = total / 1000.0 / r.ops;
+    r.p50Us = percentileUs(samples, 0.50);
+    r.p90Us = percentileUs(samples, 0.90);
+    r.p99Us = percentileUs(samples, 0.99);
+    r.maxUs = samples.last() / 1000.0;
+    qDebug().noquote() << QString("%1 %2 ops/s  p50 %3us  p99 %4us  allocs %5  errors %6")
+                              .arg(r.name, -32).arg(r.opsPerSec, 10, 'f', 1)
+                              .arg(r.p50Us, 0, 'f', 1).arg(r.p99Us, 0, 'f', 1)
+                              .arg(r.allocsPerOp, 0, 'f', 1).arg(r.errors);
+    return r;
+}
+
+int DatabaseBenchmark::randomDoctor()
+{
+    return data.doctorIds.at(rng.bounded(data.doctorIds.size()));
+}
+
+int DatabaseBenchmark::randomPatient()
+{
+    return data.patientIds.at(rng.bounded(data.patientIds.size()));
+}
+
+QVector<int> DatabaseBenchmark::createAccounts(const QString &role, int count)
+{
+    QVector<RegistrationRequest> reqs;
+    for (int i = 0; i < count; ++i) {
+        RegistrationRequest req;
+        req.role = role;
+        req.username = QString("bench_%1_%2_%3").arg(runTag, role == "患者" ? "p" : "u").arg(i);
+        req.email = req.username + "@example.com";
+        req.passwordHash = passwordHash;
+        req.fullName = req.username;
+        if (role == "患者") req.idNumber = "ID" + req.username;
+        reqs.append(req);
+    }
+    QVector<RegistrationResult> results;
+    QVector<int> ids;
+    if (!Database::instance().registerAccounts(reqs, &results)) return ids;
+    for (const RegistrationResult &r : results) ids.append(r.userId);
+    return ids;
+}
+
+QVector<QVector<QVariant>> DatabaseBenchmark::latestDiagnoses(int count)
+{
+    Database::Rows rows;
+    Database::instance().selectRows("SELECT id, doctor_id, patient_id FROM diagnoses ORDER BY id DESC LIMIT ?",
+                                    QVariantList() << count, rows);
+    return rows;
+}
+
+QVector<DatabaseBenchmark::OpResult> DatabaseBenchmark::run()
+{
+    QVector<OpResult> out;
+    Database &db = Database::instance();
+    if (data.doctorIds.isEmpty() || data.patientIds.isEmpty() || data.usernames.isEmpty()) {
+        qWarning() << "DatabaseBenchmark: dataset is empty";
+        return out;
+    }
+    passwordHash = PasswordHasher::instance().hash(opts.password);
+    const int n = opts.iterations;
+    const int total = n + opts.warmup;
+
+    // 登录 / 注册
+    out << measure("authenticate", opts.loginIterations, [&](int i) {
+        return db.authenticate(data.usernames.at(i % data.usernames.size()), opts.password).status == AuthResult::Ok;
+    });
+    out << measure("authenticate.unknownUser", n, [&](int i) {
+        return db.authenticate(QString("nobody_%1").arg(i), opts.password).status == AuthResult::UnknownUser;
+    });
+    out << measure("registerAccount", n, [&](int i) {
+        // 用预先算好的哈希，只量数据库部分；scrypt 的开销见 authenticate
+        RegistrationRequest req;
+        req.role = "患者";
+        req.username = QString("bench_%1_reg_%2").arg(runTag).arg(i);
+        req.email = req.username + "@example.com";
+        req.passwordHash = passwordHash;
+        req.fullName = req.username;
+        req.idNumber = "ID" + req.username;
+        return db.registerAccount(req).status == RegistrationResult::Ok;
+    });
+    // 导入时某行的详情表写失败（证件号重复），ROLLBACK TO 之后不能再发出这一行的 users Insert：
+    // 一块两行，只有第一行的 users + patients 两条变化
+    out << measure("importAccounts.rejectedRowChanges", 1, [&](int) {
+        const QMetaObject::Connection listen =
+            QObject::connect(&ChangeNotifier::instance(), &ChangeNotifier::rowsChanged, [](const QVector<RowChange> &) {});
+        const quint64 before = ChangeNotifier::instance().stats().changes;
+        QVector<RegistrationRequest> rows;
+        for (int k = 0; k < 2; ++k) {
+            RegistrationRequest req;
+            req.role = "患者";
+            req.username = QString("bench_%1_import_%2").arg(runTag).arg(k);
+            req.email = req.username + "@example.com";
+            req.passwordHash = passwordHash;
+            req.fullName = req.username;
+            req.idNumber = "ID_import_" + runTag; // 第二行与第一行重复
+            rows.append(req);
+        }
+        ImportProgress progress;
+        progress.source = "dbbench:" + runTag;
+        QVector<RegistrationResult::Status> statuses;
+        const bool ok = db.importAccounts(rows, progress, &statuses);
+        const quint64 published = ChangeNotifier::instance().stats().changes - before;
+        QObject::disconnect(listen);
+        return ok && statuses == QVector<RegistrationResult::Status>{ RegistrationResult::Ok, RegistrationResult::IdNumberTaken }
+               && published == 2;
+    });
+    out << measure("insertUser", opts.loginIterations, [&](int i) {
+        const QString name = QString("bench_%1_user_%2").arg(runTag).arg(i);
+        return db.insertUser(name, name + "@example.com", opts.password, "管理员");
+    });
+
+    // 医生：先建好只有 users 行的账号再补 doctors 行。新患者走注册，见 registerAccount
+    const QVector<int> bareUsers = createAccounts("管理员", total);
+    out << measure("insertDoctor", qMin(n, bareUsers.size() - opts.warmup), [&](int i) {
+        return db.insertDoctor(bareUsers.at(i), QString("bench doctor %1").arg(i), "13900000000", "内科",
+                               QString("LIC_%1_%2").arg(runTag).arg(i), "bench road");
+    });
+
+    // 病历 / 预约 / 诊断 / 医嘱 / 处方
+    out << measure("insertMedicalCase", n, [&](int i) {
+        return db.insertMedicalCase(randomPatient(), randomDoctor(), QString("case %1").arg(i), "benchmark case", QString());
+    });
+    out << measure("insertAppointment", n, [&](int i) {
+        return db.insertAppointment(randomPatient(), randomDoctor(),
+                                    QDateTime::currentDateTimeUtc().addSecs(i * 900),
+                                    "scheduled", "benchmark");
+    });
+    out << measure("insertDiagnosis", n, [&](int i) {
+        return db.insertDiagnosis(0, 0, randomDoctor(), randomPatient(), QString("diagnosis %1").arg(i), "J06.9");
+    });
+    const QVector<QVector<QVariant>> diagnoses = latestDiagnoses(total);
+    if (!diagnoses.isEmpty()) {
+        auto diag = [&](int i) -> const QVector<QVariant> & { return diagnoses.at(i % diagnoses.size()); };
+        out << measure("insertMedicalOrder", n, [&](int i) {
+            return db.insertMedicalOrder(diag(i).at(0).toInt(), diag(i).at(1).toInt(), diag(i).at(2).toInt(),
+                                         QString("order %1").arg(i), "检验", "active");
+        });
+        out << measure("insertPrescription", n, [&](int i) {
+            return db.insertPrescription(diag(i).at(0).toInt(), diag(i).at(1).toInt(), diag(i).at(2).toInt(),
+                                         "布洛芬", "200mg", "每日两次", "5天", QString());
+        });
+    }
+
+    // 批量接口：一次调用 batchRows 行
+    const int batches = qMax(1, n / opts.batchRows);
+    OpResult r = measure("insertDiagnoses", batches, [&](int) {
+        QVector<DiagnosisRecord> rows(opts.batchRows);
+        for (DiagnosisRecord &d : rows) {
+            d.doctorId = randomDoctor();
+            d.patientId = randomPatient();
+            d.diagnosisText = "batch diagnosis";
+            d.icdCodes = "I10";
+        }
+        return db.insertDiagnoses(rows);
+    });
+    r.rowsPerOp = opts.batchRows;
+    out << r;
+    if (!diagnoses.isEmpty()) {
+        r = measure("insertMedicalOrders", batches, [&](int b) {
+            QVector<MedicalOrderRecord> rows(opts.batchRows);
+            for (int k = 0; k < rows.size(); ++k) {
+                const QVector<QVariant> &d = diagnoses.at((b * opts.batchRows + k) % diagnoses.size());
+                rows[k].diagnosisId = d.at(0).toInt();
+                rows[k].doctorId = d.at(1).toInt();
+                rows[k].patientId = d.at(2).toInt();
+                rows[k].orderText = "batch order";
+                rows[k].orderType = "检查";
+                rows[k].status = "active";
+            }
+            return db.insertMedicalOrders(rows);
+        });
+        r.rowsPerOp = opts.batchRows;
+        out << r;
+        r = measure("insertPrescriptions", batches, [&](int b) {
+            QVector<PrescriptionRecord> rows(opts.batchRows);
+            for (int k = 0; k < rows.size(); ++k) {
+                const QVector<QVariant> &d = diagnoses.at((b * opts.batchRows + k) % diagnoses.size());
+                rows[k].diagnosisId = d.at(0).toInt();
+                rows[k].doctorId = d.at(1).toInt();
+                rows[k].patientId = d.at(2).toInt();
+                rows[k].medicationName = "阿莫西林";
+                rows[k].dosage = "500mg";
+                rows[k].frequency = "每日三次";
+                rows[k].duration = "7天";
+            }
+            return db.insertPrescriptions(rows);
+        });
+        r.rowsPerOp = opts.batchRows;
+        out << r;
+    }
+    out << measure("saveEncounter", n, [&](int) {
+        DiagnosisRecord d;
+        d.doctorId = randomDoctor();
+        d.patientId = randomPatient();
+        d.diagnosisText = "encounter";
+        d.icdCodes = "E11.9";
+        QVector<MedicalOrderRecord> orders(1);
+        orders[0].orderText = "复查血糖";
+        orders[0].orderType = "检验";
+        orders[0].status = "active";
+        QVector<PrescriptionRecord> prescriptions(2);
+        for (PrescriptionRecord &p : prescriptions) {
+            p.medicationName = "二甲双胍";
+            p.dosage = "500mg";
+            p.frequency = "每日两次";
+            p.duration = "长期";
+        }
+        return db.saveEncounter(d, orders, prescriptions);
+    });
+
+    // 更新 / 删除。删除用新建的无关联记录的患者，避免级联删除的量随数据集变化
+    out << measure("updatePatient", n, [&](int i) {
+        PatientUpdate u;
+        u.fields = PatientUpdate::Phone;
+        u.phone = QString("1370000%1").arg(i % 10000, 4, 10, QChar('0'));
+        return db.updatePatient(randomPatient(), u);
+    });
+    const QVector<int> disposable = createAccounts("患者", total);
+    out << measure("deletePatient", qMin(n, disposable.size() - opts.warmup), [&](int i) {
+        return db.deletePatient(disposable.at(i));
+    });
+
+    // 查询：热门医生（Zipf 头部）和随机医生分开量，差别就是数据倾斜的代价
+    out << measure("appointmentsForDoctorModel.hot", opts.modelIterations, [&](int) {
+        return drain(db.appointmentsForDoctorModel(data.doctorIds.first()));
+    });
+    out << measure("appointmentsForDoctorModel", opts.modelIterations, [&](int) {
+        return drain(db.appointmentsForDoctorModel(randomDoctor()));
+    });
+    out << measure("casesForPatientModel", opts.modelIterations, [&](int) {
+        return drain(db.casesForPatientModel(randomPatient()));
+    });
+    if (!data.chronicPatientIds.isEmpty()) {
+        out << measure("casesForPatientModel.chronic", opts.modelIterations, [&](int i) {
+            return drain(db.casesForPatientModel(data.chronicPatientIds.at(i % data.chronicPatientIds.size())));
+        });
+    }
+    out << measure("prescriptionsForPatientModel", opts.modelIterations, [&](int) {
+        return drain(db.prescriptionsForPatientModel(randomPatient()));
+    });
+    out << measure("modelForTable.appointments", opts.tableModelIterations, [&](int) {
+        return drain(db.modelForTable("appointments"));
+    });
+    out << measure("appointmentsForDoctor", opts.modelIterations, [&](int) {
+        QVector<AppointmentRecord> rows;
+        return db.appointmentsForDoctor(randomDoctor(), rows);
+    });
+    out << measure("prescriptionsForPatient", opts.modelIterations, [&](int) {
+        QVector<PrescriptionRecord> rows;
+        return db.prescriptionsForPatient(randomPatient(), rows);
+    });
+    // 时间范围查询：医生一周的日程、患者最近一年的处方，走 (doctor_id, scheduled_at) / (patient_id, issued_at) 索引
+    const qint64 now = QDateTime::currentSecsSinceEpoch();
+    out << measure("range.appointmentsForDoctorWeek", opts.modelIterations, [&](int) {
+        const qint64 from = now - qint64(rng.bounded(365)) * 86400;
+        Database::Rows rows;
+        return db.selectRows("SELECT id, patient_id, scheduled_at, status FROM appointments "
+                             "WHERE doctor_id = ? AND scheduled_at >= ? AND scheduled_at < ? ORDER BY scheduled_at",
+                             QVariantList() << randomDoctor() << from << from + 7 * 86400, rows);
+    });
+    out << measure("range.prescriptionsForPatientYear", opts.modelIterations, [&](int) {
+        Database::Rows rows;
+        return db.selectRows("SELECT id, medication_name, issued_at FROM prescriptions "
+                             "WHERE patient_id = ? AND issued_at >= ? ORDER BY issued_at DESC, id DESC",
+                             QVariantList() << randomPatient() << now - 365 * 86400, rows);
+    });
+    // 患者时间线：打开时的第一页，慢性病患者再翻一页（键集翻页）
+    out << measure("timeline", opts.modelIterations, [&](int) {
+        TimelineQuery tq;
+        QVector<TimelineEvent> events;
+        return db.timeline(randomPatient(), tq, events);
+    });
+    if (!data.chronicPatientIds.isEmpty()) {
+        out << measure("timeline.chronic.twoPages", opts.modelIterations, [&](int i) {
+            TimelineQuery tq;
+            QVector<TimelineEvent> events;
+            const int patientId = data.chronicPatientIds.at(i % data.chronicPatientIds.size());
+            if (!db.timeline(patientId, tq, events, &tq.after)) return false;
+            return events.size() < tq.limit || db.timeline(patientId, tq, events, &tq.after);
+        });
+    }
+    // 全文检索：按 ICD 编码查诊断（常见编码命中很多行，测的是排序取前 20 加摘要的开销）
+    const QStringList icdTerms = { "J06", "I10", "E11", "J45", "M54" };
+    out << measure("searchRecords", opts.modelIterations, [&](int i) {
+        QVector<SearchHit> hits;
+        return db.searchRecords(icdTerms.at(i % icdTerms.size()), 0, 0, 20, hits);
+    });
+    // 统计汇总：医生一个月的按天按状态计数、处方最多的药，汇总表与现场 GROUP BY 对比（见 aggregates.h）
+    out << measure("aggregates.doctorMonth", opts.modelIterations, [&](int) {
+        const QDate to = QDate::currentDate().addDays(-rng.bounded(365));
+        QVector<AppointmentDayCount> counts;
+        return db.appointmentCountsForDoctor(randomDoctor(), to.addDays(-30), to, counts);
+    });
+    // 与汇总表一样按本机时区的日期分组
+    const QString doctorMonthSql = QString("SELECT %1 AS day, status, COUNT(*) FROM appointments "
+                                           "WHERE doctor_id = ? AND scheduled_at >= ? AND scheduled_at < ? GROUP BY 1, 2")
+                                       .arg(Aggregates::localDaySql("scheduled_at"));
+    out << measure("aggregates.doctorMonth.groupBy", opts.modelIterations, [&](int) {
+        const qint64 to = now - qint64(rng.bounded(365)) * 86400;
+        Database::Rows rows;
+        return db.selectRows(doctorMonthSql, QVariantList() << randomDoctor() << to - 30 * 86400 << to, rows);
+    });
+    out << measure("aggregates.topMedications", opts.modelIterations, [&](int) {
+        QVector<NamedCount> counts;
+        return db.topMedications(20, counts);
+    });
+    out << measure("aggregates.topMedications.groupBy", opts.modelIterations, [&](int) {
+        Database::Rows rows;
+        return db.selectRows("SELECT medication_name, COUNT(*) AS n FROM prescriptions "
+                             "GROUP BY medication_name ORDER BY n DESC LIMIT 20", QVariantList(), rows);
+    });
+    out << measure("aggregates.topIcdCodes", opts.modelIterations, [&](int) {
+        QVector<NamedCount> counts;
+        return db.topIcdCodes(20, counts);
+    });
+    // 生成的数据都经过写接口，汇总应当与源表完全一致
+    out << measure("verifyAggregates", 1, [&](int) {
+        return db.verifyAggregates() == 0;
+    });
+    // ICD 编码：按编码找患者、最近 30 天按章节字母汇总、J 章各类目汇总，
+    // diagnosis_codes 的索引与扫 diagnoses、匹配或拆分 icd_codes 文本对比（见 aggregates.h）
+    const QStringList icdCodes = { "J06.9", "I10", "E11.9", "J45.909", "M54.5" };
+    out << measure("icd.patientsWithCode", opts.modelIterations, [&](int i) {
+        QVector<IcdPatientHit> hits;
+        return db.patientsWithIcdCode(icdCodes.at(i % icdCodes.size()), 0, 100, hits);
+    });
+    out << measure("icd.patientsWithCode.likeScan", opts.modelIterations, [&](int i) {
+        Database::Rows rows;
+        return db.selectRows("SELECT patient_id, COUNT(*), MAX(created_at) FROM diagnoses "
+                             "WHERE ',' || icd_codes || ',' LIKE ? GROUP BY patient_id ORDER BY patient_id LIMIT 100",
+                             QVariantList() << "%," + icdCodes.at(i % icdCodes.size()) + ",%", rows);
+    });
+    out << measure("icd.chaptersMonth", opts.modelIterations, [&](int) {
+        const QDateTime to = QDateTime::fromSecsSinceEpoch(now - qint64(rng.bounded(365)) * 86400);
+        QVector<IcdRollup> rollup;
+        return db.icdRollup(QString(), 1, to.addDays(-30), to, rollup);
+    });
+    out << measure("icd.chaptersMonth.textScan", opts.modelIterations, [&](int) {
+        const qint64 to = now - qint64(rng.bounded(365)) * 86400;
+        Database::Rows rows;
+        if (!db.selectRows("SELECT icd_codes FROM diagnoses WHERE created_at >= ? AND created_at < ?",
+                           QVariantList() << to - 30 * 86400 << to, rows))
+            return false;
+        QHash<QString, int> chapters;
+        for (const QVector<QVariant> &row : rows) {
+            for (const QString &code : row.value(0).toString().split(',')) {
+                if (!code.isEmpty()) ++chapters[code.left(1)];
+            }
+        }
+        return true;
+    });
+    out << measure("icd.categoriesJ", opts.modelIterations, [&](int) {
+        QVector<IcdRollup> rollup;
+        return db.icdRollup("J", 3, QDateTime(), QDateTime(), rollup);
+    });
+    out << measure("icd.categoriesJ.likeScan", opts.modelIterations, [&](int) {
+        Database::Rows rows;
+        if (!db.selectRows("SELECT icd_codes FROM diagnoses WHERE icd_codes LIKE '%J%'", QVariantList(), rows))
+            return false;
+        QHash<QString, int> categories;
+        for (const QVector<QVariant> &row : rows) {
+            for (const QString &code : row.value(0).toString().split(',')) {
+                if (code.startsWith('J')) ++categories[code.left(3)];
+            }
+        }
+        return true;
+    });
+    // 点查：先清空记录缓存测库里的读取，再在一个小的热点集合上测缓存命中（见 recordcache.h）
+    RecordCache &cache = RecordCache::instance();
+    out << measure("findUser", n, [&](int i) {
+        cache.invalidateAll();
+        UserRecord u;
+        return db.findUser(data.usernames.at(i % data.usernames.size()), u);
+    });
+    // 旧的 QVariantMap 接口，与上面按下标填充 UserRecord 的 findUser 成对比较 allocsPerOp 和分位数
+    out << measure("findUserByUsername.map", n, [&](int i) {
+        cache.invalidateAll();
+        QVariantMap u;
+        return db.findUserByUsername(data.usernames.at(i % data.usernames.size()), u);
+    });
+    out << measure("findPatient", n, [&](int) {
+        cache.invalidateAll();
+        PatientRecord p;
+        return db.findPatient(randomPatient(), p);
+    });
+    const int hotUsers = qMin(100, data.usernames.size());
+    out << measure("findUser.cached", n, [&](int i) {
+        UserRecord u;
+        return db.findUser(data.usernames.at(i % hotUsers), u);
+    });
+    out << measure("findPatient.cached", n, [&](int i) {
+        PatientRecord p;
+        return db.findPatient(data.patientIds.at(i % qMin(100, data.patientIds.size())), p);
+    });
+    out << measure("findDoctor.cached", n, [&](int i) {
+        DoctorRecord d;
+        return db.findDoctor(data.doctorIds.at(i % data.doctorIds.size()), d);
+    });
+    return out;
+}
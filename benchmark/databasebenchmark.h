@@ -0,0 +1,63 @@
+#ifndef DATABASEBENCHMARK_H
+#define DATABASEBENCHMARK_H
+
+#include <QJsonObject>
+#include <QRandomGenerator>
+#include <QString>
+#include <QVector>
+#include <functional>
+#include "datagenerator.h"
+
+// 对 Database 的每个公开接口分别计时：登录、注册、各 insert*、updatePatient、deletePatient、各 *Model 查询。
+// 每个操作先跑几次预热，再记录每次调用的耗时，算出 ops/sec 和精确的分位数（排序取值，不是分桶近似），
+// 以及平均每次调用的堆分配次数（dbbench 替换了全局 operator new 来计数）。
+// 结果是 JSON，同样的 seed 和规模下不同提交的结果可以直接比较
+class DatabaseBenchmark
+{
+public:
+    struct Options {
+        int iterations = 2000;       // 写操作和轻量读
+        int loginIterations = 50;    // 登录 / insertUser 每次都算 scrypt，单独设次数
+        int modelIterations = 200;   // *Model：每次把结果全部取完
+        int tableModelIterations = 5; // modelForTable 读整张表
+        int batchRows = 100;         // insertDiagnoses 等批量接口每批的行数
+        int warmup = 10;
+        quint32 seed = 1;
+        QString password;            // 生成数据时用的密码
+    };
+
+    struct OpResult {
+        QString name;
+        int ops = 0;
+        int errors = 0;
+        qint64 rowsPerOp = 1;        // 批量接口每次调用写的行数
+        double totalMs = 0;
+        double opsPerSec = 0;
+        double meanUs = 0;
+        double p50Us = 0;
+        double p90Us = 0;
+        double p99Us = 0;
+        double maxUs = 0;
+        double allocsPerOp = 0;      // 计时期间整个进程的堆分配次数 / ops（含后台线程）
+        QJsonObject toJson() const;
+    };
+
+    DatabaseBenchmark(const Options &options, const DataGenerator::Summary &dataset);
+    QVector<OpResult> run();
+
+private:
+    // op(i) 返回 false 记为一次错误（耗时仍然计入）
+    OpResult measure(const char *name, int iterations, const std::function<bool(int)> &op);
+    int randomDoctor();
+    int randomPatient();
+    QVector<int> createAccounts(const QString &role, int count); // 不计时的准备工作
+    QVector<QVector<QVariant>> latestDiagnoses(int count);
+
+    Options opts;
+    DataGenerator::Summary data;
+    QRandomGenerator rng;
+    QString runTag;                  // 每次运行唯一，避免 --skip-generate 重复跑时用户名冲突
+    QString passwordHash;
+};
+
+#endif // DATABASEBENCHMARK_H
@@ -0,0 +1,251 @@
+#include "datagenerator.h"
+#include "../database.h"
+#include "../passwordhasher.h"
+#include <QDateTime>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QJsonArray>
+#include <algorithm>
+#include <cmath>
+
+namespace {
+const char *const kSpecialties[] = { "内科", "外科", "儿科", "妇产科", "眼科", "耳鼻喉科", "皮肤科", "口腔科", "神经内科", "心内科" };
+const char *const kMedications[] = { "阿莫西林", "布洛芬", "二甲双胍", "氨氯地平", "阿托伐他汀", "奥美拉唑", "对乙酰氨基酚", "头孢克肟", "氯雷他定", "缬沙坦" };
+const char *const kDosages[] = { "5mg", "10mg", "20mg", "250mg", "500mg", "1g" };
+const char *const kFrequencies[] = { "每日一次", "每日两次", "每日三次", "必要时" };
+const char *const kDurations[] = { "3天", "5天", "7天", "14天", "30天", "长期" };
+const char *const kOrderTypes[] = { "检验", "检查", "护理", "饮食" };
+const char *const kStatuses[] = { "scheduled", "completed", "completed", "completed", "cancelled" };
+// 常见 ICD-10 编码，越靠前越常见
+const char *const kIcdCodes[] = { "J06.9", "I10", "E11.9", "K21.9", "M54.5", "J45.909", "E78.5", "F41.1",
+                                  "N39.0", "R51", "K29.7", "L30.9", "H10.9", "B34.9", "J20.9", "I25.10" };
+
+template <typename T, int N>
+const T &pick(QRandomGenerator &rng, const T (&items)[N])
+{
+    return items[rng.bounded(N)];
+}
+}
+
+void DataGenerator::WeightedSampler::setWeights(const QVector<double> &weights)
+{
+    cumulative.clear();
+    cumulative.reserve(weights.size());
+    double sum = 0;
+    for (double w : weights) {
+        sum += qMax(0.0, w);
+        cumulative.append(sum);
+    }
+}
+
+int DataGenerator::WeightedSampler::sample(QRandomGenerator &rng) const
+{
+    if (cumulative.isEmpty()) return -1;
+    const double x = rng.generateDouble() * cumulative.last();
+    const auto it = std::upper_bound(cumulative.constBegin(), cumulative.constEnd(), x);
+    return qMin(int(it - cumulative.constBegin()), cumulative.size() - 1);
+}
+
+DataGenerator::DataGenerator(const Config &config)
+    : cfg(config), rng(config.seed),
+      runTag(QString::number(QDateTime::currentMSecsSinceEpoch(), 36))
+{
+}
+
+QJsonObject DataGenerator::Summary::toJson() const
+{
+    QJsonObject o;
+    o["doctors"] = doctorIds.size();
+    o["patients"] = patientIds.size();
+    o["chronicPatients"] = chronicPatientIds.size();
+    o["elapsedMs"] = double(elapsedMs);
+    o["ok"] = ok;
+    return o;
+}
+
+QDateTime DataGenerator::randomTimestamp()
+{
+    const qint64 now = QDateTime::currentSecsSinceEpoch();
+    const qint64 secs = now - qint64(rng.bounded(quint32(qMax(1, cfg.historyDays)) * 86400u));
+    return QDateTime::fromSecsSinceEpoch(secs, Qt::UTC);
+}
+
+QString DataGenerator::randomWord(int minLen, int maxLen)
+{
+    static const QString letters = "abcdefghijklmnopqrstuvwxyz";
+    const int len = minLen + rng.bounded(maxLen - minLen + 1);
+    QString s;
+    s.reserve(len);
+    for (int i = 0; i < len; ++i) s += letters.at(rng.bounded(letters.size()));
+    return s;
+}
+
+int DataGenerator::pickDoctor(const Summary &s)
+{
+    return s.doctorIds.at(doctorSampler.sample(rng));
+}
+
+int DataGenerator::pickPatient(const Summary &s)
+{
+    return s.patientIds.at(patientSampler.sample(rng));
+}
+
+DataGenerator::Summary DataGenerator::generate()
+{
+    Summary s;
+    QElapsedTimer timer;
+    timer.start();
+    // 所有账号同一个密码：只算一次 scrypt，否则生成时间全花在哈希上
+    passwordHash = PasswordHasher::instance().hash(cfg.password);
+
+    s.ok = generateAccounts(s);
+    if (s.ok && !s.doctorIds.isEmpty() && !s.patientIds.isEmpty()) {
+        // 医生热度：第 k 名的权重 1/k^s
+        QVector<double> doctorWeights;
+        for (int k = 1; k <= s.doctorIds.size(); ++k) doctorWeights << 1.0 / std::pow(double(k), cfg.doctorZipfS);
+        doctorSampler.setWeights(doctorWeights);
+        // 慢性病患者：前 chronicFraction 的患者权重为 chronicWeight（患者 id 本身是随机顺序无关的）
+        QVector<double> patientWeights;
+        const int chronic = int(s.patientIds.size() * cfg.chronicFraction);
+        for (int i = 0; i < s.patientIds.size(); ++i) {
+            patientWeights << (i < chronic ? cfg.chronicWeight : 1.0);
+            if (i < chronic) s.chronicPatientIds << s.patientIds.at(i);
+        }
+        patientSampler.setWeights(patientWeights);
+
+        s.ok = generateAppointments(s) && generateCases(s) && generateEncounters(s);
+    }
+    s.elapsedMs = timer.elapsed();
+    qDebug() << "DataGenerator: done in" << s.elapsedMs << "ms, ok =" << s.ok;
+    return s;
+}
+
+bool DataGenerator::generateAccounts(Summary &s)
+{
+    Database &db = Database::instance();
+    struct Group { int count; const char *role; };
+    const Group groups[] = { { cfg.doctors, "医生" }, { cfg.patients, "患者" }, { cfg.admins, "管理员" } };
+    int serial = 0;
+    for (const Group &g : groups) {
+        QVector<RegistrationRequest> batch;
+        auto flush = [&]() {
+            QVector<RegistrationResult> results;
+            if (!db.registerAccounts(batch, &results)) {
+                qWarning() << "DataGenerator: registerAccounts failed";
+                return false;
+            }
+            for (int i = 0; i < results.size(); ++i) {
+                if (batch.at(i).role == "医生") s.doctorIds << results.at(i).userId;
+                else if (batch.at(i).role == "患者") s.patientIds << results.at(i).userId;
+                s.usernames << batch.at(i).username;
+            }
+            batch.clear();
+            return true;
+        };
+        for (int i = 0; i < g.count; ++i) {
+            ++serial;
+            RegistrationRequest req;
+            req.role = g.role;
+            req.username = QString("bench_%1_%2").arg(runTag).arg(serial);
+            req.email = req.username + "@example.com";
+            req.passwordHash = passwordHash;
+            req.fullName = randomWord(2, 4) + " " + randomWord(3, 8);
+            req.phone = QString("1%1").arg(rng.bounded(300000000u, 999999999u));
+            if (req.role == "患者") {
+                req.dateOfBirth = QDate(1930 + rng.bounded(90), 1 + rng.bounded(12), 1 + rng.bounded(28));
+                req.idNumber = QString("ID%1_%2").arg(runTag).arg(serial, 12, 10, QChar('0'));
+                req.gender = rng.bounded(2) ? "男" : "女";
+                req.post = QString::number(100000 + rng.bounded(900000));
+            } else if (req.role == "医生") {
+                req.specialty = pick(rng, kSpecialties);
+                req.licenseNumber = QString("LIC%1_%2").arg(runTag).arg(serial, 10, 10, QChar('0'));
+                req.clinicAddress = randomWord(5, 12) + " road " + QString::number(rng.bounded(1, 999));
+            }
+            batch.append(req);
+            if (batch.size() >= cfg.batchSize && !flush()) return false;
+        }
+        if (!batch.isEmpty() && !flush()) return false;
+    }
+    // 患者顺序打乱，慢性病患者不集中在 id 前段
+    std::shuffle(s.patientIds.begin(), s.patientIds.end(), rng);
+    return true;
+}
+
+bool DataGenerator::generateAppointments(const Summary &s)
+{
+    Database &db = Database::instance();
+    for (int i = 0; i < cfg.appointments; ++i) {
+        if (!db.insertAppointment(pickPatient(s), pickDoctor(s), randomTimestamp(), pick(rng, kStatuses),
+                                  randomWord(10, 40))) {
+            qWarning() << "DataGenerator: insertAppointment failed at" << i;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool DataGenerator::generateCases(const Summary &s)
+{
+    Database &db = Database::instance();
+    for (int i = 0; i < cfg.cases; ++i) {
+        if (!db.insertMedicalCase(pickPatient(s), pickDoctor(s), randomWord(5, 20), randomWord(40, 200), QString())) {
+            qWarning() << "DataGenerator: insertMedicalCase failed at" << i;
+            return false;
+        }
+    }
+    return true;
+}
+
+// 一次就诊 = 诊断 + 若干医嘱 + 若干处方，用 saveEncounter 一个事务写入
+bool DataGenerator::generateEncounters(const Summary &s)
+{
+    Database &db = Database::instance();
+    const int icdCount = int(sizeof(kIcdCodes) / sizeof(kIcdCodes[0]));
+    QVector<double> icdWeights;
+    for (int k = 1; k <= icdCount; ++k) icdWeights << 1.0 / k;
+    WeightedSampler icdSampler;
+    icdSampler.setWeights(icdWeights);
+
+    for (int i = 0; i < cfg.diagnoses; ++i) {
+        DiagnosisRecord d;
+        d.patientId = pickPatient(s);
+        d.doctorId = pickDoctor(s);
+        d.diagnosisText = randomWord(20, 120);
+        QStringList codes;
+        const int n = 1 + rng.bounded(3);
+        for (int c = 0; c < n; ++c) {
+            const QString code = kIcdCodes[icdSampler.sample(rng)];
+            if (!codes.contains(code)) codes << code;
+        }
+        d.icdCodes = codes.join(',');
+
+        QVector<MedicalOrderRecord> orders;
+        const int orderCount = rng.bounded(2 * cfg.ordersPerDiagnosis + 1);
+        for (int o = 0; o < orderCount; ++o) {
+            MedicalOrderRecord r;
+            r.doctorId = d.doctorId;
+            r.patientId = d.patientId;
+            r.orderText = randomWord(10, 60);
+            r.orderType = pick(rng, kOrderTypes);
+            r.status = "active";
+            orders << r;
+        }
+        QVector<PrescriptionRecord> prescriptions;
+        const int rxCount = rng.bounded(2 * cfg.prescriptionsPerDiagnosis + 1);
+        for (int p = 0; p < rxCount; ++p) {
+            PrescriptionRecord r;
+            r.doctorId = d.doctorId;
+            r.patientId = d.patientId;
+            r.medicationName = pick(rng, kMedications);
+            r.dosage = pick(rng, kDosages);
+            r.frequency = pick(rng, kFrequencies);
+            r.duration = pick(rng, kDurations);
+            prescriptions << r;
+        }
+        if (!db.saveEncounter(d, orders, prescriptions)) {
+            qWarning() << "DataGenerator: saveEncounter failed at" << i;
+            return false;
+        }
+    }
+    return true;
+}
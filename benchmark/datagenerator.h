@@ -0,0 +1,77 @@
+#ifndef DATAGENERATOR_H
+#define DATAGENERATOR_H
+
+#include <QDateTime>
+#include <QJsonObject>
+#include <QRandomGenerator>
+#include <QString>
+#include <QVector>
+
+// 按配置的规模生成一个"像真的"医疗库：少数热门医生承担大部分预约（Zipf 分布），
+// 少数慢性病患者的就诊次数是普通患者的若干倍。同一个 seed 生成的数据完全相同
+// （用户名、证件号、执照号里带每次运行唯一的标记，--keep 往已有的库里再生成一次不会冲突）。
+// 写入走 Database 的公开接口，数据库路径由 Database::setConnectionProfile 决定
+class DataGenerator
+{
+public:
+    struct Config {
+        int doctors = 200;
+        int patients = 20000;
+        int admins = 10;             // 只有 users 行的其他角色
+        int appointments = 100000;
+        int cases = 40000;
+        int diagnoses = 60000;       // 每条诊断一次就诊，随带医嘱和处方
+        int ordersPerDiagnosis = 1;  // 平均值
+        int prescriptionsPerDiagnosis = 2;
+        double doctorZipfS = 1.1;    // 医生热度的 Zipf 指数，越大越集中
+        double chronicFraction = 0.05;
+        double chronicWeight = 20;   // 慢性病患者的就诊权重
+        int historyDays = 3 * 365;   // 时间分布在最近这么多天
+        quint32 seed = 20240501;
+        int batchSize = 1000;        // 注册时每个事务的行数
+        QString password = "bench-password"; // 所有生成账号的密码（只算一次哈希）
+    };
+
+    struct Summary {
+        QVector<int> doctorIds;      // 按热度从高到低
+        QVector<int> patientIds;
+        QVector<int> chronicPatientIds;
+        QVector<QString> usernames;  // 可以用 Config::password 登录的账号
+        qint64 elapsedMs = 0;
+        bool ok = false;
+        QJsonObject toJson() const;
+    };
+
+    explicit DataGenerator(const Config &config);
+    Summary generate();
+
+    // 按权重抽样：累积权重 + 二分查找
+    class WeightedSampler
+    {
+    public:
+        void setWeights(const QVector<double> &weights);
+        int sample(QRandomGenerator &rng) const;
+        bool isEmpty() const { return cumulative.isEmpty(); }
+    private:
+        QVector<double> cumulative;
+    };
+
+private:
+    bool generateAccounts(Summary &s);
+    bool generateAppointments(const Summary &s);
+    bool generateCases(const Summary &s);
+    bool generateEncounters(const Summary &s);
+    QDateTime randomTimestamp();
+    QString randomWord(int minLen, int maxLen);
+    int pickDoctor(const Summary &s);
+    int pickPatient(const Summary &s);
+
+    Config cfg;
+    QRandomGenerator rng;
+    WeightedSampler doctorSampler;
+    WeightedSampler patientSampler;
+    QString passwordHash;
+    QString runTag;                  // 每次运行唯一，写进用户名等唯一列
+};
+
+#endif // DATAGENERATOR_H
@@ -0,0 +1,258 @@
+// 数据库基准测试：生成指定规模的数据，逐个接口计时，结果写成 JSON。
+//   dbbench --db bench.db --scale 0.1 --out results.json --label <commit>
+// 同一 seed、同一规模的两次结果可以逐项对比 opsPerSec / p99Us，storage 里是各表、各索引的大小。
+// schema 升级前后对比：旧版本生成并测一次，再用新版本 --skip-generate 在同一个库上测（打开时自动升级）
+// 热点查询的执行计划有问题时（Database::queryPlanProblems()）退出码为 2，可以直接放进 CI
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QSaveFile>
+#include <QSysInfo>
+#include "../auditlog.h"
+#include "../database.h"
+#include "../passwordhasher.h"
+#include "../querystats.h"
+#include "../recordcache.h"
+#include "databasebenchmark.h"
+#include "datagenerator.h"
+
+namespace {
+QJsonObject configJson(const DataGenerator::Config &c, const DatabaseBenchmark::Options &o)
+{
+    QJsonObject j;
+    j["doctors"] = c.doctors;
+    j["patients"] = c.patients;
+    j["admins"] = c.admins;
+    j["appointments"] = c.appointments;
+    j["cases"] = c.cases;
+    j["diagnoses"] = c.diagnoses;
+    j["doctorZipfS"] = c.doctorZipfS;
+    j["chronicFraction"] = c.chronicFraction;
+    j["chronicWeight"] = c.chronicWeight;
+    j["seed"] = double(c.seed);
+    j["iterations"] = o.iterations;
+    j["loginIterations"] = o.loginIterations;
+    j["modelIterations"] = o.modelIterations;
+    j["batchRows"] = o.batchRows;
+    return j;
+}
+
+QJsonArray queryStatsJson()
+{
+    QJsonArray arr;
+    for (const QueryStats::LabelStats &s : QueryStats::snapshot()) {
+        QJsonObject o;
+        o["label"] = s.label;
+        o["count"] = double(s.count);
+        o["errors"] = double(s.errors);
+        o["busy"] = double(s.busy);
+        o["rows"] = double(s.rows);
+        o["totalMs"] = s.totalNs / 1e6;
+        o["p50Us"] = s.p50Ns / 1000.0;
+        o["p99Us"] = s.p99Ns / 1000.0;
+        o["maxUs"] = s.maxNs / 1000.0;
+        arr.append(o);
+    }
+    return arr;
+}
+
+// 记录缓存的命中情况（包括 findUser.cached 等专门测命中的操作）
+QJsonObject recordCacheJson()
+{
+    const RecordCache::Stats s = RecordCache::instance().stats();
+    auto kind = [](const RecordCache::Stats::Kind &k) {
+        QJsonObject o;
+        o["hits"] = double(k.hits);
+        o["misses"] = double(k.misses);
+        o["evictions"] = double(k.evictions);
+        o["entries"] = k.entries;
+        o["bytes"] = double(k.bytes);
+        return o;
+    };
+    QJsonObject o;
+    o["users"] = kind(s.users);
+    o["patients"] = kind(s.patients);
+    o["doctors"] = kind(s.doctors);
+    o["invalidations"] = double(s.invalidations);
+    o["stalePuts"] = double(s.stalePuts);
+    return o;
+}
+
+// 库文件和各表、各索引占的空间。按表 / 索引的统计要 SQLite 编译时带 dbstat，没有时只给总数
+QJsonObject storageJson()
+{
+    Database &db = Database::instance();
+    QJsonObject o;
+    Database::Rows rows;
+    for (const char *pragma : { "page_size", "page_count", "freelist_count" }) {
+        rows.clear();
+        if (db.selectRows(QString("PRAGMA %1").arg(QLatin1String(pragma)), QVariantList(), rows) && !rows.isEmpty())
+            o[QLatin1String(pragma)] = rows.first().value(0).toDouble();
+    }
+    rows.clear();
+    if (db.selectRows("SELECT name, SUM(pgsize) FROM dbstat GROUP BY name ORDER BY 2 DESC", QVariantList(), rows)) {
+        QJsonObject objects;
+        for (const auto &r : rows) objects[r.at(0).toString()] = r.at(1).toDouble();
+        o["objects"] = objects;
+    }
+    return o;
+}
+
+// --skip-generate 时从已有的库里取回生成器的 Summary（医生按预约数降序，近似原来的热度顺序）
+DataGenerator::Summary loadSummary(const DataGenerator::Config &c)
+{
+    DataGenerator::Summary s;
+    Database &db = Database::instance();
+    Database::Rows rows;
+    db.selectRows("SELECT d.id FROM doctors d LEFT JOIN appointments a ON a.doctor_id = d.id "
+                  "GROUP BY d.id ORDER BY COUNT(a.id) DESC", QVariantList(), rows);
+    for (const auto &r : rows) s.doctorIds << r.at(0).toInt();
+    rows.clear();
+    db.selectRows("SELECT p.id FROM patients p LEFT JOIN medical_cases c ON c.patient_id = p.id "
+                  "GROUP BY p.id ORDER BY COUNT(c.id) DESC", QVariantList(), rows);
+    for (const auto &r : rows) s.patientIds << r.at(0).toInt();
+    const int chronic = int(s.patientIds.size() * c.chronicFraction);
+    s.chronicPatientIds = s.patientIds.mid(0, chronic);
+    rows.clear();
+    db.selectRows("SELECT username FROM users WHERE username LIKE 'bench\\_%' ESCAPE '\\' "
+                  "AND password_hash <> '!' ORDER BY id LIMIT 1000", QVariantList(), rows);
+    for (const auto &r : rows) s.usernames << r.at(0).toString();
+    s.ok = !s.doctorIds.isEmpty() && !s.patientIds.isEmpty();
+    return s;
+}
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("dbbench");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Medical database benchmark");
+    parser.addHelpOption();
+    const QCommandLineOption dbOpt("db", "SQLite file to create / use.", "path", "bench.db");
+    const QCommandLineOption outOpt("out", "Write JSON results here (default: stdout).", "path");
+    const QCommandLineOption labelOpt("label", "Free-form label stored in the results, e.g. a commit id.", "text");
+    const QCommandLineOption seedOpt("seed", "Random seed for data and workload.", "n", "20240501");
+    const QCommandLineOption scaleOpt("scale", "Multiply all dataset counts by this factor.", "f", "1");
+    const QCommandLineOption doctorsOpt("doctors", "Number of doctors.", "n");
+    const QCommandLineOption patientsOpt("patients", "Number of patients.", "n");
+    const QCommandLineOption appointmentsOpt("appointments", "Number of appointments.", "n");
+    const QCommandLineOption casesOpt("cases", "Number of medical cases.", "n");
+    const QCommandLineOption diagnosesOpt("diagnoses", "Number of diagnoses (encounters).", "n");
+    const QCommandLineOption iterationsOpt("iterations", "Timed calls per write operation.", "n", "2000");
+    const QCommandLineOption loginOpt("login-iterations", "Timed calls for scrypt-bound operations.", "n", "50");
+    const QCommandLineOption skipOpt("skip-generate", "Reuse the data already in --db.");
+    const QCommandLineOption keepOpt("keep", "Do not delete an existing --db before generating.");
+    const QCommandLineOption hashOpt("hash-target-ms", "Calibrate scrypt to about this many ms per hash on this host.", "ms");
+    parser.addOptions({ dbOpt, outOpt, labelOpt, seedOpt, scaleOpt, doctorsOpt, patientsOpt, appointmentsOpt,
+                        casesOpt, diagnosesOpt, iterationsOpt, loginOpt, skipOpt, keepOpt, hashOpt });
+    parser.process(app);
+
+    DataGenerator::Config gen;
+    const double scale = parser.value(scaleOpt).toDouble();
+    if (scale > 0 && scale != 1) {
+        gen.doctors = qMax(1, int(gen.doctors * scale));
+        gen.patients = qMax(1, int(gen.patients * scale));
+        gen.appointments = int(gen.appointments * scale);
+        gen.cases = int(gen.cases * scale);
+        gen.diagnoses = int(gen.diagnoses * scale);
+    }
+    if (parser.isSet(doctorsOpt)) gen.doctors = parser.value(doctorsOpt).toInt();
+    if (parser.isSet(patientsOpt)) gen.patients = parser.value(patientsOpt).toInt();
+    if (parser.isSet(appointmentsOpt)) gen.appointments = parser.value(appointmentsOpt).toInt();
+    if (parser.isSet(casesOpt)) gen.cases = parser.value(casesOpt).toInt();
+    if (parser.isSet(diagnosesOpt)) gen.diagnoses = parser.value(diagnosesOpt).toInt();
+    gen.seed = parser.value(seedOpt).toUInt();
+
+    DatabaseBenchmark::Options bench;
+    bench.iterations = parser.value(iterationsOpt).toInt();
+    bench.loginIterations = parser.value(loginOpt).toInt();
+    bench.seed = gen.seed;
+    bench.password = gen.password;
+
+    // 必须在第一次 Database::instance() 之前
+    const QString dbPath = parser.value(dbOpt);
+    const bool generate = !parser.isSet(skipOpt);
+    if (generate && !parser.isSet(keepOpt)) {
+        for (const QString &suffix : { QString(), QString("-wal"), QString("-shm") }) QFile::remove(dbPath + suffix);
+    }
+    Database::ConnectionProfile profile = Database::connectionProfile();
+    profile.databaseName = dbPath;
+    Database::setConnectionProfile(profile);
+    AuditLog::Options audit;
+    audit.policy = AuditLog::Block; // 不丢审计，否则写路径的开销偏低
+    AuditLog::setOptions(audit);
+    QueryStats::setEnabled(true); // 发布构建默认关闭，queryStats 要靠它
+
+    // 按本机校准哈希参数，authenticate 等操作的耗时才能代表部署时的设置
+    PasswordHasher &hasher = PasswordHasher::instance();
+    QJsonObject hashJson;
+    if (parser.isSet(hashOpt)) {
+        double measuredMs = 0;
+        hasher.setParams(PasswordHasher::calibrate(parser.value(hashOpt).toInt(), hasher.params(), &measuredMs));
+        hashJson["calibratedMs"] = measuredMs;
+        qDebug() << "dbbench: scrypt logN =" << hasher.params().logN << "," << measuredMs << "ms per hash";
+    }
+    hashJson["logN"] = hasher.params().logN;
+    hashJson["r"] = hasher.params().r;
+    hashJson["p"] = hasher.params().p;
+
+    DataGenerator::Summary dataset;
+    if (generate) {
+        dataset = DataGenerator(gen).generate();
+    } else {
+        dataset = loadSummary(gen);
+    }
+    if (!dataset.ok) {
+        qWarning() << "dbbench: no usable dataset in" << dbPath;
+        return 1;
+    }
+    AuditLog::instance().flush();
+
+    // 热点查询的执行计划出现全表扫描或临时 B 树就算失败：结果照常写出，退出码非零
+    const QStringList planProblems = Database::instance().queryPlanProblems();
+    for (const QString &p : planProblems) qWarning().noquote() << "dbbench: query plan:" << p;
+    QueryStats::reset();
+
+    QElapsedTimer timer;
+    timer.start();
+    const QVector<DatabaseBenchmark::OpResult> results = DatabaseBenchmark(bench, dataset).run();
+    AuditLog::instance().shutdown();
+
+    QJsonArray ops;
+    for (const DatabaseBenchmark::OpResult &r : results) ops.append(r.toJson());
+    QJsonObject root;
+    root["label"] = parser.value(labelOpt);
+    root["startedAt"] = QDateTime::currentDateTimeUtc().toString(Qt::ISODate);
+    root["qtVersion"] = QString::fromLatin1(qVersion());
+    root["host"] = QSysInfo::prettyProductName() + " " + QSysInfo::currentCpuArchitecture();
+    root["config"] = configJson(gen, bench);
+    root["passwordHasher"] = hashJson;
+    root["dataset"] = dataset.toJson();
+    root["benchmarkMs"] = double(timer.elapsed());
+    root["operations"] = ops;
+    root["queryPlanProblems"] = QJsonArray::fromStringList(planProblems);
+    root["queryStats"] = queryStatsJson();
+    root["recordCache"] = recordCacheJson();
+    root["storage"] = storageJson();
+    const QByteArray json = QJsonDocument(root).toJson(QJsonDocument::Indented);
+
+    if (!parser.isSet(outOpt)) {
+        QFile out;
+        out.open(stdout, QIODevice::WriteOnly);
+        out.write(json);
+        return planProblems.isEmpty() ? 0 : 2;
+    }
+    QSaveFile out(parser.value(outOpt));
+    if (!out.open(QIODevice::WriteOnly) || out.write(json) != json.size() || !out.commit()) {
+        qWarning() << "dbbench: cannot write" << parser.value(outOpt) << out.errorString();
+        return 1;
+    }
+    return planProblems.isEmpty() ? 0 : 2;
+}
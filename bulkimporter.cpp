@@ -0,0 +1,360 @@
+#include "bulkimporter.h"
+#include "sqltime.h"
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QThread>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+namespace {
+const int kMaxRecordBytes = 1024 * 1024; // 一条 CSV 记录的上限，防止引号没闭合时把整个文件读进内存
+
+// 拆一条 CSV 记录（RFC 4180：双引号包裹，"" 转义，引号内可以有逗号和换行）。
+// 引号没有闭合时返回 false，调用方应该再读一行拼上
+bool splitCsv(const QString &text, QStringList &fields)
+{
+    fields.clear();
+    QString cur;
+    bool inQuotes = false;
+    for (int i = 0; i < text.size(); ++i) {
+        const QChar ch = text.at(i);
+        if (inQuotes) {
+            if (ch == '"') {
+                if (i + 1 < text.size() && text.at(i + 1) == '"') {
+                    cur += '"';
+                    ++i;
+                } else {
+                    inQuotes = false;
+                }
+            } else {
+                cur += ch;
+            }
+        } else if (ch == '"') {
+            inQuotes = true;
+        } else if (ch == ',') {
+            fields << cur;
+            cur.clear();
+        } else {
+            cur += ch;
+        }
+    }
+    if (inQuotes) return false;
+    fields << cur;
+    return true;
+}
+
+QByteArray chopLineEnd(QByteArray line)
+{
+    while (line.endsWith('\n') || line.endsWith('\r')) line.chop(1);
+    return line;
+}
+
+QString describe(RegistrationResult::Status status, const RegistrationRequest &req)
+{
+    switch (status) {
+    case RegistrationResult::UsernameTaken: return QString("username already exists: %1").arg(req.username);
+    case RegistrationResult::IdNumberTaken: return QString("id_number already exists: %1").arg(req.idNumber);
+    case RegistrationResult::LicenseTaken: return QString("license_number already exists: %1").arg(req.licenseNumber);
+    default: return QString("database error");
+    }
+}
+}
+
+// 解析线程 → 写入方的有界队列；写入方 close() 后 push 不再阻塞
+class BulkImporter::Queue
+{
+public:
+    explicit Queue(int capacity) : capacity(size_t(qMax(1, capacity))) {}
+
+    bool push(Item item)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        notFull.wait(lock, [this] { return closed || items.size() < capacity; });
+        if (closed) return false;
+        items.push_back(std::move(item));
+        notEmpty.notify_one();
+        return true;
+    }
+
+    void pop(Item &item)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        notEmpty.wait(lock, [this] { return !items.empty(); });
+        item = std::move(items.front());
+        items.pop_front();
+        notFull.notify_one();
+    }
+
+    void close()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        notFull.notify_all();
+    }
+
+private:
+    const size_t capacity;
+    std::mutex mutex;
+    std::condition_variable notFull;
+    std::condition_variable notEmpty;
+    std::deque<Item> items;
+    bool closed = false;
+};
+
+BulkImporter::BulkImporter(const Options &options)
+    : opts(options)
+{
+    opts.chunkSize = qMax(1, opts.chunkSize);
+}
+
+BulkImporter::Format BulkImporter::effectiveFormat() const
+{
+    if (opts.format != AutoDetect) return opts.format;
+    const QString suffix = QFileInfo(opts.filePath).suffix().toLower();
+    return (suffix == "jsonl" || suffix == "ndjson") ? JsonLines : Csv;
+}
+
+bool BulkImporter::toRequest(const QHash<QString, QString> &fields, RegistrationRequest &req, QString &error) const
+{
+    auto get = [&fields](const char *key) { return fields.value(QLatin1String(key)).trimmed(); };
+    req.username = get("username");
+    req.email = get("email");
+    req.fullName = get("full_name");
+    req.phone = get("phone");
+    req.passwordHash = "!"; // 不是任何合法哈希，登录一定失败
+    if (req.fullName.isEmpty()) {
+        error = "full_name is empty";
+        return false;
+    }
+    if (opts.kind == Patients) {
+        req.role = "患者";
+        const QString dateOfBirth = get("date_of_birth");
+        req.dateOfBirth = SqlTime::parseDate(dateOfBirth);
+        if (!dateOfBirth.isEmpty() && !req.dateOfBirth.isValid()) {
+            error = QString("bad date_of_birth: %1").arg(dateOfBirth);
+            return false;
+        }
+        req.idNumber = get("id_number");
+        req.post = get("post");
+        req.gender = get("gender");
+        if (req.username.isEmpty() && !req.idNumber.isEmpty()) req.username = "p_" + req.idNumber;
+    } else {
+        req.role = "医生";
+        req.specialty = get("specialty");
+        req.licenseNumber = get("license_number");
+        req.clinicAddress = get("clinic_address");
+        if (req.username.isEmpty() && !req.licenseNumber.isEmpty()) req.username = "d_" + req.licenseNumber;
+    }
+    if (req.username.isEmpty()) {
+        error = opts.kind == Patients ? "username and id_number are both empty"
+                                      : "username and license_number are both empty";
+        return false;
+    }
+    return true;
+}
+
+// 解析线程：逐条读文件，每条记录连同它之后的文件位置一起入队
+void BulkImporter::parse(Queue &queue, qint64 startOffset, qint64 startLine)
+{
+    Item end;
+    end.end = true;
+
+    QFile file(opts.filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        end.error = QString("cannot open %1: %2").arg(opts.filePath, file.errorString());
+        queue.push(end);
+        return;
+    }
+    const bool csv = effectiveFormat() == Csv;
+    qint64 lineNo = 0;
+
+    // 读一条记录；CSV 的引号内换行会跨多行
+    auto readRecord = [&](QByteArray &raw, QString &text, QStringList *csvFields) -> bool {
+        const bool atStart = file.pos() == 0;
+        raw = file.readLine();
+        ++lineNo;
+        if (atStart && raw.startsWith("\xEF\xBB\xBF")) raw.remove(0, 3); // UTF-8 BOM
+        text = QString::fromUtf8(chopLineEnd(raw));
+        if (!csvFields) return true;
+        while (!splitCsv(text, *csvFields)) {
+            if (file.atEnd() || raw.size() > kMaxRecordBytes) return false;
+            raw += file.readLine();
+            ++lineNo;
+            text = QString::fromUtf8(chopLineEnd(raw));
+        }
+        return true;
+    };
+
+    QByteArray raw;
+    QString text;
+    QStringList header;
+    if (csv) {
+        if (file.atEnd() || !readRecord(raw, text, &header) || text.trimmed().isEmpty()) {
+            end.error = "CSV header is missing";
+            queue.push(end);
+            return;
+        }
+        for (QString &name : header) name = name.trimmed().toLower();
+    }
+    if (startOffset > file.pos()) {
+        if (!file.seek(startOffset)) {
+            end.error = QString("cannot seek to %1").arg(startOffset);
+            queue.push(end);
+            return;
+        }
+        lineNo = startLine;
+    }
+
+    QStringList values;
+    while (!cancelled && !file.atEnd()) {
+        Item item;
+        item.lineNo = lineNo + 1;
+        const bool complete = readRecord(raw, text, csv ? &values : nullptr);
+        item.endLine = lineNo;
+        item.endOffset = file.pos();
+        if (complete && text.trimmed().isEmpty()) continue; // 空行
+
+        QHash<QString, QString> fields;
+        if (!complete) {
+            item.error = "unterminated quoted field";
+        } else if (csv) {
+            if (values.size() != header.size()) {
+                item.error = QString("expected %1 columns, got %2").arg(header.size()).arg(values.size());
+            } else {
+                for (int i = 0; i < header.size(); ++i) fields.insert(header.at(i), values.at(i));
+            }
+        } else {
+            QJsonParseError err;
+            const QJsonDocument doc = QJsonDocument::fromJson(text.toUtf8(), &err);
+            if (err.error != QJsonParseError::NoError || !doc.isObject()) {
+                item.error = err.error != QJsonParseError::NoError ? err.errorString() : QString("not a JSON object");
+            } else {
+                const QJsonObject obj = doc.object();
+                for (auto it = obj.constBegin(); it != obj.constEnd(); ++it)
+                    fields.insert(it.key().toLower(), it.value().toVariant().toString());
+            }
+        }
+        if (item.error.isEmpty()) toRequest(fields, item.req, item.error);
+        if (!queue.push(std::move(item))) return; // 写入方已经停了
+    }
+    queue.push(end);
+}
+
+BulkImporter::Report BulkImporter::run(std::function<void(const Report &)> onChunk)
+{
+    Report report;
+    const QFileInfo info(opts.filePath);
+    if (!info.exists()) {
+        report.error = QString("file not found: %1").arg(opts.filePath);
+        return report;
+    }
+    Database &db = Database::instance();
+
+    // 断点：文件大小变了说明不是同一个文件，旧断点作废
+    ImportProgress progress;
+    progress.source = info.absoluteFilePath();
+    progress.fileSize = info.size();
+    ImportProgress saved;
+    if (opts.resume && db.loadImportProgress(progress.source, saved)) {
+        if (saved.fileSize != progress.fileSize) {
+            qWarning() << "BulkImporter: file size changed since last run, starting over:" << progress.source;
+            db.resetImportProgress(progress.source);
+        } else if (saved.finished) {
+            report.progress = saved;
+            report.resumedFromOffset = saved.byteOffset;
+            report.completed = true;
+            return report;
+        } else {
+            progress = saved;
+        }
+    } else if (!opts.resume) {
+        db.resetImportProgress(progress.source);
+    }
+    report.resumedFromOffset = progress.byteOffset;
+
+    QElapsedTimer timer;
+    timer.start();
+    Queue queue(opts.queueCapacity);
+    const qint64 startOffset = progress.byteOffset;
+    const qint64 startLine = progress.lineNo;
+    QThread *parser = QThread::create([this, &queue, startOffset, startLine] { parse(queue, startOffset, startLine); });
+    parser->setObjectName("ImportParser");
+    parser->start();
+
+    auto addSample = [&](qint64 line, const QString &what) {
+        if (report.rejectSamples.size() < opts.maxRejectSamples)
+            report.rejectSamples << QString("line %1: %2").arg(line).arg(what);
+    };
+
+    QVector<RegistrationRequest> batch;
+    QVector<qint64> batchLines;
+    batch.reserve(opts.chunkSize);
+    batchLines.reserve(opts.chunkSize);
+    QVector<RegistrationResult::Status> statuses;
+    auto flush = [&](bool last) -> bool {
+        progress.finished = last;
+        const qint64 insertedBefore = progress.inserted;
+        if (!db.importAccounts(batch, progress, &statuses)) {
+            report.error = "database error, chunk rolled back";
+            return false;
+        }
+        report.insertedThisRun += progress.inserted - insertedBefore;
+        for (int i = 0; i < statuses.size(); ++i) {
+            if (statuses.at(i) != RegistrationResult::Ok) addSample(batchLines.at(i), describe(statuses.at(i), batch.at(i)));
+        }
+        batch.clear();
+        batchLines.clear();
+        report.progress = progress;
+        report.elapsedMs = timer.elapsed();
+        report.rowsPerSec = report.rowsThisRun * 1000.0 / qMax<qint64>(1, report.elapsedMs);
+        if (onChunk) onChunk(report);
+        return true;
+    };
+
+    bool dbFailed = false;
+    for (;;) {
+        Item item;
+        queue.pop(item);
+        if (item.end) {
+            report.error = item.error;
+            break;
+        }
+        ++progress.rowsRead;
+        ++report.rowsThisRun;
+        progress.byteOffset = item.endOffset;
+        progress.lineNo = item.endLine;
+        if (!item.error.isEmpty()) {
+            ++progress.rejected; // 随下一次提交一起落盘
+            addSample(item.lineNo, item.error);
+        } else {
+            batch.append(item.req);
+            batchLines.append(item.lineNo);
+        }
+        if (batch.size() >= opts.chunkSize && !flush(false)) {
+            dbFailed = true;
+            break;
+        }
+        if (cancelled) break;
+    }
+    if (!dbFailed) {
+        const bool last = report.error.isEmpty() && !cancelled;
+        if (flush(last)) report.completed = last;
+    }
+
+    queue.close();
+    parser->wait();
+    delete parser;
+
+    report.cancelled = cancelled;
+    report.progress = progress;
+    report.elapsedMs = timer.elapsed();
+    report.rowsPerSec = report.rowsThisRun * 1000.0 / qMax<qint64>(1, report.elapsedMs);
+    qDebug() << "BulkImporter:" << progress.source << "rows" << report.rowsThisRun << "inserted" << report.insertedThisRun
+             << "rejected" << progress.rejected << "rows/s" << report.rowsPerSec;
+    return report;
+}
@@ -0,0 +1,78 @@
+#ifndef BULKIMPORTER_H
+#define BULKIMPORTER_H
+
+#include <QHash>
+#include <QString>
+#include <QStringList>
+#include <atomic>
+#include <functional>
+#include "database.h"
+
+// 从 CSV / JSONL 批量导入患者或医生（每行 = users 一行 + patients/doctors 一行）。
+// 解析在单独的线程里进行，通过有界队列交给写入方，内存占用与文件大小无关；
+// 写入按 chunkSize 分块提交，复用缓存的预编译语句，断点与数据在同一事务里记录，
+// 崩溃或取消后用同一个文件再跑一次会从上次提交的位置继续。
+//
+// 列名（CSV 表头 / JSON 键）与表字段同名：username, email, full_name, phone,
+// 患者 date_of_birth（yyyy-MM-dd 等，见 SqlTime::parseDate）, id_number, post, gender；
+// 医生 specialty, license_number, clinic_address。
+// username 为空时患者用 "p_<id_number>"，医生用 "d_<license_number>"。
+// 导入的账号没有可用密码（password_hash 为 "!"），需要管理员重置后才能登录。
+class BulkImporter
+{
+public:
+    enum Kind { Patients, Doctors };
+    enum Format { AutoDetect, Csv, JsonLines }; // AutoDetect：.jsonl / .ndjson 按 JSONL，其余按 CSV
+
+    struct Options {
+        QString filePath;
+        Kind kind = Patients;
+        Format format = AutoDetect;
+        int chunkSize = 1000;        // 每个事务的行数
+        int queueCapacity = 4096;    // 解析线程最多领先写入方多少行
+        bool resume = true;          // false：丢弃旧断点，从头导入
+        int maxRejectSamples = 100;  // Report::rejectSamples 最多保留多少条
+    };
+
+    struct Report {
+        ImportProgress progress;     // 累计值（包括之前中断的几次）
+        qint64 resumedFromOffset = 0;
+        qint64 rowsThisRun = 0;
+        qint64 insertedThisRun = 0;
+        qint64 elapsedMs = 0;
+        double rowsPerSec = 0;       // 本次运行
+        bool completed = false;      // 读到了文件末尾且全部提交
+        bool cancelled = false;
+        QString error;               // 非空表示因错误中止（已提交的块保留，可续传）
+        QStringList rejectSamples;   // "line 12: ..."
+    };
+
+    explicit BulkImporter(const Options &options);
+
+    // 阻塞直到导入结束，使用调用线程的 Database 连接：不要在 UI 线程调用。
+    // onChunk 在每个分块提交后（在调用线程里）调用
+    Report run(std::function<void(const Report &)> onChunk = nullptr);
+
+    // 可以在任何线程调用：当前分块提交后停止，断点保留
+    void cancel() { cancelled = true; }
+
+private:
+    struct Item {
+        qint64 lineNo = 0;           // 这条记录的起始行号（报告用）
+        qint64 endLine = 0;          // 读到 endOffset 为止的行数（续传用）
+        qint64 endOffset = 0;        // 这条记录之后的文件位置
+        RegistrationRequest req;
+        QString error;               // 非空表示这一行解析失败
+        bool end = false;            // 解析线程结束的标记
+    };
+    class Queue;
+
+    void parse(Queue &queue, qint64 startOffset, qint64 startLine);
+    bool toRequest(const QHash<QString, QString> &fields, RegistrationRequest &req, QString &error) const;
+    Format effectiveFormat() const;
+
+    Options opts;
+    std::atomic<bool> cancelled{false};
+};
+
+#endif // BULKIMPORTER_H
@@ -0,0 +1,73 @@
+#include "changenotifier.h"
+#include <QCoreApplication>
+#include <QMetaMethod>
+#include <QThread>
+#include <QTimer>
+
+namespace {
+QMutex g_optionsMutex;
+ChangeNotifier::Options g_options;
+}
+
+void ChangeNotifier::setOptions(const Options &options)
+{
+    QMutexLocker lock(&g_optionsMutex);
+    g_options = options;
+}
+
+ChangeNotifier &ChangeNotifier::instance()
+{
+    static ChangeNotifier inst;
+    return inst;
+}
+
+ChangeNotifier::ChangeNotifier()
+{
+    {
+        QMutexLocker lock(&g_optionsMutex);
+        opts = g_options;
+    }
+    opts.coalesceMs = qMax(0, opts.coalesceMs);
+    qRegisterMetaType<RowChange>("RowChange");
+    qRegisterMetaType<QVector<RowChange>>("QVector<RowChange>");
+    // 第一次调用可能发生在数据库线程（第一次提交），信号总是从主线程发出
+    if (QCoreApplication *app = QCoreApplication::instance()) {
+        if (thread() != app->thread()) moveToThread(app->thread());
+    }
+}
+
+void ChangeNotifier::publish(const QVector<RowChange> &changes)
+{
+    if (changes.isEmpty()) return;
+    static const QMetaMethod signal = QMetaMethod::fromSignal(&ChangeNotifier::rowsChanged);
+    if (!isSignalConnected(signal)) return;
+    {
+        QMutexLocker lock(&mutex);
+        pending += changes;
+        st.changes += changes.size();
+        if (flushScheduled) return;
+        flushScheduled = true;
+    }
+    // 到主线程再起定时器：调用方所在的线程不一定有事件循环
+    QMetaObject::invokeMethod(this, [this]() {
+        QTimer::singleShot(opts.coalesceMs, this, [this]() { flush(); });
+    }, Qt::QueuedConnection);
+}
+
+void ChangeNotifier::flush()
+{
+    QVector<RowChange> batch;
+    {
+        QMutexLocker lock(&mutex);
+        batch.swap(pending);
+        flushScheduled = false;
+        ++st.batches;
+    }
+    if (!batch.isEmpty()) emit rowsChanged(batch);
+}
+
+ChangeNotifier::Stats ChangeNotifier::stats() const
+{
+    QMutexLocker lock(&mutex);
+    return st;
+}
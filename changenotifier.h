@@ -0,0 +1,59 @@
+#ifndef CHANGENOTIFIER_H
+#define CHANGENOTIFIER_H
+
+#include <QMetaType>
+#include <QMutex>
+#include <QObject>
+#include <QVector>
+
+// 一行数据的变化。table 必须是字符串字面量（与 AuditRecord::objectType 一样只存指针）
+struct RowChange
+{
+    enum Op { Insert, Update, Delete };
+    const char *table = "";
+    Op op = Insert;
+    qint64 rowId = 0;
+};
+Q_DECLARE_METATYPE(RowChange)
+
+// 行变化通知：Database 的写接口在事务提交后把这次事务改过的行交给 publish()（回滚的不会发出），
+// 在 coalesceMs 内攒成一批，由 rowsChanged 在主线程发出，LiveQueryModel 据此增量更新。
+//
+// 只覆盖经过 Database 写接口的修改：外键级联删掉的子表行不会逐行通知（删除患者时只有 patients 的一条），
+// 别的进程写库也收不到。没有任何连接时 publish() 直接返回，不积累
+class ChangeNotifier : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Options {
+        int coalesceMs = 50;
+    };
+    // 要在第一次 instance() 之前设置
+    static void setOptions(const Options &options);
+    static ChangeNotifier &instance();
+
+    // 任何线程都可以调用
+    void publish(const QVector<RowChange> &changes);
+
+    struct Stats {
+        quint64 changes = 0;
+        quint64 batches = 0;
+    };
+    Stats stats() const;
+
+signals:
+    void rowsChanged(const QVector<RowChange> &changes);
+
+private:
+    ChangeNotifier();
+    void flush();
+
+    Options opts;
+    mutable QMutex mutex;
+    QVector<RowChange> pending;
+    bool flushScheduled = false;
+    Stats st;
+};
+
+#endif // CHANGENOTIFIER_H
@@ -1,599 +1,2212 @@
 #include "database.h"
+#include "aggregates.h"
+#include "appointmentscheduler.h"
+#include "auditlog.h"
+#include "changenotifier.h"
+#include "fulltextsearch.h"
+#include "migrations.h"
+#include "livequerymodel.h"
+#include "pagedquerymodel.h"
+#include "querystats.h"
+#include "recordcache.h"
+#include "sqltime.h"
+#include "passwordhasher.h"
 #include <QDebug>
-#include <QCryptographicHash>
+#include <QAtomicInteger>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QSqlRecord>
+#include <QMutex>
+#include <QThread>
+#include <QThreadStorage>
+#include <limits>
 
-Database::Database()
+// 热点查询的 SQL，queryPlanProblems() 会检查它们的执行计划
+static const char *const kFindUserSql =
+    "SELECT id, username, email, password_hash, role, is_active, created_at FROM users WHERE username = :u";
+static const char *const kAppointmentsForDoctorSql = R"(
+        SELECT a.id, a.scheduled_at, a.status, a.reason, p.full_name AS patient_name, p.phone AS patient_phone
+        FROM appointments a
+        JOIN patients p ON p.id = a.patient_id
+        WHERE a.doctor_id = :did
+        ORDER BY a.scheduled_at ASC
+    )";
+static const char *const kCasesForPatientSql = R"(
+        SELECT id, title, description, attachments, created_at
+        FROM medical_cases
+        WHERE patient_id = :pid
+        ORDER BY created_at DESC
+    )";
+static const char *const kPrescriptionsForPatientSql = R"(
+        SELECT pr.id, pr.medication_name, pr.dosage, pr.frequency, pr.duration, pr.issued_at, u.username AS prescriber
+        FROM prescriptions pr
+        JOIN users u ON u.id = pr.doctor_id
+        WHERE pr.patient_id = :pid
+        ORDER BY pr.issued_at DESC
+    )";
+static const char *const kDeletePatientSql = "DELETE FROM patients WHERE id = :id";
+
+// 下面几条 SELECT 的列顺序与对应的列下标枚举必须一致，读取时按下标取值
+static const char *const kFindPatientSql =
+    "SELECT id, full_name, date_of_birth, id_number, phone, post, gender, created_at FROM patients WHERE id = :id";
+static const char *const kFindDoctorSql =
+    "SELECT id, full_name, phone, specialty, license_number, clinic_address, created_at FROM doctors WHERE id = :id";
+static const char *const kAppointmentRowsForDoctorSql = R"(
+        SELECT id, patient_id, doctor_id, scheduled_at, status, reason, created_at, duration_minutes
+        FROM appointments
+        WHERE doctor_id = :did
+        ORDER BY scheduled_at ASC
+    )";
+// 排班：某医生从某时刻起的有效预约，和重叠检查（scheduled_at 向前放宽一天，时长不超过一天；时间是 Unix 秒）
+static const char *const kBookedSlotsForDoctorSql = R"(
+        SELECT id, scheduled_at, duration_minutes
+        FROM appointments
+        WHERE doctor_id = :did AND scheduled_at >= :from AND status <> 'cancelled'
+    )";
+static const char *const kDoctorsForSpecialtySql = "SELECT id FROM doctors WHERE specialty = :specialty";
+static const char *const kAppointmentOverlapSql = R"(
+        SELECT id FROM appointments
+        WHERE doctor_id = :did AND scheduled_at >= :earliest AND scheduled_at < :end
+          AND status <> 'cancelled'
+          AND scheduled_at + duration_minutes * 60 > :start
+        LIMIT 1
+    )";
+static const char *const kPrescriptionRowsForPatientSql = R"(
+        SELECT id, diagnosis_id, doctor_id, patient_id, medication_name, dosage, frequency, duration, notes, issued_at
+        FROM prescriptions
+        WHERE patient_id = :pid
+        ORDER BY issued_at DESC, id DESC
+    )";
+
+// 患者时间线的五路游标：各自沿 (patient_id, 时间) 索引倒序读，列统一成 TimelineCol 的顺序。
+// 参数：patient_id, 起始时间（含）, 键集上界 (时间, id)（不含）, limit
+static const char *const kTimelineAppointmentsSql = R"(
+        SELECT scheduled_at, id, doctor_id, reason, NULL, status, NULL
+        FROM appointments
+        WHERE patient_id = ? AND scheduled_at >= ? AND (scheduled_at, id) < (?, ?)
+        ORDER BY scheduled_at DESC, id DESC
+        LIMIT ?
+    )";
+static const char *const kTimelineCasesSql = R"(
+        SELECT created_at, id, created_by_doctor_id, title, description, NULL, NULL
+        FROM medical_cases
+        WHERE patient_id = ? AND created_at >= ? AND (created_at, id) < (?, ?)
+        ORDER BY created_at DESC, id DESC
+        LIMIT ?
+    )";
+static const char *const kTimelineDiagnosesSql = R"(
+        SELECT created_at, id, doctor_id, diagnosis_text, icd_codes, NULL, case_id
+        FROM diagnoses
+        WHERE patient_id = ? AND created_at >= ? AND (created_at, id) < (?, ?)
+        ORDER BY created_at DESC, id DESC
+        LIMIT ?
+    )";
+static const char *const kTimelineOrdersSql = R"(
+        SELECT created_at, id, doctor_id, order_text, order_type, status, diagnosis_id
+        FROM medical_orders
+        WHERE patient_id = ? AND created_at >= ? AND (created_at, id) < (?, ?)
+        ORDER BY created_at DESC, id DESC
+        LIMIT ?
+    )";
+static const char *const kTimelinePrescriptionsSql = R"(
+        SELECT issued_at, id, doctor_id, medication_name,
+               TRIM(COALESCE(dosage, '') || ' ' || COALESCE(frequency, '') || ' ' || COALESCE(duration, '')), NULL, diagnosis_id
+        FROM prescriptions
+        WHERE patient_id = ? AND issued_at >= ? AND (issued_at, id) < (?, ?)
+        ORDER BY issued_at DESC, id DESC
+        LIMIT ?
+    )";
+namespace TimelineCol { enum { At, Id, DoctorId, Title, Detail, Status, ParentId }; }
+static const struct { TimelineEvent::Type type; const char *label; const char *sql; } kTimelineSources[] = {
+    { TimelineEvent::Appointment, "timeline.appointments", kTimelineAppointmentsSql },
+    { TimelineEvent::MedicalCase, "timeline.cases", kTimelineCasesSql },
+    { TimelineEvent::Diagnosis, "timeline.diagnoses", kTimelineDiagnosesSql },
+    { TimelineEvent::MedicalOrder, "timeline.orders", kTimelineOrdersSql },
+    { TimelineEvent::Prescription, "timeline.prescriptions", kTimelinePrescriptionsSql },
+};
+
+namespace UserCol { enum { Id, Username, Email, PasswordHash, Role, IsActive, CreatedAt }; }
+namespace PatientCol { enum { Id, FullName, DateOfBirth, IdNumber, Phone, Post, Gender, CreatedAt }; }
+namespace DoctorCol { enum { Id, FullName, Phone, Specialty, LicenseNumber, ClinicAddress, CreatedAt }; }
+namespace AppointmentCol { enum { Id, PatientId, DoctorId, ScheduledAt, Status, Reason, CreatedAt, DurationMinutes }; }
+namespace PrescriptionCol { enum { Id, DiagnosisId, DoctorId, PatientId, MedicationName, Dosage, Frequency, Duration, Notes, IssuedAt }; }
+
+static void readUser(const QSqlQuery &q, UserRecord &u)
 {
-    // 使用唯一连接名
-    if (QSqlDatabase::contains("MedicalDB")) {
-        db = QSqlDatabase::database("MedicalDB");
-    } else {
-        db = QSqlDatabase::addDatabase("QSQLITE", "MedicalDB"); // 连接名
-        db.setDatabaseName("medical_system.db");
+    u.id = q.value(UserCol::Id).toInt();
+    u.username = q.value(UserCol::Username).toString();
+    u.email = q.value(UserCol::Email).toString();
+    u.passwordHash = q.value(UserCol::PasswordHash).toString();
+    u.role = q.value(UserCol::Role).toString();
+    u.isActive = q.value(UserCol::IsActive).toInt() != 0;
+    u.createdAt = SqlTime::dateTime(q.value(UserCol::CreatedAt));
+}
+
+static void readPatient(const QSqlQuery &q, PatientRecord &p)
+{
+    p.id = q.value(PatientCol::Id).toInt();
+    p.fullName = q.value(PatientCol::FullName).toString();
+    p.dateOfBirth = SqlTime::date(q.value(PatientCol::DateOfBirth));
+    p.idNumber = q.value(PatientCol::IdNumber).toString();
+    p.phone = q.value(PatientCol::Phone).toString();
+    p.post = q.value(PatientCol::Post).toString();
+    p.gender = q.value(PatientCol::Gender).toString();
+    p.createdAt = SqlTime::dateTime(q.value(PatientCol::CreatedAt));
+}
+
+static void readDoctor(const QSqlQuery &q, DoctorRecord &d)
+{
+    d.id = q.value(DoctorCol::Id).toInt();
+    d.fullName = q.value(DoctorCol::FullName).toString();
+    d.phone = q.value(DoctorCol::Phone).toString();
+    d.specialty = q.value(DoctorCol::Specialty).toString();
+    d.licenseNumber = q.value(DoctorCol::LicenseNumber).toString();
+    d.clinicAddress = q.value(DoctorCol::ClinicAddress).toString();
+    d.createdAt = SqlTime::dateTime(q.value(DoctorCol::CreatedAt));
+}
+
+static void readAppointment(const QSqlQuery &q, AppointmentRecord &a)
+{
+    a.id = q.value(AppointmentCol::Id).toInt();
+    a.patientId = q.value(AppointmentCol::PatientId).toInt();
+    a.doctorId = q.value(AppointmentCol::DoctorId).toInt();
+    a.scheduledAt = SqlTime::dateTime(q.value(AppointmentCol::ScheduledAt));
+    a.status = q.value(AppointmentCol::Status).toString();
+    a.reason = q.value(AppointmentCol::Reason).toString();
+    a.createdAt = SqlTime::dateTime(q.value(AppointmentCol::CreatedAt));
+    a.durationMinutes = q.value(AppointmentCol::DurationMinutes).toInt();
+}
+
+static void readPrescription(const QSqlQuery &q, PrescriptionRecord &p)
+{
+    p.id = q.value(PrescriptionCol::Id).toInt();
+    p.diagnosisId = q.value(PrescriptionCol::DiagnosisId).toInt();
+    p.doctorId = q.value(PrescriptionCol::DoctorId).toInt();
+    p.patientId = q.value(PrescriptionCol::PatientId).toInt();
+    p.medicationName = q.value(PrescriptionCol::MedicationName).toString();
+    p.dosage = q.value(PrescriptionCol::Dosage).toString();
+    p.frequency = q.value(PrescriptionCol::Frequency).toString();
+    p.duration = q.value(PrescriptionCol::Duration).toString();
+    p.notes = q.value(PrescriptionCol::Notes).toString();
+    p.issuedAt = SqlTime::dateTime(q.value(PrescriptionCol::IssuedAt));
+}
+
+static const char *const kInsertUserSql = R"(
+        INSERT INTO users(username, email, password_hash, role)
+        VALUES (:username, :email, :password_hash, :role)
+    )";
+static const char *const kInsertPatientSql = R"(
+        INSERT INTO patients (full_name, date_of_birth, id_number, phone, post, gender)
+        VALUES (:full_name, :date_of_birth, :id_number, :phone, :post, :gender)
+    )";
+static const char *const kInsertPatientWithIdSql =
+    "INSERT INTO patients (id, full_name, date_of_birth, id_number, phone, post, gender) VALUES (?, ?, ?, ?, ?, ?, ?)";
+static const char *const kInsertDoctorSql =
+    "INSERT INTO doctors (id, full_name, phone, specialty, license_number, clinic_address) VALUES (?, ?, ?, ?, ?, ?)";
+static const char *const kUpdateDoctorSql =
+    "UPDATE doctors SET full_name = ?, phone = ?, specialty = ?, license_number = ?, clinic_address = ? WHERE id = ?";
+static const char *const kInsertMedicalCaseSql = R"(
+        INSERT INTO medical_cases (patient_id, created_by_doctor_id, title, description, attachments)
+        VALUES (:patient_id, :doctor_id, :title, :description, :attachments)
+    )";
+static const char *const kInsertAppointmentSql = R"(
+        INSERT INTO appointments (patient_id, doctor_id, scheduled_at, status, reason)
+        VALUES (:patient_id, :doctor_id, :scheduled_at, :status, :reason)
+    )";
+static const char *const kInsertTimedAppointmentSql = R"(
+        INSERT INTO appointments (patient_id, doctor_id, scheduled_at, duration_minutes, status, reason)
+        VALUES (:patient_id, :doctor_id, :scheduled_at, :duration, :status, :reason)
+    )";
+static const char *const kInsertDiagnosisSql = R"(
+        INSERT INTO diagnoses (case_id, appointment_id, doctor_id, patient_id, diagnosis_text, icd_codes)
+        VALUES (:case_id, :appointment_id, :doctor_id, :patient_id, :diagnosis_text, :icd_codes)
+    )";
+static const char *const kInsertMedicalOrderSql = R"(
+        INSERT INTO medical_orders (diagnosis_id, doctor_id, patient_id, order_text, order_type, status)
+        VALUES (:diagnosis_id, :doctor_id, :patient_id, :order_text, :order_type, :status)
+    )";
+static const char *const kInsertPrescriptionSql = R"(
+        INSERT INTO prescriptions (diagnosis_id, doctor_id, patient_id, medication_name, dosage, frequency, duration, notes)
+        VALUES (:diagnosis_id, :doctor_id, :patient_id, :medication_name, :dosage, :frequency, :duration, :notes)
+    )";
+
+// 全文检索（见 fulltextsearch.h）。ORDER BY rank 是 FTS5 内置的 bm25 排序；
+// 摘要要用的原文只对这一页的结果按主键取，拼接方式与 FullTextSearch::rebuild() 一致
+static const char *const kInsertSearchDocSql =
+    "INSERT INTO search_index (rowid, patient_id, body) VALUES (:rowid, :patient_id, :body)";
+static const char *const kSearchSql = R"(
+        SELECT rowid, patient_id, rank
+        FROM search_index
+        WHERE search_index MATCH :match
+        ORDER BY rank
+        LIMIT :limit OFFSET :offset
+    )";
+static const char *const kSearchForPatientSql = R"(
+        SELECT rowid, patient_id, rank
+        FROM search_index
+        WHERE search_index MATCH :match AND patient_id = :pid
+        ORDER BY rank
+        LIMIT :limit OFFSET :offset
+    )";
+static const char *const kCaseTextSql =
+    "SELECT COALESCE(title, '') || char(10) || COALESCE(description, '') FROM medical_cases WHERE id = :id";
+static const char *const kDiagnosisTextSql =
+    "SELECT COALESCE(diagnosis_text, '') || char(10) || COALESCE(icd_codes, '') FROM diagnoses WHERE id = :id";
+static const char *const kPrescriptionTextSql =
+    "SELECT COALESCE(medication_name, '') || char(10) || COALESCE(notes, '') FROM prescriptions WHERE id = :id";
+static const int kSnippetChars = 80;
+
+// 统计汇总（见 aggregates.h）：都沿汇总表的主键或索引有序读取，不排序
+static const char *const kAppointmentCountsForDoctorSql = R"(
+        SELECT doctor_id, day, status, n FROM stats_appointments_daily
+        WHERE doctor_id = :did AND day >= :from AND day <= :to
+        ORDER BY day, status
+    )";
+static const char *const kAppointmentCountsForDaySql = R"(
+        SELECT doctor_id, day, status, n FROM stats_appointments_daily
+        WHERE day = :day
+        ORDER BY doctor_id, status
+    )";
+static const char *const kTopMedicationsSql =
+    "SELECT medication_name, n FROM stats_medications ORDER BY n DESC, medication_name LIMIT :limit";
+static const char *const kTopIcdCodesSql =
+    "SELECT code, n FROM stats_icd_codes ORDER BY n DESC, code LIMIT :limit";
+
+// 诊断的 ICD 编码（schema v9）。patient_id / created_at 从刚插入的诊断行取，与它完全一致
+static const char *const kInsertDiagnosisCodeSql = R"(
+        INSERT INTO diagnosis_codes (diagnosis_id, code, patient_id, created_at)
+        SELECT id, :code, patient_id, created_at FROM diagnoses WHERE id = :id
+    )";
+// 沿 (code, patient_id) 索引按患者分组，不排序
+static const char *const kPatientsWithIcdCodeSql = R"(
+        SELECT patient_id, COUNT(*), MAX(created_at)
+        FROM diagnosis_codes
+        WHERE code = :code AND patient_id > :after
+        GROUP BY patient_id
+        ORDER BY patient_id
+        LIMIT :limit
+    )";
+// 前缀用范围 [prefix, prefix + U+FFFF) 走 code 索引（LIKE 默认不区分大小写，用不上索引）；
+// 有时间范围时改走 created_at 索引，code 前面的 + 让优化器不去选 code 索引
+static const char *const kIcdRollupSql = R"(
+        SELECT substr(code, 1, :len), COUNT(*), COUNT(DISTINCT patient_id)
+        FROM diagnosis_codes
+        WHERE code >= :lo AND code < :hi
+        GROUP BY 1
+        ORDER BY 1
+    )";
+static const char *const kIcdRollupInRangeSql = R"(
+        SELECT substr(code, 1, :len), COUNT(*), COUNT(DISTINCT patient_id)
+        FROM diagnosis_codes
+        WHERE created_at >= :from AND created_at < :to AND +code >= :lo AND +code < :hi
+        GROUP BY 1
+        ORDER BY 1
+    )";
+
+namespace {
+// 连接获取统计（所有线程共享）
+QAtomicInteger<quint64> g_acquisitions;
+QAtomicInteger<quint64> g_opens;
+QAtomicInteger<quint64> g_budgetOverruns;
+QAtomicInteger<qint64> g_maxAcquireNs;
+QAtomicInteger<qint64> g_acquireBudgetNs(50 * 1000);
+// 超预算的日志最多每 10 秒一条：instance() 是热路径，争用时每次都打日志只会更慢
+const qint64 kOverrunLogIntervalMs = 10 * 1000;
+QAtomicInteger<qint64> g_lastOverrunLogMs;
+
+// 新连接使用的配置（setConnectionProfile 之后打开的连接生效）
+QMutex g_profileMutex;
+Database::ConnectionProfile g_profile;
+
+// 建表等初始化工作每个进程只做一次
+QMutex g_schemaMutex;
+bool g_schemaReady = false;
+
+void recordAcquire(qint64 ns)
+{
+    g_acquisitions.fetchAndAddRelaxed(1);
+    qint64 cur = g_maxAcquireNs.loadRelaxed();
+    while (ns > cur && !g_maxAcquireNs.testAndSetRelaxed(cur, ns, cur)) {}
+    if (ns > g_acquireBudgetNs.loadRelaxed()) {
+        const quint64 overruns = g_budgetOverruns.fetchAndAddRelaxed(1) + 1;
+        const qint64 now = QDateTime::currentMSecsSinceEpoch();
+        const qint64 last = g_lastOverrunLogMs.loadRelaxed();
+        if (now - last >= kOverrunLogIntervalMs && g_lastOverrunLogMs.testAndSetRelaxed(last, now))
+            qWarning() << "Database::instance() over budget:" << ns << "ns," << overruns << "overruns so far";
+    }
+}
+}
+
+Database &Database::instance()
+{
+    // 线程结束时 QThreadStorage 会 delete 实例，从而关闭该线程的连接
+    static QThreadStorage<Database *> perThread;
+    QElapsedTimer timer;
+    timer.start();
+    if (!perThread.hasLocalData()) {
+        perThread.setLocalData(new Database);
+        g_acquisitions.fetchAndAddRelaxed(1); // 首次打开不计入预算
+        return *perThread.localData();
     }
+    Database *inst = perThread.localData();
+    recordAcquire(timer.nsecsElapsed());
+    return *inst;
+}
+
+Database::ConnectionStats Database::connectionStats()
+{
+    ConnectionStats st;
+    st.acquisitions = g_acquisitions.loadRelaxed();
+    st.opens = g_opens.loadRelaxed();
+    st.budgetOverruns = g_budgetOverruns.loadRelaxed();
+    st.maxAcquireNs = g_maxAcquireNs.loadRelaxed();
+    return st;
+}
+
+void Database::setAcquireBudgetNs(qint64 ns)
+{
+    g_acquireBudgetNs.storeRelaxed(ns);
+}
+
+Database::ConnectionProfile Database::connectionProfile()
+{
+    QMutexLocker locker(&g_profileMutex);
+    return g_profile;
+}
+
+void Database::setConnectionProfile(const ConnectionProfile &profile)
+{
+    QMutexLocker locker(&g_profileMutex);
+    g_profile = profile;
+}
+
+Database::Database()
+{
+    // 每个线程使用自己的连接名（QSqlDatabase 连接不能跨线程使用）
+    connectionName = QString("MedicalDB_%1").arg(reinterpret_cast<quintptr>(QThread::currentThreadId()));
+    db = QSqlDatabase::addDatabase("QSQLITE", connectionName);
+    profile = connectionProfile();
+    db.setDatabaseName(profile.databaseName);
 
     if (!db.open()) {
         qWarning() << "Failed to open database:" << db.lastError().text();
         return;
     }
+    g_opens.fetchAndAddRelaxed(1);
 
-    // 启用 SQLite 外键约束（重要）
+    // 启用 SQLite 外键约束（重要，每个连接都要设置一次）
     {
         QSqlQuery pragma(db);
         pragma.exec("PRAGMA foreign_keys = ON;");
     }
-    // 创建表（如果需要）
-    if (!createTablesIfNeeded()) {
-        qWarning() << "Failed to create tables";
+    applyProfile();
+    // 升级 schema（如果需要）：整个进程只做一次，已是最新版本时只读一次 user_version
+    QMutexLocker locker(&g_schemaMutex);
+    if (!g_schemaReady) {
+        if (!migrateSchema()) {
+            qWarning() << "Failed to migrate schema";
+        } else {
+            g_schemaReady = true;
+        }
+    }
+}
+
+// 连接级 PRAGMA：只在打开连接时执行一次。PRAGMA 不支持绑定参数，值都来自 ConnectionProfile
+void Database::applyProfile()
+{
+    QSqlQuery q(db);
+    // busy_timeout 要最先设置，后面切换 WAL 时可能需要等锁
+    q.exec(QString("PRAGMA busy_timeout = %1").arg(profile.busyTimeoutMs));
+    if (!profile.journalMode.isEmpty()) {
+        if (!q.exec(QString("PRAGMA journal_mode = %1").arg(profile.journalMode)) || !q.next()) {
+            qWarning() << "set journal_mode error:" << q.lastError().text();
+        } else if (q.value(0).toString().compare(profile.journalMode, Qt::CaseInsensitive) != 0) {
+            // 例如网络文件系统上不支持 WAL，SQLite 会保留原来的模式
+            qWarning() << "journal_mode is" << q.value(0).toString() << "instead of" << profile.journalMode;
+        }
+        q.finish();
+    }
+    if (!profile.synchronous.isEmpty())
+        q.exec(QString("PRAGMA synchronous = %1").arg(profile.synchronous));
+    if (profile.cacheSizeKiB > 0)
+        q.exec(QString("PRAGMA cache_size = -%1").arg(profile.cacheSizeKiB)); // 负数表示 KiB
+    if (profile.mmapSize >= 0)
+        q.exec(QString("PRAGMA mmap_size = %1").arg(profile.mmapSize));
+    if (!profile.tempStore.isEmpty())
+        q.exec(QString("PRAGMA temp_store = %1").arg(profile.tempStore));
+    if (profile.walAutoCheckpointPages >= 0)
+        q.exec(QString("PRAGMA wal_autocheckpoint = %1").arg(profile.walAutoCheckpointPages));
+    if (profile.journalSizeLimit >= 0)
+        q.exec(QString("PRAGMA journal_size_limit = %1").arg(profile.journalSizeLimit));
+}
+
+// 手动检查点。truncate=true 时等待读者结束并把 -wal 文件截断为 0
+bool Database::checkpoint(bool truncate)
+{
+    if (!db.isOpen()) return false;
+    if (txDepth > 0) return false; // 事务中做检查点没有意义
+    QSqlQuery q(db);
+    if (!q.exec(truncate ? "PRAGMA wal_checkpoint(TRUNCATE)" : "PRAGMA wal_checkpoint(PASSIVE)") || !q.next()) {
+        qWarning() << "wal_checkpoint error:" << q.lastError().text();
+        return false;
+    }
+    // 结果：busy, log 页数, 已检查点页数
+    const bool busy = q.value(0).toInt() != 0;
+    if (busy) qWarning() << "wal_checkpoint could not complete, readers still active";
+    return !busy;
+}
+
+bool Database::walOversized() const
+{
+    if (profile.walSizeLimitBytes <= 0) return false;
+    const QFileInfo wal(db.databaseName() + "-wal");
+    return wal.exists() && wal.size() > profile.walSizeLimitBytes;
+}
+
+// 每次自动提交的写操作之后调用。wal_autocheckpoint 在读者持续存在时完成不了，
+// -wal 会一直增长；所以每隔若干次写检查一下文件大小，超过上限就做一次 PASSIVE 检查点。
+// 写路径上不做 TRUNCATE：它要等读者结束，调用方的写会跟着卡住，最长 busy_timeout。截断留给 checkpointIfIdle()
+void Database::noteWrite()
+{
+    if (txDepth > 0) return;
+    if (profile.walCheckInterval <= 0 || profile.walSizeLimitBytes <= 0) return;
+    if (++writesSinceWalCheck < profile.walCheckInterval) return;
+    writesSinceWalCheck = 0;
+    if (walOversized()) checkpoint(false);
+}
+
+// 空闲时调用（AsyncDatabase 的任务队列空了之后）：-wal 仍超过上限就做 TRUNCATE 检查点
+bool Database::checkpointIfIdle()
+{
+    if (txDepth > 0 || !db.isOpen() || !walOversized()) return false;
+    return checkpoint(true);
+}
+
+bool Database::migrateSchema()
+{
+    return Migrations::migrate(db);
+}
+
+// 所有语句都经过这里执行：开启统计时记耗时、影响行数、出错和 SQLITE_BUSY（见 querystats.h）。
+// 读语句只计 exec 本身（SQLite 的第一步，排序和聚合在这一步完成），读到的行数由调用方补记
+bool Database::execTimed(QSqlQuery &q, const char *label)
+{
+    if (!QueryStats::enabled()) return q.exec();
+    const qint64 start = QueryStats::nowNs();
+    const bool ok = q.exec();
+    const qint64 elapsed = QueryStats::nowNs() - start;
+    const qint64 rows = ok && !q.isSelect() ? q.numRowsAffected() : -1;
+    QueryStats::record(label, elapsed, rows, ok, !ok && QueryStats::isBusyError(q.lastError()), q);
+    return ok;
+}
+
+// 每个连接的预编译语句缓存：同一条 SQL 只 prepare 一次，之后只重新绑定和执行。
+// key 是 SQL 常量的地址，所以只能传入上面这些 static 常量或字符串字面量
+QSqlQuery *Database::prepared(const char *sql)
+{
+    auto it = stmtCache.find(sql);
+    if (it != stmtCache.end()) {
+        ++stmtStats.hits;
+        return &it->second;
+    }
+    ++stmtStats.misses;
+    QSqlQuery q(db);
+    if (!q.prepare(QString::fromUtf8(sql))) {
+        qWarning() << "prepare failed:" << q.lastError().text() << sql;
+        return nullptr;
+    }
+    return &stmtCache.emplace(sql, q).first->second;
+}
+
+Database::StatementCacheStats Database::statementCacheStats() const
+{
+    return stmtStats;
+}
+
+// 用 EXPLAIN QUERY PLAN 检查热点查询：出现全表扫描或临时排序就记一条问题
+QStringList Database::queryPlanProblems()
+{
+    QStringList problems;
+    if (!db.isOpen()) {
+        problems << "database not open";
+        return problems;
+    }
+    const struct { const char *label; const char *sql; } hot[] = {
+        { "findUserByUsername", kFindUserSql },
+        { "appointmentsForDoctorModel", kAppointmentsForDoctorSql },
+        { "casesForPatientModel", kCasesForPatientSql },
+        { "prescriptionsForPatientModel", kPrescriptionsForPatientSql },
+        { "deletePatient", kDeletePatientSql },
+        { "findPatient", kFindPatientSql },
+        { "appointmentsForDoctor", kAppointmentRowsForDoctorSql },
+        { "prescriptionsForPatient", kPrescriptionRowsForPatientSql },
+        { "bookedSlotsForDoctor", kBookedSlotsForDoctorSql },
+        { "doctorsForSpecialty", kDoctorsForSpecialtySql },
+        { "appointmentOverlap", kAppointmentOverlapSql },
+        { "timeline.appointments", kTimelineAppointmentsSql },
+        { "timeline.cases", kTimelineCasesSql },
+        { "timeline.diagnoses", kTimelineDiagnosesSql },
+        { "timeline.orders", kTimelineOrdersSql },
+        { "timeline.prescriptions", kTimelinePrescriptionsSql },
+        { "appointmentCountsForDoctor", kAppointmentCountsForDoctorSql },
+        { "appointmentCountsForDay", kAppointmentCountsForDaySql },
+        { "topMedications", kTopMedicationsSql },
+        { "topIcdCodes", kTopIcdCodesSql },
+        { "patientsWithIcdCode", kPatientsWithIcdCodeSql },
+    };
+    for (const auto &h : hot) {
+        QSqlQuery q(db);
+        if (!q.prepare(QString("EXPLAIN QUERY PLAN ") + h.sql)) {
+            problems << QString("%1: prepare failed: %2").arg(h.label, q.lastError().text());
+            continue;
+        }
+        // 计划与参数值无关，随便绑第一个，其余按 NULL
+        q.bindValue(0, 0);
+        if (!q.exec()) {
+            problems << QString("%1: exec failed: %2").arg(h.label, q.lastError().text());
+            continue;
+        }
+        while (q.next()) {
+            // 列：id, parent, notused, detail
+            const QString detail = q.value(3).toString();
+            const bool fullScan = detail.startsWith("SCAN ") && !detail.contains(" INDEX ");
+            if (fullScan || detail.contains("TEMP B-TREE")) {
+                problems << QString("%1: %2").arg(h.label, detail);
+            }
+        }
+    }
+    return problems;
+}
+
+// 查找用户（示例）
+bool Database::findUser(const QString &username, UserRecord &out)
+{
+    return lookupUser(username, out) > 0;
+}
+
+// 区分"不存在"和"查询出错"，登录要把后者报成 Error
+int Database::lookupUser(const QString &username, UserRecord &out)
+{
+    if (!db.isOpen()) return -1;
+    // 事务里可能读到自己还没提交的改动，不经过缓存
+    RecordCache &cache = RecordCache::instance();
+    if (txDepth == 0 && cache.findUser(username, out)) return 1;
+    const quint64 generation = cache.generation();
+    QSqlQuery *q = prepared(kFindUserSql);
+    if (!q) return -1;
+    q->bindValue(0, username);
+    if (!execTimed(*q, "findUser")) {
+        qWarning() << "findUser exec error:" << q->lastError().text();
+        return -1;
+    }
+    const bool found = q->next();
+    if (found) readUser(*q, out);
+    q->finish(); // 重置语句，释放读锁
+    QueryStats::addRows("findUser", found ? 1 : 0);
+    if (found && txDepth == 0) cache.putUser(out, generation);
+    return found ? 1 : 0;
+}
+
+// 旧接口：保留给还在用 QVariantMap 的调用方
+bool Database::findUserByUsername(const QString &username, QVariantMap &outUser)
+{
+    UserRecord u;
+    if (!findUser(username, u)) return false;
+    outUser["id"] = u.id;
+    outUser["username"] = u.username;
+    outUser["email"] = u.email;
+    outUser["password_hash"] = u.passwordHash;
+    outUser["role"] = u.role;
+    outUser["is_active"] = u.isActive ? 1 : 0;
+    outUser["created_at"] = u.createdAt;
+    return true;
+}
+
+bool Database::findPatient(int patientId, PatientRecord &out)
+{
+    if (!db.isOpen()) return false;
+    RecordCache &cache = RecordCache::instance();
+    if (txDepth == 0 && cache.findPatient(patientId, out)) return true;
+    const quint64 generation = cache.generation();
+    QSqlQuery *q = prepared(kFindPatientSql);
+    if (!q) return false;
+    q->bindValue(0, patientId);
+    if (!execTimed(*q, "findPatient")) {
+        qWarning() << "findPatient exec error:" << q->lastError().text();
+        return false;
+    }
+    const bool found = q->next();
+    if (found) readPatient(*q, out);
+    q->finish();
+    QueryStats::addRows("findPatient", found ? 1 : 0);
+    if (found && txDepth == 0) cache.putPatient(out, generation);
+    return found;
+}
+
+bool Database::findDoctor(int doctorId, DoctorRecord &out)
+{
+    if (!db.isOpen()) return false;
+    RecordCache &cache = RecordCache::instance();
+    if (txDepth == 0 && cache.findDoctor(doctorId, out)) return true;
+    const quint64 generation = cache.generation();
+    QSqlQuery *q = prepared(kFindDoctorSql);
+    if (!q) return false;
+    q->bindValue(0, doctorId);
+    if (!execTimed(*q, "findDoctor")) {
+        qWarning() << "findDoctor exec error:" << q->lastError().text();
+        return false;
+    }
+    const bool found = q->next();
+    if (found) readDoctor(*q, out);
+    q->finish();
+    QueryStats::addRows("findDoctor", found ? 1 : 0);
+    if (found && txDepth == 0) cache.putDoctor(out, generation);
+    return found;
+}
+
+bool Database::appointmentsForDoctor(int doctorId, QVector<AppointmentRecord> &out)
+{
+    out.clear();
+    if (!db.isOpen()) return false;
+    QSqlQuery *q = prepared(kAppointmentRowsForDoctorSql);
+    if (!q) return false;
+    q->bindValue(0, doctorId);
+    if (!execTimed(*q, "appointmentsForDoctor")) {
+        qWarning() << "appointmentsForDoctor exec error:" << q->lastError().text();
+        return false;
+    }
+    while (q->next()) {
+        out.append(AppointmentRecord());
+        readAppointment(*q, out.last());
+    }
+    q->finish();
+    QueryStats::addRows("appointmentsForDoctor", out.size());
+    return true;
+}
+
+bool Database::prescriptionsForPatient(int patientId, QVector<PrescriptionRecord> &out)
+{
+    out.clear();
+    if (!db.isOpen()) return false;
+    QSqlQuery *q = prepared(kPrescriptionRowsForPatientSql);
+    if (!q) return false;
+    q->bindValue(0, patientId);
+    if (!execTimed(*q, "prescriptionsForPatient")) {
+        qWarning() << "prescriptionsForPatient exec error:" << q->lastError().text();
+        return false;
+    }
+    while (q->next()) {
+        out.append(PrescriptionRecord());
+        readPrescription(*q, out.last());
+    }
+    q->finish();
+    QueryStats::addRows("prescriptionsForPatient", out.size());
+    return true;
+}
+
+// 时间线的顺序：时间倒序，同一时刻 id 倒序，再按类型倒序
+static bool timelineBefore(const TimelineEvent &a, qint64 aAt, const TimelineEvent &b, qint64 bAt)
+{
+    if (aAt != bAt) return aAt > bAt;
+    if (a.id != b.id) return a.id > b.id;
+    return a.type > b.type;
+}
+
+bool Database::timeline(int patientId, const TimelineQuery &query, QVector<TimelineEvent> &out,
+                        TimelineQuery::Cursor *next)
+{
+    out.clear();
+    if (!db.isOpen()) return false;
+    const int limit = qMax(1, query.limit);
+    const qint64 from = query.from.isValid() ? SqlTime::toEpoch(query.from) : std::numeric_limits<qint64>::min();
+    const bool resume = query.after.type > 0;
+    const qint64 upper = resume ? query.after.at
+                       : query.to.isValid() ? SqlTime::toEpoch(query.to) : std::numeric_limits<qint64>::max();
+
+    // 每一路按时间倒序，最多 limit 条
+    struct Lane {
+        QVector<TimelineEvent> events;
+        QVector<qint64> at; // 原始整数时间，归并和游标用
+        int head = 0;
+    };
+    QVector<Lane> lanes;
+    for (const auto &src : kTimelineSources) {
+        if (!(query.types & (1 << src.type))) continue;
+        QSqlQuery *q = prepared(src.sql);
+        if (!q) return false;
+        // 键集上界：排在游标之后的是 (时间, id, 类型) 更小的行。类型比游标小的，同一 (时间, id) 也算在后面
+        qint64 idBound = std::numeric_limits<qint64>::min();
+        if (resume) idBound = src.type < query.after.type ? query.after.id + 1 : query.after.id;
+        q->bindValue(0, patientId);
+        q->bindValue(1, from);
+        q->bindValue(2, upper);
+        q->bindValue(3, idBound);
+        q->bindValue(4, limit);
+        if (!execTimed(*q, src.label)) {
+            qWarning() << src.label << "error:" << q->lastError().text();
+            return false;
+        }
+        Lane lane;
+        while (q->next()) {
+            TimelineEvent e;
+            e.type = src.type;
+            e.id = q->value(TimelineCol::Id).toInt();
+            e.at = SqlTime::dateTime(q->value(TimelineCol::At));
+            e.doctorId = q->value(TimelineCol::DoctorId).toInt();
+            e.title = q->value(TimelineCol::Title).toString();
+            e.detail = q->value(TimelineCol::Detail).toString();
+            e.status = q->value(TimelineCol::Status).toString();
+            e.parentId = q->value(TimelineCol::ParentId).toInt();
+            lane.at.append(q->value(TimelineCol::At).toLongLong());
+            lane.events.append(std::move(e));
+        }
+        q->finish();
+        if (!lane.events.isEmpty()) lanes.append(std::move(lane));
+    }
+
+    // 多路归并：每次取各路队首里最靠前的一条
+    out.reserve(limit);
+    qint64 lastAt = 0;
+    while (out.size() < limit) {
+        int best = -1;
+        for (int i = 0; i < lanes.size(); ++i) {
+            const Lane &l = lanes.at(i);
+            if (l.head >= l.events.size()) continue;
+            if (best < 0 || timelineBefore(l.events.at(l.head), l.at.at(l.head),
+                                           lanes.at(best).events.at(lanes.at(best).head),
+                                           lanes.at(best).at.at(lanes.at(best).head)))
+                best = i;
+        }
+        if (best < 0) break;
+        Lane &l = lanes[best];
+        lastAt = l.at.at(l.head);
+        out.append(l.events.at(l.head));
+        ++l.head;
+    }
+    QueryStats::addRows("timeline", out.size());
+    if (next && !out.isEmpty()) {
+        next->at = lastAt;
+        next->type = out.last().type;
+        next->id = out.last().id;
+    }
+    return true;
+}
+
+// 验证密码：scrypt（见 PasswordHasher），旧的 SHA-256 哈希验证通过后顺便升级
+bool Database::verifyUserPassword(const QString &username, const QString &passwordPlain)
+{
+    UserRecord user;
+    if (!findUser(username, user)) return false;
+    if (user.passwordHash.isEmpty()) return false;
+    const PasswordHasher::VerifyResult v = PasswordHasher::instance().verify(passwordPlain, user.passwordHash);
+    if (v.ok && !v.rehash.isEmpty()) updatePasswordHash(user.id, v.rehash);
+    return v.ok;
+}
+
+// 同步登录：在调用线程里验密（几十毫秒）。UI 请用 AsyncDatabase::login，验密在哈希线程池里做
+AuthResult Database::authenticate(const QString &username, const QString &passwordPlain, const QString &expectedRole)
+{
+    AuthResult r = lookupLogin(username);
+    if (r.status != AuthResult::Ok) return r;
+    const PasswordHasher::VerifyResult v = PasswordHasher::instance().verify(passwordPlain, r.user.passwordHash);
+    if (v.ok && !v.rehash.isEmpty()) updatePasswordHash(r.user.id, v.rehash);
+    judgeLogin(r, v.ok, expectedRole);
+    return r;
+}
+
+// 登录第一步：只读一次 users。status 为 Ok 表示用户存在，user.passwordHash 带着存储的哈希
+AuthResult Database::lookupLogin(const QString &username)
+{
+    AuthResult r;
+    if (!db.isOpen()) return r;
+    const int found = lookupUser(username, r.user);
+    if (found < 0) return r; // 查询出错：status 保持 Error，错误已经写进日志，不算一次失败的登录
+    if (found == 0) {
+        r.status = AuthResult::UnknownUser;
+        audit("login_failed", "users", 0, username);
+        return r;
+    }
+    r.status = AuthResult::Ok;
+    return r;
+}
+
+// 登录第二步：密码验证完之后判定结果
+void Database::judgeLogin(AuthResult &r, bool passwordOk, const QString &expectedRole)
+{
+    // 先验密码再看账号状态和角色，避免不知道密码的人探测账号信息
+    if (!passwordOk) {
+        r.status = AuthResult::BadPassword;
+    } else if (!r.user.isActive) {
+        r.status = AuthResult::Inactive;
+    } else if (!expectedRole.isEmpty() && r.user.role != expectedRole) {
+        r.status = AuthResult::RoleMismatch;
+    } else {
+        r.status = AuthResult::Ok;
+    }
+    r.user.passwordHash.clear(); // 哈希不需要离开登录流程
+
+    AuditRecord e;
+    e.userId = r.user.id;
+    e.action = r.status == AuthResult::Ok ? "login" : "login_failed";
+    e.objectType = "users";
+    e.objectId = r.user.id;
+    if (r.status != AuthResult::Ok) e.details = QString::number(int(r.status));
+    if (r.status == AuthResult::Ok) AuditLog::instance().setActor(r.user.id);
+    AuditLog::instance().record(std::move(e));
+}
+
+bool Database::updatePasswordHash(int userId, const QString &passwordHash)
+{
+    if (!db.isOpen()) return false;
+    QSqlQuery *q = prepared("UPDATE users SET password_hash = ? WHERE id = ?");
+    if (!q) return false;
+    q->bindValue(0, passwordHash);
+    q->bindValue(1, userId);
+    if (!execTimed(*q, "updatePasswordHash")) {
+        qWarning() << "updatePasswordHash error:" << q->lastError().text();
+        return false;
+    }
+    audit("password_rehash", "users", userId);
+    noteChange("users", RowChange::Update, userId);
+    uncacheUser(userId);
+    noteWrite();
+    return true;
+}
+
+// 插入用户（同步计算 scrypt 哈希）
+bool Database::insertUser(const QString &username, const QString &email, const QString &passwordPlain, const QString &role)
+{
+    if (!db.isOpen()) return false;
+    QSqlQuery *q = prepared(kInsertUserSql);
+    if (!q) return false;
+    QString passwordHash = PasswordHasher::instance().hash(passwordPlain);
+    q->bindValue(":username", username);
+    q->bindValue(":email", email);
+    q->bindValue(":password_hash", passwordHash);
+    q->bindValue(":role", role);
+    if (!execTimed(*q, "insertUser")) {
+        qWarning() << "insertUser error:" << q->lastError().text();
+        return false;
     }
+    audit("create", "users", q->lastInsertId().toLongLong(), username);
+    noteChange("users", RowChange::Insert, q->lastInsertId().toLongLong());
+    uncacheUser(0, username);
+    noteWrite();
+    return true;
+}
+
+// 约束冲突识别：SQLite 的错误文本形如 "UNIQUE constraint failed: users.username"
+static bool isUniqueViolation(const QSqlError &error, const char *column)
+{
+    const QString text = error.databaseText();
+    return text.contains("UNIQUE constraint failed") && text.contains(QLatin1String(column));
+}
+
+// 空字符串按 NULL 存（UNIQUE 列允许多个 NULL）
+static QVariant nullIfEmpty(const QString &s)
+{
+    const QString t = s.trimmed();
+    return t.isEmpty() ? QVariant() : QVariant(t);
+}
+
+RegistrationResult Database::registerAccount(const RegistrationRequest &req)
+{
+    RegistrationResult r;
+    if (!db.isOpen()) return r;
+    if (!beginTx()) return r;
+    r.status = insertAccountRows(req, r.userId);
+    if (r.status != RegistrationResult::Ok) {
+        r.userId = 0;
+        rollbackTx();
+        return r;
+    }
+    audit("register", "users", r.userId, req.role, r.userId);
+    if (!commitTx()) {
+        r.status = RegistrationResult::Error;
+        r.userId = 0;
+    }
+    return r;
+}
+
+bool Database::registerAccounts(const QVector<RegistrationRequest> &reqs, QVector<RegistrationResult> *results)
+{
+    if (results) results->clear();
+    if (!db.isOpen()) return false;
+    if (!beginTx()) return false;
+    for (const RegistrationRequest &req : reqs) {
+        RegistrationResult r;
+        r.status = insertAccountRows(req, r.userId);
+        if (r.status != RegistrationResult::Ok) r.userId = 0;
+        if (results) results->append(r);
+        if (r.status != RegistrationResult::Ok) {
+            rollbackTx();
+            return false;
+        }
+        audit("register", "users", r.userId, req.role, r.userId);
+    }
+    return commitTx();
+}
+
+// users 一行 + 按角色写 patients / doctors 一行，调用方负责事务。
+// 失败时已写入的 users 行由调用方回滚（整个事务或所在的 SAVEPOINT）
+RegistrationResult::Status Database::insertAccountRows(const RegistrationRequest &req, int &userId)
+{
+    // ① users：用户名冲突由 UNIQUE 约束报出来
+    QSqlQuery *q = prepared(kInsertUserSql);
+    if (!q) return RegistrationResult::Error;
+    q->bindValue(":username", req.username);
+    q->bindValue(":email", req.email);
+    // 哈希最好由调用方在哈希线程池里先算好（AsyncDatabase::registerAccount），这里只做兜底
+    q->bindValue(":password_hash", req.passwordHash.isEmpty() ? PasswordHasher::instance().hash(req.password)
+                                                              : req.passwordHash);
+    q->bindValue(":role", req.role);
+    if (!execTimed(*q, "insertAccount.user")) {
+        if (isUniqueViolation(q->lastError(), "users.username")) return RegistrationResult::UsernameTaken;
+        qWarning() << "insert account: insert user error:" << q->lastError().text();
+        return RegistrationResult::Error;
+    }
+    userId = q->lastInsertId().toInt();
+
+    // ② 按角色写详情表，id 与 users.id 相同；其他角色只有 users 行。
+    // 行变化等整个账号写完才记下，详情表写失败时不留下 users 的 Insert
+    const bool isPatient = req.role == "患者";
+    const bool isDoctor = req.role == "医生";
+    if (!isPatient && !isDoctor) {
+        noteChange("users", RowChange::Insert, userId);
+        return RegistrationResult::Ok;
+    }
+
+    q = prepared(isPatient ? kInsertPatientWithIdSql : kInsertDoctorSql);
+    if (!q) return RegistrationResult::Error;
+    if (isPatient) {
+        q->bindValue(0, userId);
+        q->bindValue(1, req.fullName);
+        q->bindValue(2, SqlTime::toSql(req.dateOfBirth));
+        q->bindValue(3, nullIfEmpty(req.idNumber));
+        q->bindValue(4, req.phone);
+        q->bindValue(5, req.post);
+        q->bindValue(6, req.gender);
+    } else {
+        q->bindValue(0, userId);
+        q->bindValue(1, req.fullName);
+        q->bindValue(2, req.phone);
+        q->bindValue(3, req.specialty);
+        q->bindValue(4, nullIfEmpty(req.licenseNumber));
+        q->bindValue(5, req.clinicAddress);
+    }
+    if (!execTimed(*q, "insertAccount.profile")) {
+        if (isUniqueViolation(q->lastError(), "patients.id_number")) return RegistrationResult::IdNumberTaken;
+        if (isUniqueViolation(q->lastError(), "doctors.license_number")) return RegistrationResult::LicenseTaken;
+        qWarning() << "insert account: insert profile error:" << q->lastError().text();
+        return RegistrationResult::Error;
+    }
+    noteChange("users", RowChange::Insert, userId);
+    noteChange(isPatient ? "patients" : "doctors", RowChange::Insert, userId);
+    return RegistrationResult::Ok;
+}
+
+static const char *const kLoadImportProgressSql = R"(
+        SELECT file_size, byte_offset, line_no, rows_read, inserted, rejected,
+               username_conflicts, id_number_conflicts, license_conflicts, finished
+        FROM import_progress WHERE source = ?
+    )";
+static const char *const kSaveImportProgressSql = R"(
+        INSERT OR REPLACE INTO import_progress
+            (source, file_size, byte_offset, line_no, rows_read, inserted, rejected,
+             username_conflicts, id_number_conflicts, license_conflicts, finished, updated_at)
+        VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, CAST(strftime('%s', 'now') AS INTEGER))
+    )";
+
+bool Database::loadImportProgress(const QString &source, ImportProgress &out)
+{
+    if (!db.isOpen()) return false;
+    QSqlQuery *q = prepared(kLoadImportProgressSql);
+    if (!q) return false;
+    q->bindValue(0, source);
+    if (!execTimed(*q, "loadImportProgress")) {
+        qWarning() << "loadImportProgress error:" << q->lastError().text();
+        return false;
+    }
+    const bool found = q->next();
+    if (found) {
+        out.source = source;
+        out.fileSize = q->value(0).toLongLong();
+        out.byteOffset = q->value(1).toLongLong();
+        out.lineNo = q->value(2).toLongLong();
+        out.rowsRead = q->value(3).toLongLong();
+        out.inserted = q->value(4).toLongLong();
+        out.rejected = q->value(5).toLongLong();
+        out.usernameConflicts = q->value(6).toLongLong();
+        out.idNumberConflicts = q->value(7).toLongLong();
+        out.licenseConflicts = q->value(8).toLongLong();
+        out.finished = q->value(9).toBool();
+    }
+    q->finish();
+    return found;
+}
+
+bool Database::resetImportProgress(const QString &source)
+{
+    if (!db.isOpen()) return false;
+    QSqlQuery *q = prepared("DELETE FROM import_progress WHERE source = ?");
+    if (!q) return false;
+    q->bindValue(0, source);
+    if (!execTimed(*q, "resetImportProgress")) {
+        qWarning() << "resetImportProgress error:" << q->lastError().text();
+        return false;
+    }
+    noteWrite();
+    return true;
+}
+
+// 批量导入的一个分块：一个事务，每行一个 SAVEPOINT。单行冲突只撤销这一行（连同它的 users 行），
+// 不影响同块的其他行；断点在同一事务里写入，所以崩溃后要么整块都在、要么整块都不在
+bool Database::importAccounts(const QVector<RegistrationRequest> &rows, ImportProgress &progress,
+                              QVector<RegistrationResult::Status> *statuses)
+{
+    if (!db.isOpen()) return false;
+    if (statuses) statuses->clear();
+    if (!beginTx()) return false;
+
+    ImportProgress next = progress;
+    for (const RegistrationRequest &req : rows) {
+        QSqlQuery *sp = prepared("SAVEPOINT import_row");
+        if (!sp || !execTimed(*sp, "savepoint")) {
+            qWarning() << "importAccounts: savepoint error:" << (sp ? sp->lastError().text() : QString());
+            rollbackTx();
+            return false;
+        }
+        const PendingMark mark = pendingMark();
+        int userId = 0;
+        const RegistrationResult::Status status = insertAccountRows(req, userId);
+        if (status != RegistrationResult::Ok) {
+            QSqlQuery *undo = prepared("ROLLBACK TO import_row");
+            if (!undo || !execTimed(*undo, "rollbackToSavepoint")) {
+                qWarning() << "importAccounts: rollback to savepoint error:" << (undo ? undo->lastError().text() : QString());
+                rollbackTx();
+                return false;
+            }
+            discardPendingSince(mark);
+        }
+        QSqlQuery *release = prepared("RELEASE import_row");
+        if (!release || !execTimed(*release, "releaseSavepoint")) {
+            qWarning() << "importAccounts: release savepoint error:" << (release ? release->lastError().text() : QString());
+            rollbackTx();
+            return false;
+        }
+        if (statuses) statuses->append(status);
+        switch (status) {
+        case RegistrationResult::Ok: ++next.inserted; break;
+        case RegistrationResult::UsernameTaken: ++next.usernameConflicts; ++next.rejected; break;
+        case RegistrationResult::IdNumberTaken: ++next.idNumberConflicts; ++next.rejected; break;
+        case RegistrationResult::LicenseTaken: ++next.licenseConflicts; ++next.rejected; break;
+        case RegistrationResult::Error: ++next.rejected; break;
+        }
+    }
+
+    QSqlQuery *q = prepared(kSaveImportProgressSql);
+    if (!q) {
+        rollbackTx();
+        return false;
+    }
+    q->bindValue(0, next.source);
+    q->bindValue(1, next.fileSize);
+    q->bindValue(2, next.byteOffset);
+    q->bindValue(3, next.lineNo);
+    q->bindValue(4, next.rowsRead);
+    q->bindValue(5, next.inserted);
+    q->bindValue(6, next.rejected);
+    q->bindValue(7, next.usernameConflicts);
+    q->bindValue(8, next.idNumberConflicts);
+    q->bindValue(9, next.licenseConflicts);
+    q->bindValue(10, next.finished ? 1 : 0);
+    if (!execTimed(*q, "saveImportProgress")) {
+        qWarning() << "importAccounts: save progress error:" << q->lastError().text();
+        rollbackTx();
+        return false;
+    }
+    // 导入按块记一条，不按行记
+    audit("import", "users", 0, QString("%1: +%2 rows").arg(next.source).arg(next.inserted - progress.inserted));
+    if (!commitTx()) return false;
+    progress = next;
+    return true;
+}
+
+// 插入患者（注意列名要与表一致）
+bool Database::insertPatient(const QString& fullName, const QDate& dateOfBirth, const QString& idNumber, const QString& phone, const QString& post, const QString& gender)
+{
+    if (!db.isOpen()) {
+        qWarning() << "Database not open";
+        return false;
+    }
+    QSqlQuery *query = prepared(kInsertPatientSql);
+    if (!query) return false;
+    query->bindValue(":full_name", fullName);
+    query->bindValue(":date_of_birth", SqlTime::toSql(dateOfBirth));
+    query->bindValue(":id_number", idNumber);
+    query->bindValue(":phone", phone);
+    query->bindValue(":post", post);
+    query->bindValue(":gender", gender);
+    if (!execTimed(*query, "insertPatient")) {
+        qWarning() << "Insert patient failed:" << query->lastError().text();
+        return false;
+    }
+    audit("create", "patients", query->lastInsertId().toLongLong());
+    noteChange("patients", RowChange::Insert, query->lastInsertId().toLongLong());
+    noteWrite();
+    return true;
+}
+
+// 插入医生（与表列保持一致：当前 doctors 表没有 gender 列）
+// Database.cpp
+// Replace or add this function in your Database implementation.
+
+bool Database::insertDoctor(int userId,
+                            const QString &fullName,
+                            const QString &phone,
+                            const QString &specialty,
+                            const QString &licenseNumber,
+                            const QString &clinicAddress)
+{
+    if (!db.isOpen()) {
+        qWarning() << "insertDoctor: db not open";
+        return false;
+    }
+
+    // 检查和写入放在同一个 BEGIN IMMEDIATE 事务里，检查过的状态在写入前不会被别的连接改掉
+    if (!beginTx()) return false;
+
+    // 1) 验证 users 表存在该 userId
+    {
+        QSqlQuery *chk = prepared("SELECT 1 FROM users WHERE id = :uid LIMIT 1");
+        if (!chk) {
+            rollbackTx();
+            return false;
+        }
+        chk->bindValue(":uid", userId);
+        if (!execTimed(*chk, "insertDoctor.checkUser")) {
+            qWarning() << "insertDoctor: check user exec failed:" << chk->lastError().text();
+            rollbackTx();
+            return false;
+        }
+        const bool userExists = chk->next();
+        chk->finish();
+        if (!userExists) {
+            qWarning() << "insertDoctor: userId does not exist in users:" << userId;
+            rollbackTx();
+            return false;
+        }
+    }
+
+    // 处理 licenseNumber：把空字符串当作 SQL NULL
+    QVariant licenseValue;
+    QString licenseTrim = licenseNumber.trimmed();
+    if (licenseTrim.isEmpty()) {
+        licenseValue = QVariant(); // NULL
+    } else {
+        licenseValue = licenseTrim;
+        // 如果是非空执业证号，先检查是否被其他 doctor 使用（避免 UNIQUE 失败）
+        QSqlQuery *checkLicense = prepared("SELECT id FROM doctors WHERE license_number = :lic LIMIT 1");
+        if (!checkLicense) {
+            rollbackTx();
+            return false;
+        }
+        checkLicense->bindValue(":lic", licenseTrim);
+        if (!execTimed(*checkLicense, "insertDoctor.checkLicense")) {
+            qWarning() << "insertDoctor: check license exec failed:" << checkLicense->lastError().text();
+            rollbackTx();
+            return false;
+        }
+        const int existingId = checkLicense->next() ? checkLicense->value(0).toInt() : 0;
+        checkLicense->finish();
+        if (existingId > 0) {
+            if (existingId != userId) {
+                qWarning() << "insertDoctor: license number already used by doctor id=" << existingId;
+                // 这里可以根据业务决定：返回 false 并让调用者告知用户，或将冲突处理为 update 等
+                rollbackTx();
+                return false;
+            }
+            // 如果 existingId == userId，则允许继续（是更新或重复提交）
+        }
+    }
+
+    // 2) 检查 doctors 中是否已有该 id（你的表结构以 id==userId）
+    QSqlQuery *exist = prepared("SELECT 1 FROM doctors WHERE id = :id LIMIT 1");
+    if (!exist) {
+        rollbackTx();
+        return false;
+    }
+    exist->bindValue(":id", userId);
+    if (!execTimed(*exist, "insertDoctor.checkExists")) {
+        qWarning() << "insertDoctor: check doctor exist failed:" << exist->lastError().text();
+        rollbackTx();
+        return false;
+    }
+    const bool doctorExists = exist->next();
+    exist->finish();
+
+    if (doctorExists) {
+        // UPDATE existing row（注意绑定 licenseValue 可能为 NULL）
+        QSqlQuery *q = prepared(kUpdateDoctorSql);
+        if (!q) {
+            rollbackTx();
+            return false;
+        }
+        q->bindValue(0, fullName);
+        q->bindValue(1, phone);
+        q->bindValue(2, specialty);
+        q->bindValue(3, licenseValue); // NULL 或 实际字符串
+        q->bindValue(4, clinicAddress);
+        q->bindValue(5, userId);
+        if (!execTimed(*q, "updateDoctor")) {
+            qWarning() << "insertDoctor: UPDATE exec failed:" << q->lastError().text();
+            rollbackTx();
+            return false;
+        }
+        audit("update", "doctors", userId);
+        noteChange("doctors", RowChange::Update, userId);
+        uncacheDoctor(userId);
+        if (!commitTx()) return false;
+        qDebug() << "insertDoctor: updated existing doctor id=" << userId;
+        return true;
+    } else {
+        // INSERT 新行（id 存 userId）
+        QSqlQuery *q = prepared(kInsertDoctorSql);
+        if (!q) {
+            rollbackTx();
+            return false;
+        }
+        q->bindValue(0, userId);
+        q->bindValue(1, fullName);
+        q->bindValue(2, phone);
+        q->bindValue(3, specialty);
+        q->bindValue(4, licenseValue); // NULL 或 实际字符串
+        q->bindValue(5, clinicAddress);
+
+        if (!execTimed(*q, "insertDoctor")) {
+            qWarning() << "insertDoctor: INSERT exec failed:" << q->lastError().text();
+            // 如果是 UNIQUE constraint failed: doctors.license_number，可以在这里给出更友好的信息
+            if (q->lastError().text().contains("UNIQUE") && !licenseTrim.isEmpty()) {
+                qWarning() << "insertDoctor: license number conflict for value =" << licenseTrim;
+            }
+            rollbackTx();
+            return false;
+        }
+        audit("create", "doctors", userId);
+        noteChange("doctors", RowChange::Insert, userId);
+        uncacheDoctor(userId);
+        if (!commitTx()) return false;
+        qDebug() << "insertDoctor: inserted new doctor id=" << userId;
+        return true;
+    }
+}
+// 其余插入方法保持不变（你之前实现的逻辑是可以的）
+// 例如 insertMedicalCase, insertAppointment, insertDiagnosis, insertMedicalOrder, insertPrescription
+// 请确保函数签名与 header 文件一致（如果 header 签名不同，请同步）
+
+bool Database::insertMedicalCase(int patientId, int createdByDoctorId, const QString &title, const QString &description, const QString &attachments)
+{
+    if (!db.isOpen()) return false;
+    QSqlQuery *q = prepared(kInsertMedicalCaseSql);
+    if (!q) return false;
+    // 病历和它的检索索引一起提交
+    if (!beginTx()) return false;
+    q->bindValue(":patient_id", patientId);
+    q->bindValue(":doctor_id", createdByDoctorId);
+    q->bindValue(":title", title);
+    q->bindValue(":description", description);
+    q->bindValue(":attachments", attachments);
+    if (!execTimed(*q, "insertMedicalCase")) {
+        qWarning() << "insertMedicalCase error:" << q->lastError().text();
+        rollbackTx();
+        return false;
+    }
+    const qint64 caseId = q->lastInsertId().toLongLong();
+    if (!indexForSearch(FullTextSearch::MedicalCase, caseId, patientId, title + QLatin1Char('\n') + description)) {
+        rollbackTx();
+        return false;
+    }
+    audit("create", "medical_cases", caseId, QString(), createdByDoctorId);
+    noteChange("medical_cases", RowChange::Insert, caseId);
+    return commitTx();
+}
+
+bool Database::insertAppointment(int patientId, int doctorId, const QDateTime &scheduledAt, const QString &status, const QString &reason)
+{
+    if (!db.isOpen()) return false;
+    if (!scheduledAt.isValid()) {
+        qWarning() << "insertAppointment: invalid scheduledAt";
+        return false;
+    }
+    QSqlQuery *q = prepared(kInsertAppointmentSql);
+    if (!q) return false;
+    q->bindValue(":patient_id", patientId);
+    q->bindValue(":doctor_id", doctorId);
+    q->bindValue(":scheduled_at", SqlTime::toSql(scheduledAt));
+    q->bindValue(":status", status);
+    q->bindValue(":reason", reason);
+    if (!execTimed(*q, "insertAppointment")) {
+        qWarning() << "insertAppointment error:" << q->lastError().text();
+        return false;
+    }
+    audit("create", "appointments", q->lastInsertId().toLongLong());
+    noteChange("appointments", RowChange::Insert, q->lastInsertId().toLongLong());
+    noteWrite();
+    // 绕过排班写入的预约：让该医生的区间索引下次重新加载
+    AppointmentScheduler::instance().invalidate(doctorId);
+    return true;
+}
+
+bool Database::insertAppointmentIfFree(AppointmentRecord &r, bool &conflict)
+{
+    conflict = false;
+    if (!db.isOpen()) return false;
+    if (!r.scheduledAt.isValid() || r.durationMinutes <= 0 || r.durationMinutes > 24 * 60) {
+        qWarning() << "insertAppointmentIfFree: bad slot" << r.scheduledAt << r.durationMinutes;
+        return false;
+    }
+    if (!beginTx()) return false;
+    QSqlQuery *q = prepared(kAppointmentOverlapSql);
+    if (!q) {
+        rollbackTx();
+        return false;
+    }
+    q->bindValue(":did", r.doctorId);
+    const qint64 start = SqlTime::toEpoch(r.scheduledAt);
+    q->bindValue(":earliest", start - 24 * 3600);
+    q->bindValue(":end", start + r.durationMinutes * 60);
+    q->bindValue(":start", start);
+    if (!execTimed(*q, "appointmentOverlap")) {
+        qWarning() << "appointmentOverlap error:" << q->lastError().text();
+        rollbackTx();
+        return false;
+    }
+    conflict = q->next();
+    q->finish();
+    if (conflict) {
+        rollbackTx();
+        return false;
+    }
+
+    q = prepared(kInsertTimedAppointmentSql);
+    if (!q) {
+        rollbackTx();
+        return false;
+    }
+    if (r.status.isEmpty()) r.status = "scheduled";
+    q->bindValue(":patient_id", r.patientId);
+    q->bindValue(":doctor_id", r.doctorId);
+    q->bindValue(":scheduled_at", start);
+    q->bindValue(":duration", r.durationMinutes);
+    q->bindValue(":status", r.status);
+    q->bindValue(":reason", r.reason);
+    if (!execTimed(*q, "insertAppointment")) {
+        qWarning() << "insertAppointment error:" << q->lastError().text();
+        rollbackTx();
+        return false;
+    }
+    r.id = q->lastInsertId().toInt();
+    audit("create", "appointments", r.id);
+    noteChange("appointments", RowChange::Insert, r.id);
+    return commitTx();
+}
+
+bool Database::doctorsForSpecialty(const QString &specialty, QVector<int> &out)
+{
+    out.clear();
+    if (!db.isOpen()) return false;
+    QSqlQuery *q = prepared(kDoctorsForSpecialtySql);
+    if (!q) return false;
+    q->bindValue(0, specialty);
+    if (!execTimed(*q, "doctorsForSpecialty")) {
+        qWarning() << "doctorsForSpecialty exec error:" << q->lastError().text();
+        return false;
+    }
+    while (q->next()) out.append(q->value(0).toInt());
+    q->finish();
+    QueryStats::addRows("doctorsForSpecialty", out.size());
+    return true;
+}
+
+bool Database::bookedSlotsForDoctor(int doctorId, const QDateTime &from, QVector<AppointmentRecord> &out)
+{
+    out.clear();
+    if (!db.isOpen()) return false;
+    QSqlQuery *q = prepared(kBookedSlotsForDoctorSql);
+    if (!q) return false;
+    q->bindValue(0, doctorId);
+    q->bindValue(1, SqlTime::toSql(from));
+    if (!execTimed(*q, "bookedSlotsForDoctor")) {
+        qWarning() << "bookedSlotsForDoctor exec error:" << q->lastError().text();
+        return false;
+    }
+    while (q->next()) {
+        AppointmentRecord a;
+        a.id = q->value(0).toInt();
+        a.doctorId = doctorId;
+        a.scheduledAt = SqlTime::dateTime(q->value(1));
+        a.durationMinutes = q->value(2).toInt();
+        out.append(a);
+    }
+    q->finish();
+    QueryStats::addRows("bookedSlotsForDoctor", out.size());
+    return true;
+}
+
+bool Database::insertDiagnosis(int caseId, int appointmentId, int doctorId, int patientId, const QString &diagnosisText, const QString &icdCodes)
+{
+    if (!db.isOpen()) return false;
+    DiagnosisRecord r;
+    r.caseId = caseId;
+    r.appointmentId = appointmentId;
+    r.doctorId = doctorId;
+    r.patientId = patientId;
+    r.diagnosisText = diagnosisText;
+    r.icdCodes = icdCodes;
+    return insertBatch(QVector<DiagnosisRecord>{ r }, nullptr);
+}
+
+bool Database::insertMedicalOrder(int diagnosisId, int doctorId, int patientId, const QString &orderText, const QString &orderType, const QString &status)
+{
+    if (!db.isOpen()) return false;
+    MedicalOrderRecord r;
+    r.diagnosisId = diagnosisId;
+    r.doctorId = doctorId;
+    r.patientId = patientId;
+    r.orderText = orderText;
+    r.orderType = orderType;
+    r.status = status;
+    return execInsert(r);
+}
+
+bool Database::insertPrescription(int diagnosisId, int doctorId, int patientId, const QString &medicationName, const QString &dosage, const QString &frequency, const QString &duration, const QString &notes)
+{
+    if (!db.isOpen()) return false;
+    PrescriptionRecord r;
+    r.diagnosisId = diagnosisId;
+    r.doctorId = doctorId;
+    r.patientId = patientId;
+    r.medicationName = medicationName;
+    r.dosage = dosage;
+    r.frequency = frequency;
+    r.duration = duration;
+    r.notes = notes;
+    return insertBatch(QVector<PrescriptionRecord>{ r }, nullptr);
+}
+
+// 单行插入：绑定到缓存的语句上执行，成功后把新 id 写回 r.id。
+// 诊断和处方同时写检索索引，诊断还要拆出 ICD 编码，调用方要在事务里调用，保证一起提交
+bool Database::execInsert(DiagnosisRecord &r)
+{
+    QSqlQuery *q = prepared(kInsertDiagnosisSql);
+    if (!q) return false;
+    q->bindValue(":case_id", r.caseId > 0 ? QVariant(r.caseId) : QVariant());
+    q->bindValue(":appointment_id", r.appointmentId > 0 ? QVariant(r.appointmentId) : QVariant());
+    q->bindValue(":doctor_id", r.doctorId);
+    q->bindValue(":patient_id", r.patientId);
+    q->bindValue(":diagnosis_text", r.diagnosisText);
+    q->bindValue(":icd_codes", r.icdCodes);
+    if (!execTimed(*q, "insertDiagnosis")) {
+        qWarning() << "insertDiagnosis error:" << q->lastError().text();
+        return false;
+    }
+    r.id = q->lastInsertId().toInt();
+    if (!indexForSearch(FullTextSearch::Diagnosis, r.id, r.patientId, r.diagnosisText + QLatin1Char('\n') + r.icdCodes))
+        return false;
+    if (!insertDiagnosisCodes(r)) return false;
+    audit("create", "diagnoses", r.id, QString(), r.doctorId);
+    noteChange("diagnoses", RowChange::Insert, r.id);
+    noteWrite();
+    return true;
+}
+
+bool Database::execInsert(MedicalOrderRecord &r)
+{
+    QSqlQuery *q = prepared(kInsertMedicalOrderSql);
+    if (!q) return false;
+    q->bindValue(":diagnosis_id", r.diagnosisId > 0 ? QVariant(r.diagnosisId) : QVariant());
+    q->bindValue(":doctor_id", r.doctorId);
+    q->bindValue(":patient_id", r.patientId);
+    q->bindValue(":order_text", r.orderText);
+    q->bindValue(":order_type", r.orderType);
+    q->bindValue(":status", r.status);
+    if (!execTimed(*q, "insertMedicalOrder")) {
+        qWarning() << "insertMedicalOrder error:" << q->lastError().text();
+        return false;
+    }
+    r.id = q->lastInsertId().toInt();
+    audit("create", "medical_orders", r.id, QString(), r.doctorId);
+    noteChange("medical_orders", RowChange::Insert, r.id);
+    noteWrite();
+    return true;
+}
+
+bool Database::execInsert(PrescriptionRecord &r)
+{
+    QSqlQuery *q = prepared(kInsertPrescriptionSql);
+    if (!q) return false;
+    q->bindValue(":diagnosis_id", r.diagnosisId > 0 ? QVariant(r.diagnosisId) : QVariant());
+    q->bindValue(":doctor_id", r.doctorId);
+    q->bindValue(":patient_id", r.patientId);
+    q->bindValue(":medication_name", r.medicationName);
+    q->bindValue(":dosage", r.dosage);
+    q->bindValue(":frequency", r.frequency);
+    q->bindValue(":duration", r.duration);
+    q->bindValue(":notes", r.notes);
+    if (!execTimed(*q, "insertPrescription")) {
+        qWarning() << "insertPrescription error:" << q->lastError().text();
+        return false;
+    }
+    r.id = q->lastInsertId().toInt();
+    if (!indexForSearch(FullTextSearch::Prescription, r.id, r.patientId, r.medicationName + QLatin1Char('\n') + r.notes))
+        return false;
+    audit("create", "prescriptions", r.id, QString(), r.doctorId);
+    noteChange("prescriptions", RowChange::Insert, r.id);
+    noteWrite();
+    return true;
+}
+
+// 批量插入：整批在一个事务里（一次 fsync），任何一行失败整批回滚，outIds 不变
+template <typename Record>
+bool Database::insertBatch(QVector<Record> rows, QVector<int> *outIds)
+{
+    if (!db.isOpen()) return false;
+    if (rows.isEmpty()) return true;
+    if (!beginTx()) return false;
+    for (Record &r : rows) {
+        if (!execInsert(r)) {
+            rollbackTx();
+            return false;
+        }
+    }
+    if (!commitTx()) return false;
+    if (outIds) {
+        outIds->clear();
+        outIds->reserve(rows.size());
+        for (const Record &r : rows) outIds->append(r.id);
+    }
+    return true;
+}
+
+bool Database::insertDiagnoses(const QVector<DiagnosisRecord> &rows, QVector<int> *outIds)
+{
+    return insertBatch(rows, outIds);
+}
+
+bool Database::insertMedicalOrders(const QVector<MedicalOrderRecord> &rows, QVector<int> *outIds)
+{
+    return insertBatch(rows, outIds);
+}
+
+bool Database::insertPrescriptions(const QVector<PrescriptionRecord> &rows, QVector<int> *outIds)
+{
+    return insertBatch(rows, outIds);
+}
+
+// 写一条检索索引。正文切分后为空（没有可检索的字）就不写
+bool Database::indexForSearch(int docType, qint64 id, int patientId, const QString &text)
+{
+    const QString body = FullTextSearch::indexText(text);
+    if (body.isEmpty()) return true;
+    QSqlQuery *q = prepared(kInsertSearchDocSql);
+    if (!q) return false;
+    q->bindValue(":rowid", FullTextSearch::rowId(FullTextSearch::DocType(docType), id));
+    q->bindValue(":patient_id", patientId);
+    q->bindValue(":body", body);
+    if (!execTimed(*q, "indexForSearch")) {
+        qWarning() << "indexForSearch error:" << q->lastError().text();
+        return false;
+    }
+    return true;
+}
+
+bool Database::searchRecords(const QString &query, int patientId, int offset, int limit, QVector<SearchHit> &out,
+                             const QString &highlightOpen, const QString &highlightClose)
+{
+    out.clear();
+    if (!db.isOpen()) return false;
+    const QString match = FullTextSearch::matchExpression(query);
+    if (match.isEmpty() || limit <= 0) return true;
+    QSqlQuery *q = prepared(patientId > 0 ? kSearchForPatientSql : kSearchSql);
+    if (!q) return false;
+    q->bindValue(":match", match);
+    if (patientId > 0) q->bindValue(":pid", patientId);
+    q->bindValue(":limit", limit);
+    q->bindValue(":offset", qMax(0, offset));
+    if (!execTimed(*q, "searchRecords")) {
+        qWarning() << "searchRecords error:" << q->lastError().text();
+        return false;
+    }
+    while (q->next()) {
+        const qint64 rowId = q->value(0).toLongLong();
+        SearchHit h;
+        h.docType = FullTextSearch::typeOf(rowId);
+        h.docId = int(FullTextSearch::idOf(rowId));
+        h.patientId = q->value(1).toInt();
+        h.score = q->value(2).toDouble();
+        out.append(h);
+    }
+    q->finish();
+    QueryStats::addRows("searchRecords", out.size());
+
+    const QStringList terms = FullTextSearch::highlightTerms(query);
+    for (SearchHit &h : out) {
+        const char *sql = h.docType == FullTextSearch::MedicalCase ? kCaseTextSql
+                        : h.docType == FullTextSearch::Diagnosis ? kDiagnosisTextSql
+                        : kPrescriptionTextSql;
+        QSqlQuery *t = prepared(sql);
+        if (!t) return false;
+        t->bindValue(0, h.docId);
+        if (!execTimed(*t, "searchSnippet")) {
+            qWarning() << "searchSnippet error:" << t->lastError().text();
+            return false;
+        }
+        if (t->next())
+            h.snippet = FullTextSearch::snippet(t->value(0).toString(), terms, kSnippetChars, highlightOpen, highlightClose);
+        t->finish();
+    }
+    return true;
+}
+
+bool Database::rebuildSearchIndex()
+{
+    if (!db.isOpen()) return false;
+    if (!beginTx()) return false;
+    if (!FullTextSearch::rebuild(db)) {
+        rollbackTx();
+        return false;
+    }
+    return commitTx();
+}
+
+// 诊断的 ICD 编码拆开写进 diagnosis_codes，stats_icd_codes 由它的触发器累加（见 aggregates.h）
+bool Database::insertDiagnosisCodes(const DiagnosisRecord &r)
+{
+    const QStringList codes = Aggregates::icdCodes(r.icdCodes);
+    if (codes.isEmpty()) return true;
+    QSqlQuery *q = prepared(kInsertDiagnosisCodeSql);
+    if (!q) return false;
+    for (const QString &code : codes) {
+        q->bindValue(":code", code);
+        q->bindValue(":id", r.id);
+        if (!execTimed(*q, "insertDiagnosisCode")) {
+            qWarning() << "insertDiagnosisCode error:" << q->lastError().text();
+            return false;
+        }
+    }
+    return true;
+}
+
+namespace {
+void readDayCounts(QSqlQuery &q, QVector<AppointmentDayCount> &out)
+{
+    while (q.next()) {
+        AppointmentDayCount c;
+        c.doctorId = q.value(0).toInt();
+        c.day = SqlTime::date(q.value(1));
+        c.status = q.value(2).toString();
+        c.count = q.value(3).toLongLong();
+        out.append(c);
+    }
+    q.finish();
+}
+
+void readNamedCounts(QSqlQuery &q, QVector<NamedCount> &out)
+{
+    while (q.next()) {
+        NamedCount c;
+        c.name = q.value(0).toString();
+        c.count = q.value(1).toLongLong();
+        out.append(c);
+    }
+    q.finish();
+}
 }
 
-bool Database::createTablesIfNeeded()
+bool Database::appointmentCountsForDoctor(int doctorId, const QDate &from, const QDate &to, QVector<AppointmentDayCount> &out)
 {
-    QSqlQuery q(db);
-    // users
-    if (!q.exec(R"(
-        CREATE TABLE IF NOT EXISTS users (
-            id INTEGER PRIMARY KEY AUTOINCREMENT,
-            username TEXT UNIQUE NOT NULL,
-            email TEXT,
-            password_hash TEXT NOT NULL,
-            role TEXT NOT NULL,
-            is_active INTEGER NOT NULL DEFAULT 1,
-            created_at TEXT DEFAULT CURRENT_TIMESTAMP
-        );
-    )")) {
-        qWarning() << "create users table error:" << q.lastError().text();
-        return false;
-    }
-
-    // doctors
-    if (!q.exec(R"(
-        CREATE TABLE IF NOT EXISTS doctors (
-            id INTEGER PRIMARY KEY, -- user id
-            full_name TEXT NOT NULL,
-            phone TEXT,
-            specialty TEXT,
-            license_number TEXT UNIQUE,
-            clinic_address TEXT,
-            created_at TEXT DEFAULT CURRENT_TIMESTAMP,
-            FOREIGN KEY(id) REFERENCES users(id) ON DELETE CASCADE
-        );
-    )")) {
-        qWarning() << "create doctors table error:" << q.lastError().text();
-        return false;
-    }
-
-    // patients
-    if (!q.exec(R"(
-        CREATE TABLE IF NOT EXISTS patients (
-            id INTEGER PRIMARY KEY, -- user id
-            full_name TEXT NOT NULL,
-            date_of_birth TEXT,
-            id_number TEXT UNIQUE,
-            phone TEXT,
-            post TEXT,
-            gender TEXT,
-            created_at TEXT DEFAULT CURRENT_TIMESTAMP,
-            FOREIGN KEY(id) REFERENCES users(id) ON DELETE CASCADE
-        );
-    )")) {
-        qWarning() << "create patients table error:" << q.lastError().text();
-        return false;
-    }
-
-    // medical_cases
-    if (!q.exec(R"(
-        CREATE TABLE IF NOT EXISTS medical_cases (
-            id INTEGER PRIMARY KEY AUTOINCREMENT,
-            patient_id INTEGER NOT NULL,
-            created_by_doctor_id INTEGER,
-            title TEXT,
-            description TEXT,
-            attachments TEXT,
-            created_at TEXT DEFAULT CURRENT_TIMESTAMP,
-            FOREIGN KEY(patient_id) REFERENCES patients(id) ON DELETE CASCADE,
-            FOREIGN KEY(created_by_doctor_id) REFERENCES doctors(id)
-        );
-    )")) {
-        qWarning() << "create medical_cases error:" << q.lastError().text();
-        return false;
-    }
-
-    // appointments
-    if (!q.exec(R"(
-        CREATE TABLE IF NOT EXISTS appointments (
-            id INTEGER PRIMARY KEY AUTOINCREMENT,
-            patient_id INTEGER NOT NULL,
-            doctor_id INTEGER NOT NULL,
-            scheduled_at TEXT NOT NULL,
-            status TEXT DEFAULT 'scheduled',
-            reason TEXT,
-            created_at TEXT DEFAULT CURRENT_TIMESTAMP,
-            FOREIGN KEY(patient_id) REFERENCES patients(id) ON DELETE CASCADE,
-            FOREIGN KEY(doctor_id) REFERENCES doctors(id) ON DELETE CASCADE
-        );
-    )")) {
-        qWarning() << "create appointments error:" << q.lastError().text();
-        return false;
-    }
-
-    // diagnoses
-    if (!q.exec(R"(
-        CREATE TABLE IF NOT EXISTS diagnoses (
-            id INTEGER PRIMARY KEY AUTOINCREMENT,
-            case_id INTEGER,
-            appointment_id INTEGER,
-            doctor_id INTEGER NOT NULL,
-            patient_id INTEGER NOT NULL,
-            diagnosis_text TEXT NOT NULL,
-            icd_codes TEXT,
-            created_at TEXT DEFAULT CURRENT_TIMESTAMP,
-            FOREIGN KEY(case_id) REFERENCES medical_cases(id),
-            FOREIGN KEY(appointment_id) REFERENCES appointments(id),
-            FOREIGN KEY(doctor_id) REFERENCES doctors(id),
-            FOREIGN KEY(patient_id) REFERENCES patients(id)
-        );
-    )")) {
-        qWarning() << "create diagnoses error:" << q.lastError().text();
-        return false;
-    }
-
-    // medical_orders
-    if (!q.exec(R"(
-        CREATE TABLE IF NOT EXISTS medical_orders (
-            id INTEGER PRIMARY KEY AUTOINCREMENT,
-            diagnosis_id INTEGER,
-            doctor_id INTEGER NOT NULL,
-            patient_id INTEGER NOT NULL,
-            order_text TEXT NOT NULL,
-            order_type TEXT,
-            status TEXT,
-            created_at TEXT DEFAULT CURRENT_TIMESTAMP,
-            FOREIGN KEY(diagnosis_id) REFERENCES diagnoses(id),
-            FOREIGN KEY(doctor_id) REFERENCES doctors(id),
-            FOREIGN KEY(patient_id) REFERENCES patients(id)
-        );
-    )")) {
-        qWarning() << "create medical_orders error:" << q.lastError().text();
-        return false;
-    }
-
-    // prescriptions
-    if (!q.exec(R"(
-        CREATE TABLE IF NOT EXISTS prescriptions (
-            id INTEGER PRIMARY KEY AUTOINCREMENT,
-            diagnosis_id INTEGER,
-            doctor_id INTEGER NOT NULL,
-            patient_id INTEGER NOT NULL,
-            medication_name TEXT NOT NULL,
-            dosage TEXT,
-            frequency TEXT,
-            duration TEXT,
-            notes TEXT,
-            issued_at TEXT DEFAULT CURRENT_TIMESTAMP,
-            FOREIGN KEY(diagnosis_id) REFERENCES diagnoses(id),
-            FOREIGN KEY(doctor_id) REFERENCES doctors(id),
-            FOREIGN KEY(patient_id) REFERENCES patients(id)
-        );
-    )")) {
-        qWarning() << "create prescriptions error:" << q.lastError().text();
-        return false;
-    }
-
-    // audit_logs
-    if (!q.exec(R"(
-        CREATE TABLE IF NOT EXISTS audit_logs (
-            id INTEGER PRIMARY KEY AUTOINCREMENT,
-            user_id INTEGER,
-            action TEXT NOT NULL,
-            object_type TEXT,
-            object_id INTEGER,
-            details TEXT,
-            created_at TEXT DEFAULT CURRENT_TIMESTAMP
-        );
-    )")) {
-        qWarning() << "create audit_logs error:" << q.lastError().text();
+    out.clear();
+    if (!db.isOpen()) return false;
+    QSqlQuery *q = prepared(kAppointmentCountsForDoctorSql);
+    if (!q) return false;
+    q->bindValue(":did", doctorId);
+    q->bindValue(":from", from.isValid() ? SqlTime::toSql(from) : QVariant(std::numeric_limits<qint64>::min()));
+    q->bindValue(":to", to.isValid() ? SqlTime::toSql(to) : QVariant(std::numeric_limits<qint64>::max()));
+    if (!execTimed(*q, "appointmentCountsForDoctor")) {
+        qWarning() << "appointmentCountsForDoctor error:" << q->lastError().text();
         return false;
     }
-
+    readDayCounts(*q, out);
+    QueryStats::addRows("appointmentCountsForDoctor", out.size());
     return true;
 }
 
-// 查找用户（示例）
-bool Database::findUserByUsername(const QString &username, QVariantMap &outUser)
+bool Database::appointmentCountsForDay(const QDate &day, QVector<AppointmentDayCount> &out)
 {
-    if (!db.isOpen()) return false;
-    QSqlQuery q(db);
-    q.prepare("SELECT id, username, email, password_hash, role, is_active, created_at FROM users WHERE username = :u");
-    q.bindValue(":u", username);
-    if (!q.exec()) {
-        qWarning() << "findUser exec error:" << q.lastError().text();
-        return false;
-    }
-    if (q.next()) {
-        outUser["id"] = q.value("id");
-        outUser["username"] = q.value("username");
-        outUser["email"] = q.value("email");
-        outUser["password_hash"] = q.value("password_hash");
-        outUser["role"] = q.value("role");
-        outUser["is_active"] = q.value("is_active");
-        outUser["created_at"] = q.value("created_at");
-        return true;
+    out.clear();
+    if (!db.isOpen() || !day.isValid()) return false;
+    QSqlQuery *q = prepared(kAppointmentCountsForDaySql);
+    if (!q) return false;
+    q->bindValue(":day", SqlTime::toSql(day));
+    if (!execTimed(*q, "appointmentCountsForDay")) {
+        qWarning() << "appointmentCountsForDay error:" << q->lastError().text();
+        return false;
     }
-    return false;
+    readDayCounts(*q, out);
+    QueryStats::addRows("appointmentCountsForDay", out.size());
+    return true;
 }
 
-// 验证密码（演示用：SHA256，生产请用 bcrypt/Argon2/libsodium）
-static QString simpleHash(const QString &plain)
+bool Database::topMedications(int limit, QVector<NamedCount> &out)
 {
-    QByteArray ba = plain.toUtf8();
-    QByteArray hash = QCryptographicHash::hash(ba, QCryptographicHash::Sha256);
-    return QString(hash.toHex());
+    out.clear();
+    if (!db.isOpen()) return false;
+    if (limit <= 0) return true;
+    QSqlQuery *q = prepared(kTopMedicationsSql);
+    if (!q) return false;
+    q->bindValue(":limit", limit);
+    if (!execTimed(*q, "topMedications")) {
+        qWarning() << "topMedications error:" << q->lastError().text();
+        return false;
+    }
+    readNamedCounts(*q, out);
+    QueryStats::addRows("topMedications", out.size());
+    return true;
 }
 
-bool Database::verifyUserPassword(const QString &username, const QString &passwordPlain)
+bool Database::topIcdCodes(int limit, QVector<NamedCount> &out)
 {
-    QVariantMap user;
-    if (!findUserByUsername(username, user)) return false;
-    QString storedHash = user.value("password_hash").toString();
-    if (storedHash.isEmpty()) return false;
-    return simpleHash(passwordPlain) == storedHash; // demo only
+    out.clear();
+    if (!db.isOpen()) return false;
+    if (limit <= 0) return true;
+    QSqlQuery *q = prepared(kTopIcdCodesSql);
+    if (!q) return false;
+    q->bindValue(":limit", limit);
+    if (!execTimed(*q, "topIcdCodes")) {
+        qWarning() << "topIcdCodes error:" << q->lastError().text();
+        return false;
+    }
+    readNamedCounts(*q, out);
+    QueryStats::addRows("topIcdCodes", out.size());
+    return true;
 }
 
-// 插入用户（演示：使用简单哈希）
-bool Database::insertUser(const QString &username, const QString &email, const QString &passwordPlain, const QString &role)
+bool Database::patientsWithIcdCode(const QString &code, int afterPatientId, int limit, QVector<IcdPatientHit> &out)
 {
+    out.clear();
     if (!db.isOpen()) return false;
-    QSqlQuery q(db);
-    QString passwordHash = simpleHash(passwordPlain); // demo only
-    q.prepare(R"(
-        INSERT INTO users(username, email, password_hash, role)
-        VALUES (:username, :email, :password_hash, :role)
-    )");
-    q.bindValue(":username", username);
-    q.bindValue(":email", email);
-    q.bindValue(":password_hash", passwordHash);
-    q.bindValue(":role", role);
-    if (!q.exec()) {
-        qWarning() << "insertUser error:" << q.lastError().text();
+    const QStringList codes = Aggregates::icdCodes(code);
+    if (codes.size() != 1 || limit <= 0) return true;
+    QSqlQuery *q = prepared(kPatientsWithIcdCodeSql);
+    if (!q) return false;
+    q->bindValue(":code", codes.first());
+    q->bindValue(":after", afterPatientId);
+    q->bindValue(":limit", limit);
+    if (!execTimed(*q, "patientsWithIcdCode")) {
+        qWarning() << "patientsWithIcdCode error:" << q->lastError().text();
         return false;
     }
+    while (q->next()) {
+        IcdPatientHit h;
+        h.patientId = q->value(0).toInt();
+        h.diagnoses = q->value(1).toLongLong();
+        h.lastDiagnosedAt = SqlTime::dateTime(q->value(2));
+        out.append(h);
+    }
+    q->finish();
+    QueryStats::addRows("patientsWithIcdCode", out.size());
     return true;
 }
 
-// 插入患者（注意列名要与表一致）
-bool Database::insertPatient(const QString& fullName, const QString& dateOfBirth, const QString& idNumber, const QString& phone, const QString& post, const QString& gender)
+bool Database::icdRollup(const QString &prefix, int groupLength, const QDateTime &from, const QDateTime &to,
+                         QVector<IcdRollup> &out)
 {
-    if (!db.isOpen()) {
-        qWarning() << "Database not open";
-        return false;
+    out.clear();
+    if (!db.isOpen()) return false;
+    // 前缀只能是一个编码（可以为空，表示全部编码）；逗号分隔的多个编码与 patientsWithIcdCode 一样返回空结果
+    const QStringList codes = Aggregates::icdCodes(prefix);
+    if (codes.size() > 1 || groupLength <= 0) return true;
+    const QString lo = codes.value(0);
+    const bool ranged = from.isValid() || to.isValid();
+    QSqlQuery *q = prepared(ranged ? kIcdRollupInRangeSql : kIcdRollupSql);
+    if (!q) return false;
+    q->bindValue(":len", groupLength);
+    q->bindValue(":lo", lo);
+    q->bindValue(":hi", lo + QChar(0xFFFF)); // 编码是 ASCII，U+FFFF 比后面任何字符都大
+    if (ranged) {
+        q->bindValue(":from", from.isValid() ? SqlTime::toSql(from) : QVariant(std::numeric_limits<qint64>::min()));
+        q->bindValue(":to", to.isValid() ? SqlTime::toSql(to) : QVariant(std::numeric_limits<qint64>::max()));
     }
-    QSqlQuery query(db);
-    const QString sql = R"(
-        INSERT INTO patients (full_name, date_of_birth, id_number, phone, post, gender)
-        VALUES (:full_name, :date_of_birth, :id_number, :phone, :post, :gender)
-    )";
-    if (!query.prepare(sql)) {
-        qWarning() << "prepare insertPatient failed:" << query.lastError().text();
+    if (!execTimed(*q, "icdRollup")) {
+        qWarning() << "icdRollup error:" << q->lastError().text();
         return false;
     }
-    query.bindValue(":full_name", fullName);
-    query.bindValue(":date_of_birth", dateOfBirth);
-    query.bindValue(":id_number", idNumber);
-    query.bindValue(":phone", phone);
-    query.bindValue(":post", post);
-    query.bindValue(":gender", gender);
-    if (!query.exec()) {
-        qWarning() << "Insert patient failed:" << query.lastError().text();
-        return false;
+    while (q->next()) {
+        IcdRollup r;
+        r.prefix = q->value(0).toString();
+        r.diagnoses = q->value(1).toLongLong();
+        r.patients = q->value(2).toLongLong();
+        out.append(r);
     }
+    q->finish();
+    QueryStats::addRows("icdRollup", out.size());
     return true;
 }
 
-// 插入医生（与表列保持一致：当前 doctors 表没有 gender 列）
-// Database.cpp
-// Replace or add this function in your Database implementation.
-
-bool Database::insertDoctor(int userId,
-                            const QString &fullName,
-                            const QString &phone,
-                            const QString &specialty,
-                            const QString &licenseNumber,
-                            const QString &clinicAddress)
+bool Database::rebuildAggregates()
 {
-    if (!db.isOpen()) {
-        qWarning() << "insertDoctor: db not open";
+    if (!db.isOpen()) return false;
+    if (!beginTx()) return false;
+    if (!Aggregates::rebuild(db)) {
+        rollbackTx();
         return false;
     }
+    return commitTx();
+}
 
-    // 确保外键工作（SQLite 每连接需要打开）
-    QSqlQuery fk(db);
-    fk.exec("PRAGMA foreign_keys = ON;");
-
-    // 1) 验证 users 表存在该 userId
-    {
-        QSqlQuery chk(db);
-        chk.prepare("SELECT 1 FROM users WHERE id = :uid LIMIT 1");
-        chk.bindValue(":uid", userId);
-        if (!chk.exec()) {
-            qWarning() << "insertDoctor: check user exec failed:" << chk.lastError().text();
-            return false;
-        }
-        if (!chk.next()) {
-            qWarning() << "insertDoctor: userId does not exist in users:" << userId;
-            return false;
-        }
+int Database::verifyAggregates(QStringList *mismatches, bool repair)
+{
+    if (!db.isOpen()) return -1;
+    // 写事务（BEGIN IMMEDIATE）：比较期间没有别的写入，修复也在同一个事务里；全表扫描期间其他写会等待
+    if (!beginTx()) return -1;
+    const int diffs = Aggregates::verify(db, mismatches);
+    if (diffs < 0) {
+        rollbackTx();
+        return -1;
     }
-
-    // 处理 licenseNumber：把空字符串当作 SQL NULL
-    QVariant licenseValue;
-    QString licenseTrim = licenseNumber.trimmed();
-    if (licenseTrim.isEmpty()) {
-        licenseValue = QVariant(); // NULL
-    } else {
-        licenseValue = licenseTrim;
-        // 如果是非空执业证号，先检查是否被其他 doctor 使用（避免 UNIQUE 失败）
-        QSqlQuery checkLicense(db);
-        checkLicense.prepare("SELECT id FROM doctors WHERE license_number = :lic LIMIT 1");
-        checkLicense.bindValue(":lic", licenseTrim);
-        if (!checkLicense.exec()) {
-            qWarning() << "insertDoctor: check license exec failed:" << checkLicense.lastError().text();
-            return false;
-        }
-        if (checkLicense.next()) {
-            int existingId = checkLicense.value(0).toInt();
-            if (existingId != userId) {
-                qWarning() << "insertDoctor: license number already used by doctor id=" << existingId;
-                // 这里可以根据业务决定：返回 false 并让调用者告知用户，或将冲突处理为 update 等
-                return false;
-            }
-            // 如果 existingId == userId，则允许继续（是更新或重复提交）
+    if (diffs > 0) {
+        qWarning() << "aggregates out of sync:" << diffs << "rows";
+        if (repair && !Aggregates::rebuild(db)) {
+            rollbackTx();
+            return -1;
         }
     }
+    if (!commitTx()) return -1;
+    return diffs;
+}
 
-    // 2) 检查 doctors 中是否已有该 id（你的表结构以 id==userId）
-    QSqlQuery exist(db);
-    exist.prepare("SELECT 1 FROM doctors WHERE id = :id LIMIT 1");
-    exist.bindValue(":id", userId);
-    if (!exist.exec()) {
-        qWarning() << "insertDoctor: check doctor exist failed:" << exist.lastError().text();
+// 一次就诊：诊断 + 医嘱 + 处方在同一个事务里写入，子记录的 diagnosisId 自动填成新诊断的 id
+bool Database::saveEncounter(DiagnosisRecord &diagnosis, QVector<MedicalOrderRecord> &orders, QVector<PrescriptionRecord> &prescriptions)
+{
+    if (!db.isOpen()) return false;
+    if (!beginTx()) return false;
+    bool ok = execInsert(diagnosis);
+    for (int i = 0; ok && i < orders.size(); ++i) {
+        orders[i].diagnosisId = diagnosis.id;
+        ok = execInsert(orders[i]);
+    }
+    for (int i = 0; ok && i < prescriptions.size(); ++i) {
+        prescriptions[i].diagnosisId = diagnosis.id;
+        ok = execInsert(prescriptions[i]);
+    }
+    if (!ok) {
+        rollbackTx();
+        diagnosis.id = 0;
+        for (MedicalOrderRecord &o : orders) o.id = 0;
+        for (PrescriptionRecord &p : prescriptions) p.id = 0;
         return false;
     }
+    return commitTx();
+}
 
-    bool useTx = db.driver()->hasFeature(QSqlDriver::Transactions);
-    if (useTx) db.transaction();
+// 记一条审计。事务里先攒着，commitTx() 成功后才入队，回滚的操作不留审计
+void Database::audit(const char *action, const char *objectType, qint64 objectId, const QString &details, int userId)
+{
+    AuditRecord e;
+    e.userId = userId;
+    e.action = action;
+    e.objectType = objectType;
+    e.objectId = objectId;
+    e.details = details;
+    e.createdAtMs = QDateTime::currentMSecsSinceEpoch();
+    if (txDepth > 0) pendingAudit.append(std::move(e));
+    else AuditLog::instance().record(std::move(e));
+}
 
-    if (exist.next()) {
-        // UPDATE existing row（注意绑定 licenseValue 可能为 NULL）
-        QSqlQuery q(db);
-        const QString sql = QStringLiteral(
-            "UPDATE doctors SET full_name = ?, phone = ?, specialty = ?, license_number = ?, clinic_address = ? WHERE id = ?"
-        );
-        if (!q.prepare(sql)) {
-            qWarning() << "insertDoctor: prepare UPDATE failed:" << q.lastError().text();
-            if (useTx) db.rollback();
-            return false;
-        }
-        q.addBindValue(fullName);
-        q.addBindValue(phone);
-        q.addBindValue(specialty);
-        q.addBindValue(licenseValue); // NULL 或 实际字符串
-        q.addBindValue(clinicAddress);
-        q.addBindValue(userId);
-        if (!q.exec()) {
-            qWarning() << "insertDoctor: UPDATE exec failed:" << q.lastError().text();
-            if (useTx) db.rollback();
-            return false;
-        }
-        if (useTx) db.commit();
-        qDebug() << "insertDoctor: updated existing doctor id=" << userId;
-        return true;
-    } else {
-        // INSERT 新行（id 存 userId）
-        QSqlQuery q(db);
-        const QString sql = QStringLiteral(
-            "INSERT INTO doctors (id, full_name, phone, specialty, license_number, clinic_address) VALUES (?, ?, ?, ?, ?, ?)"
-        );
-        if (!q.prepare(sql)) {
-            qWarning() << "insertDoctor: prepare INSERT failed:" << q.lastError().text();
-            if (useTx) db.rollback();
-            return false;
-        }
-        q.addBindValue(userId);
-        q.addBindValue(fullName);
-        q.addBindValue(phone);
-        q.addBindValue(specialty);
-        q.addBindValue(licenseValue); // NULL 或 实际字符串
-        q.addBindValue(clinicAddress);
+static const char *const kInsertAuditSql =
+    "INSERT INTO audit_logs (user_id, action, object_type, object_id, details, created_at) VALUES (?, ?, ?, ?, ?, ?)";
 
-        if (!q.exec()) {
-            qWarning() << "insertDoctor: INSERT exec failed:" << q.lastError().text();
-            // 如果是 UNIQUE constraint failed: doctors.license_number，可以在这里给出更友好的信息
-            if (q.lastError().text().contains("UNIQUE") && !licenseTrim.isEmpty()) {
-                qWarning() << "insertDoctor: license number conflict for value =" << licenseTrim;
-            }
-            if (useTx) db.rollback();
+// AuditLog 写入线程调用：一批一个事务。这里不能再调用 audit()
+bool Database::insertAuditEvents(const QVector<AuditRecord> &events)
+{
+    if (!db.isOpen()) return false;
+    if (events.isEmpty()) return true;
+    if (!beginTx()) return false;
+    QSqlQuery *q = prepared(kInsertAuditSql);
+    if (!q) {
+        rollbackTx();
+        return false;
+    }
+    for (const AuditRecord &e : events) {
+        q->bindValue(0, e.userId > 0 ? QVariant(e.userId) : QVariant());
+        q->bindValue(1, QString::fromUtf8(e.action));
+        q->bindValue(2, QString::fromUtf8(e.objectType));
+        q->bindValue(3, e.objectId > 0 ? QVariant(e.objectId) : QVariant());
+        q->bindValue(4, e.details.isEmpty() ? QVariant() : QVariant(e.details));
+        q->bindValue(5, e.createdAtMs / 1000); // 与其他表一致，存 Unix 秒
+        if (!execTimed(*q, "insertAuditEvent")) {
+            qWarning() << "insertAuditEvents error:" << q->lastError().text();
+            rollbackTx();
             return false;
         }
-        if (useTx) db.commit();
-        qDebug() << "insertDoctor: inserted new doctor id=" << userId;
-        return true;
     }
+    return commitTx();
 }
-// 其余插入方法保持不变（你之前实现的逻辑是可以的）
-// 例如 insertMedicalCase, insertAppointment, insertDiagnosis, insertMedicalOrder, insertPrescription
-// 请确保函数签名与 header 文件一致（如果 header 签名不同，请同步）
 
-bool Database::insertMedicalCase(int patientId, int createdByDoctorId, const QString &title, const QString &description, const QString &attachments)
+// 写事务：BEGIN IMMEDIATE 一开始就拿写锁，避免读锁升级时的死锁。
+// 支持嵌套，只有最外层真正提交；内层失败会让最外层的 commitTx() 改为回滚
+bool Database::beginTx()
 {
-    if (!db.isOpen()) return false;
-    QSqlQuery q(db);
-    q.prepare(R"(
-        INSERT INTO medical_cases (patient_id, created_by_doctor_id, title, description, attachments)
-        VALUES (:patient_id, :doctor_id, :title, :description, :attachments)
-    )");
-    q.bindValue(":patient_id", patientId);
-    q.bindValue(":doctor_id", createdByDoctorId);
-    q.bindValue(":title", title);
-    q.bindValue(":description", description);
-    q.bindValue(":attachments", attachments);
-    if (!q.exec()) {
-        qWarning() << "insertMedicalCase error:" << q.lastError().text();
+    if (txDepth++ > 0) return true;
+    txFailed = false;
+    QSqlQuery *q = prepared("BEGIN IMMEDIATE");
+    if (!q || !execTimed(*q, "begin")) {
+        qWarning() << "begin transaction error:" << (q ? q->lastError().text() : QString());
+        txDepth = 0;
         return false;
     }
     return true;
 }
 
-bool Database::insertAppointment(int patientId, int doctorId, const QString &scheduledAt, const QString &status, const QString &reason)
+bool Database::commitTx()
 {
-    if (!db.isOpen()) return false;
-    QSqlQuery q(db);
-    q.prepare(R"(
-        INSERT INTO appointments (patient_id, doctor_id, scheduled_at, status, reason)
-        VALUES (:patient_id, :doctor_id, :scheduled_at, :status, :reason)
-    )");
-    q.bindValue(":patient_id", patientId);
-    q.bindValue(":doctor_id", doctorId);
-    q.bindValue(":scheduled_at", scheduledAt);
-    q.bindValue(":status", status);
-    q.bindValue(":reason", reason);
-    if (!q.exec()) {
-        qWarning() << "insertAppointment error:" << q.lastError().text();
+    if (txDepth <= 0) return false;
+    if (--txDepth > 0) return !txFailed;
+    if (txFailed) {
+        ++txDepth;
+        rollbackTx();
+        return false;
+    }
+    QSqlQuery *q = prepared("COMMIT");
+    if (!q || !execTimed(*q, "commit")) {
+        qWarning() << "commit error:" << (q ? q->lastError().text() : QString());
+        ++txDepth;
+        rollbackTx();
         return false;
     }
+    // 提交成功后才把事务里的审计事件交出去
+    for (AuditRecord &e : pendingAudit) AuditLog::instance().record(std::move(e));
+    pendingAudit.clear();
+    flushUncache();
+    ChangeNotifier::instance().publish(pendingChanges);
+    pendingChanges.clear();
+    noteWrite();
     return true;
 }
 
-bool Database::insertDiagnosis(int caseId, int appointmentId, int doctorId, int patientId, const QString &diagnosisText, const QString &icdCodes)
+// SAVEPOINT 处记下待提交列表的长度；ROLLBACK TO 之后截回去，撤销掉的行不会在提交时发出审计、缓存失效和行变化
+Database::PendingMark Database::pendingMark() const
 {
-    if (!db.isOpen()) return false;
-    QSqlQuery q(db);
-    q.prepare(R"(
-        INSERT INTO diagnoses (case_id, appointment_id, doctor_id, patient_id, diagnosis_text, icd_codes)
-        VALUES (:case_id, :appointment_id, :doctor_id, :patient_id, :diagnosis_text, :icd_codes)
-    )");
-    q.bindValue(":case_id", caseId > 0 ? QVariant(caseId) : QVariant());
-    q.bindValue(":appointment_id", appointmentId > 0 ? QVariant(appointmentId) : QVariant());
-    q.bindValue(":doctor_id", doctorId);
-    q.bindValue(":patient_id", patientId);
-    q.bindValue(":diagnosis_text", diagnosisText);
-    q.bindValue(":icd_codes", icdCodes);
-    if (!q.exec()) {
-        qWarning() << "insertDiagnosis error:" << q.lastError().text();
-        return false;
-    }
-    return true;
+    PendingMark m;
+    m.audit = pendingAudit.size();
+    m.changes = pendingChanges.size();
+    m.usernames = pendingUncache.usernames.size();
+    m.userIds = pendingUncache.userIds.size();
+    m.patientIds = pendingUncache.patientIds.size();
+    m.doctorIds = pendingUncache.doctorIds.size();
+    return m;
 }
 
-bool Database::insertMedicalOrder(int diagnosisId, int doctorId, int patientId, const QString &orderText, const QString &orderType, const QString &status)
+void Database::discardPendingSince(const PendingMark &m)
 {
-    if (!db.isOpen()) return false;
-    QSqlQuery q(db);
-    q.prepare(R"(
-        INSERT INTO medical_orders (diagnosis_id, doctor_id, patient_id, order_text, order_type, status)
-        VALUES (:diagnosis_id, :doctor_id, :patient_id, :order_text, :order_type, :status)
-    )");
-    q.bindValue(":diagnosis_id", diagnosisId > 0 ? QVariant(diagnosisId) : QVariant());
-    q.bindValue(":doctor_id", doctorId);
-    q.bindValue(":patient_id", patientId);
-    q.bindValue(":order_text", orderText);
-    q.bindValue(":order_type", orderType);
-    q.bindValue(":status", status);
-    if (!q.exec()) {
-        qWarning() << "insertMedicalOrder error:" << q.lastError().text();
-        return false;
+    pendingAudit.resize(m.audit);
+    pendingChanges.resize(m.changes);
+    pendingUncache.usernames.erase(pendingUncache.usernames.begin() + m.usernames, pendingUncache.usernames.end());
+    pendingUncache.userIds.resize(m.userIds);
+    pendingUncache.patientIds.resize(m.patientIds);
+    pendingUncache.doctorIds.resize(m.doctorIds);
+}
+
+// 行变化通知：同 audit()，事务里先攒着，提交后才发出
+void Database::noteChange(const char *table, RowChange::Op op, qint64 rowId)
+{
+    RowChange c;
+    c.table = table;
+    c.op = op;
+    c.rowId = rowId;
+    if (txDepth > 0) {
+        pendingChanges.append(c);
+        return;
     }
-    return true;
+    ChangeNotifier::instance().publish(QVector<RowChange>{ c });
 }
 
-bool Database::insertPrescription(int diagnosisId, int doctorId, int patientId, const QString &medicationName, const QString &dosage, const QString &frequency, const QString &duration, const QString &notes)
+// 缓存失效：事务里攒到提交之后，回滚就丢掉（缓存里本来就是提交过的值）
+void Database::uncacheUser(int userId, const QString &username)
 {
-    if (!db.isOpen()) return false;
-    QSqlQuery q(db);
-    q.prepare(R"(
-        INSERT INTO prescriptions (diagnosis_id, doctor_id, patient_id, medication_name, dosage, frequency, duration, notes)
-        VALUES (:diagnosis_id, :doctor_id, :patient_id, :medication_name, :dosage, :frequency, :duration, :notes)
-    )");
-    q.bindValue(":diagnosis_id", diagnosisId > 0 ? QVariant(diagnosisId) : QVariant());
-    q.bindValue(":doctor_id", doctorId);
-    q.bindValue(":patient_id", patientId);
-    q.bindValue(":medication_name", medicationName);
-    q.bindValue(":dosage", dosage);
-    q.bindValue(":frequency", frequency);
-    q.bindValue(":duration", duration);
-    q.bindValue(":notes", notes);
-    if (!q.exec()) {
-        qWarning() << "insertPrescription error:" << q.lastError().text();
-        return false;
+    if (userId > 0) pendingUncache.userIds.append(userId);
+    if (!username.isEmpty()) pendingUncache.usernames.append(username);
+    if (txDepth == 0) flushUncache();
+}
+
+void Database::uncachePatient(int patientId)
+{
+    pendingUncache.patientIds.append(patientId);
+    if (txDepth == 0) flushUncache();
+}
+
+void Database::uncacheDoctor(int doctorId)
+{
+    pendingUncache.doctorIds.append(doctorId);
+    if (txDepth == 0) flushUncache();
+}
+
+void Database::flushUncache()
+{
+    RecordCache::instance().invalidate(pendingUncache);
+    pendingUncache.clear();
+}
+
+void Database::rollbackTx()
+{
+    if (txDepth <= 0) return;
+    txFailed = true;
+    if (--txDepth > 0) return;
+    pendingAudit.clear();
+    pendingUncache.clear();
+    pendingChanges.clear();
+    QSqlQuery *q = prepared("ROLLBACK");
+    if (!q || !execTimed(*q, "rollback")) {
+        qWarning() << "rollback error:" << (q ? q->lastError().text() : QString());
     }
-    return true;
+    txFailed = false;
 }
 
+// 旧接口：列名只接受 patients 表里可更新的列（以前会把任意 key 拼进 SQL）
 bool Database::updatePatient(int patientId, const QVariantMap &fields)
 {
     if (!db.isOpen()) return false;
     if (fields.isEmpty()) return true;
 
-    QStringList parts;
-    QMap<QString, QVariant> bound;
-    int idx = 0;
+    // 空的 QVariant 表示清空这一列（写 NULL）：保持为 null 的 QString 传下去，不要变成 ''
+    PatientUpdate u;
     for (auto it = fields.constBegin(); it != fields.constEnd(); ++it) {
-        QString key = it.key();
-        QString param = QString(":p%1").arg(idx++);
-        parts << QString("%1 = %2").arg(key, param);
-        bound[param] = it.value();
+        const QString &key = it.key();
+        const QString value = it.value().isNull() ? QString() : it.value().toString();
+        if (key == "full_name") u.setFullName(value);
+        else if (key == "date_of_birth") {
+            const QDate date = SqlTime::parseDate(value);
+            if (!value.isEmpty() && !date.isValid()) {
+                qWarning() << "updatePatient: bad date_of_birth:" << value;
+                return false;
+            }
+            u.setDateOfBirth(date);
+        }
+        else if (key == "id_number") u.setIdNumber(value);
+        else if (key == "phone") u.setPhone(value);
+        else if (key == "post") u.setPost(value);
+        else if (key == "gender") u.setGender(value);
+        else {
+            qWarning() << "updatePatient: column not allowed:" << key;
+            return false;
+        }
     }
-    QString sql = QString("UPDATE patients SET %1 WHERE id = :id").arg(parts.join(", "));
-    QSqlQuery q(db);
-    if (!q.prepare(sql)) {
-        qWarning() << "prepare updatePatient failed:" << q.lastError().text();
-        return false;
+    return updatePatient(patientId, u);
+}
+
+// 只更新 set 过的列。每种列组合的 UPDATE 语句 prepare 一次后缓存（最多 63 种）
+bool Database::updatePatient(int patientId, const PatientUpdate &update)
+{
+    if (!db.isOpen()) return false;
+    if (update.fields == 0) return true;
+
+    static const struct { int flag; const char *column; } columns[] = {
+        { PatientUpdate::FullName, "full_name" },
+        { PatientUpdate::DateOfBirth, "date_of_birth" },
+        { PatientUpdate::IdNumber, "id_number" },
+        { PatientUpdate::Phone, "phone" },
+        { PatientUpdate::Post, "post" },
+        { PatientUpdate::Gender, "gender" },
+    };
+
+    auto it = patientUpdateStmts.find(update.fields);
+    if (it == patientUpdateStmts.end()) {
+        QStringList parts;
+        for (const auto &c : columns) {
+            if (update.fields & c.flag) parts << QString("%1 = ?").arg(c.column);
+        }
+        QSqlQuery q(db);
+        if (!q.prepare(QString("UPDATE patients SET %1 WHERE id = ?").arg(parts.join(", ")))) {
+            qWarning() << "prepare updatePatient failed:" << q.lastError().text();
+            return false;
+        }
+        it = patientUpdateStmts.emplace(update.fields, q).first;
     }
-    for (auto it = bound.constBegin(); it != bound.constEnd(); ++it) {
-        q.bindValue(it.key(), it.value());
+    QSqlQuery &q = it->second;
+
+    // null 的 QString 明确绑定 NULL（Qt 6 的 QVariant 不再把它当作 null）：清空的 id_number 不会变成 '' 而撞上 UNIQUE
+    auto text = [](const QString &v) { return v.isNull() ? QVariant() : QVariant(v); };
+    const QVariant values[] = { text(update.fullName), SqlTime::toSql(update.dateOfBirth), text(update.idNumber),
+                                text(update.phone), text(update.post), text(update.gender) };
+    int pos = 0;
+    for (int i = 0; i < 6; ++i) {
+        if (update.fields & columns[i].flag) q.bindValue(pos++, values[i]);
     }
-    q.bindValue(":id", patientId);
-    if (!q.exec()) {
+    q.bindValue(pos, patientId);
+    if (!execTimed(q, "updatePatient")) {
         qWarning() << "updatePatient error:" << q.lastError().text();
         return false;
     }
+    // 审计只记改了哪些列，不记值
+    QStringList changed;
+    for (const auto &c : columns) {
+        if (update.fields & c.flag) changed << c.column;
+    }
+    audit("update", "patients", patientId, changed.join(','));
+    noteChange("patients", RowChange::Update, patientId);
+    uncachePatient(patientId);
+    noteWrite();
     return true;
 }
 
 bool Database::deletePatient(int patientId)
 {
     if (!db.isOpen()) return false;
-    QSqlQuery q(db);
-    q.prepare("DELETE FROM patients WHERE id = :id");
-    q.bindValue(":id", patientId);
-    if (!q.exec()) {
-        qWarning() << "deletePatient error:" << q.lastError().text();
+    QSqlQuery *q = prepared(kDeletePatientSql);
+    if (!q) return false;
+    q->bindValue(":id", patientId);
+    if (!execTimed(*q, "deletePatient")) {
+        qWarning() << "deletePatient error:" << q->lastError().text();
         return false;
     }
+    audit("delete", "patients", patientId);
+    noteChange("patients", RowChange::Delete, patientId);
+    uncachePatient(patientId);
+    noteWrite();
+    // 级联删掉的预约分布在哪些医生名下不知道，排班索引全部重新加载
+    AppointmentScheduler::instance().invalidateAll();
     return true;
 }
 
+// 表名不能绑定参数，只接受 schema 里已有的表
+static bool isKnownTable(const QString &tableName)
+{
+    static const QStringList tables = {
+        "users", "doctors", "patients", "medical_cases", "appointments",
+        "diagnoses", "medical_orders", "prescriptions", "audit_logs",
+    };
+    return tables.contains(tableName);
+}
+
 QSqlQueryModel* Database::modelForTable(const QString &tableName)
 {
-    QSqlQueryModel *model = new QSqlQueryModel;
+    QSqlQueryModel *model = new TimestampQueryModel;
+    if (!isKnownTable(tableName)) {
+        qWarning() << "modelForTable: unknown table" << tableName;
+        return model;
+    }
     model->setQuery(QString("SELECT * FROM %1").arg(tableName), db);
     return model;
 }
 
 QSqlQueryModel* Database::appointmentsForDoctorModel(int doctorId)
 {
-    QSqlQueryModel *model = new QSqlQueryModel;
+    QSqlQueryModel *model = new TimestampQueryModel;
     QSqlQuery q(db);
-    q.prepare(R"(
-        SELECT a.id, a.scheduled_at, a.status, a.reason, p.full_name AS patient_name, p.phone AS patient_phone
-        FROM appointments a
-        JOIN patients p ON p.id = a.patient_id
-        WHERE a.doctor_id = :did
-        ORDER BY a.scheduled_at ASC
-    )");
+    q.prepare(kAppointmentsForDoctorSql);
     q.bindValue(":did", doctorId);
-    if (!q.exec()) {
+    if (!execTimed(q, "appointmentsForDoctorModel")) {
         qWarning() << "appointmentsForDoctorModel query error:" << q.lastError().text();
     }
     model->setQuery(q);
@@ -602,16 +2215,11 @@ QSqlQueryModel* Database::appointmentsForDoctorModel(int doctorId)
 
 QSqlQueryModel* Database::casesForPatientModel(int patientId)
 {
-    QSqlQueryModel *model = new QSqlQueryModel;
+    QSqlQueryModel *model = new TimestampQueryModel;
     QSqlQuery q(db);
-    q.prepare(R"(
-        SELECT id, title, description, attachments, created_at
-        FROM medical_cases
-        WHERE patient_id = :pid
-        ORDER BY created_at DESC
-    )");
+    q.prepare(kCasesForPatientSql);
     q.bindValue(":pid", patientId);
-    if (!q.exec()) {
+    if (!execTimed(q, "casesForPatientModel")) {
         qWarning() << "casesForPatientModel query error:" << q.lastError().text();
     }
     model->setQuery(q);
@@ -620,24 +2228,202 @@ QSqlQueryModel* Database::casesForPatientModel(int patientId)
 
 QSqlQueryModel* Database::prescriptionsForPatientModel(int patientId)
 {
-    QSqlQueryModel *model = new QSqlQueryModel;
+    QSqlQueryModel *model = new TimestampQueryModel;
     QSqlQuery q(db);
-    q.prepare(R"(
-        SELECT pr.id, pr.medication_name, pr.dosage, pr.frequency, pr.duration, pr.issued_at, u.username AS prescriber
-        FROM prescriptions pr
-        JOIN users u ON u.id = pr.doctor_id
-        WHERE pr.patient_id = :pid
-        ORDER BY pr.issued_at DESC
-    )");
+    q.prepare(kPrescriptionsForPatientSql);
     q.bindValue(":pid", patientId);
-    if (!q.exec()) {
+    if (!execTimed(q, "prescriptionsForPatientModel")) {
         qWarning() << "prescriptionsForPatientModel query error:" << q.lastError().text();
     }
     model->setQuery(q);
     return model;
 }
 
+// 通用只读查询：结果按行取出为 QVariant，不依赖连接，可以交给其他线程
+bool Database::selectRows(const QString &sql, const QVariantList &args, Rows &out, QStringList *columnNames)
+{
+    out.clear();
+    if (!db.isOpen()) return false;
+    QSqlQuery q(db);
+    q.setForwardOnly(true);
+    if (!q.prepare(sql)) {
+        qWarning() << "selectRows prepare error:" << q.lastError().text();
+        return false;
+    }
+    for (int i = 0; i < args.size(); ++i) q.bindValue(i, args.at(i));
+    if (!execTimed(q, "selectRows")) {
+        qWarning() << "selectRows exec error:" << q.lastError().text();
+        return false;
+    }
+    const QSqlRecord rec = q.record();
+    const int cols = rec.count();
+    if (columnNames) {
+        columnNames->clear();
+        for (int c = 0; c < cols; ++c) columnNames->append(rec.fieldName(c));
+    }
+    while (q.next()) {
+        QVector<QVariant> row(cols);
+        for (int c = 0; c < cols; ++c) row[c] = q.value(c);
+        out.append(row);
+    }
+    QueryStats::addRows("selectRows", out.size());
+    return true;
+}
+
+// 只进游标：每读到一行就交给 onRow，不缓存结果集；onRow 返回 false 时提前结束。
+// 整个过程是一个读事务（同一个快照），WAL 下不阻塞写
+bool Database::streamRows(const QString &sql, const QVariantList &args,
+                          const std::function<bool(const QSqlQuery &)> &onRow, QStringList *columnNames)
+{
+    if (!db.isOpen()) return false;
+    QSqlQuery q(db);
+    q.setForwardOnly(true);
+    if (!q.prepare(sql)) {
+        qWarning() << "streamRows prepare error:" << q.lastError().text();
+        return false;
+    }
+    for (int i = 0; i < args.size(); ++i) q.bindValue(i, args.at(i));
+    if (!execTimed(q, "streamRows")) {
+        qWarning() << "streamRows exec error:" << q.lastError().text();
+        return false;
+    }
+    if (columnNames) {
+        const QSqlRecord rec = q.record();
+        columnNames->clear();
+        for (int c = 0; c < rec.count(); ++c) columnNames->append(rec.fieldName(c));
+    }
+    qint64 rows = 0;
+    while (q.next()) {
+        ++rows;
+        if (!onRow(q)) break;
+    }
+    QueryStats::addRows("streamRows", rows);
+    if (q.lastError().isValid()) {
+        qWarning() << "streamRows step error:" << q.lastError().text();
+        return false;
+    }
+    return true;
+}
+
+// 分页模型：模型本身在 UI 线程，页数据由 AsyncDatabase 后台线程读取
+PagedQueryModel *Database::pagedModelForTable(const QString &tableName, QObject *parent)
+{
+    if (!isKnownTable(tableName)) {
+        qWarning() << "pagedModelForTable: unknown table" << tableName;
+        return nullptr;
+    }
+    // 所有表都以 id 为主键，按 id 翻页
+    PagedQuerySpec spec;
+    spec.columns = "*";
+    spec.from = tableName;
+    spec.sortKey = "id";
+    spec.idKey = "id";
+    spec.exactCount = false; // audit_logs 之类的大表，COUNT(*) 要扫整张表
+    return new PagedQueryModel(spec, 200, 8, parent);
+}
+
+// 分页模型和实时模型共用的查询
+static PagedQuerySpec appointmentsForDoctorSpec(int doctorId)
+{
+    PagedQuerySpec spec;
+    spec.columns = "a.id, a.scheduled_at, a.status, a.reason, p.full_name AS patient_name, p.phone AS patient_phone";
+    spec.from = "appointments a JOIN patients p ON p.id = a.patient_id";
+    spec.where = "a.doctor_id = ?";
+    spec.whereArgs << doctorId;
+    spec.sortKey = "a.scheduled_at";
+    spec.idKey = "a.id";
+    spec.sortColumn = 1;
+    spec.idColumn = 0;
+    return spec;
+}
+
+static PagedQuerySpec casesForPatientSpec(int patientId)
+{
+    PagedQuerySpec spec;
+    spec.columns = "id, title, description, attachments, created_at";
+    spec.from = "medical_cases";
+    spec.where = "patient_id = ?";
+    spec.whereArgs << patientId;
+    spec.sortKey = "created_at";
+    spec.idKey = "id";
+    spec.descending = true;
+    spec.sortColumn = 4;
+    spec.idColumn = 0;
+    return spec;
+}
+
+static PagedQuerySpec prescriptionsForPatientSpec(int patientId)
+{
+    PagedQuerySpec spec;
+    spec.columns = "pr.id, pr.medication_name, pr.dosage, pr.frequency, pr.duration, pr.issued_at, u.username AS prescriber";
+    spec.from = "prescriptions pr JOIN users u ON u.id = pr.doctor_id";
+    spec.where = "pr.patient_id = ?";
+    spec.whereArgs << patientId;
+    spec.sortKey = "pr.issued_at";
+    spec.idKey = "pr.id";
+    spec.descending = true;
+    spec.sortColumn = 5;
+    spec.idColumn = 0;
+    return spec;
+}
+
+PagedQueryModel *Database::pagedAppointmentsForDoctorModel(int doctorId, QObject *parent)
+{
+    return new PagedQueryModel(appointmentsForDoctorSpec(doctorId), 200, 8, parent);
+}
+
+PagedQueryModel *Database::pagedCasesForPatientModel(int patientId, QObject *parent)
+{
+    return new PagedQueryModel(casesForPatientSpec(patientId), 200, 8, parent);
+}
+
+PagedQueryModel *Database::pagedPrescriptionsForPatientModel(int patientId, QObject *parent)
+{
+    return new PagedQueryModel(prescriptionsForPatientSpec(patientId), 200, 8, parent);
+}
+
+LiveQueryModel *Database::liveAppointmentsForDoctorModel(int doctorId, QObject *parent)
+{
+    LiveQuerySpec spec;
+    spec.query = appointmentsForDoctorSpec(doctorId);
+    spec.query.columns += ", a.patient_id"; // 不显示，只用来找某个患者的预约
+    spec.table = "appointments";
+    // 显示患者姓名和电话：患者修改时重读他的预约，删除时级联删掉的预约重读不到，按删除处理
+    LiveQuerySpec::Join patients;
+    patients.table = "patients";
+    patients.keyColumn = 6;
+    spec.joins << patients;
+    spec.hiddenColumns = 1;
+    return new LiveQueryModel(spec, parent);
+}
+
+LiveQueryModel *Database::liveCasesForPatientModel(int patientId, QObject *parent)
+{
+    LiveQuerySpec spec;
+    spec.query = casesForPatientSpec(patientId);
+    spec.table = "medical_cases";
+    spec.ownerTable = "patients";
+    spec.ownerId = patientId;
+    return new LiveQueryModel(spec, parent);
+}
+
+// 处方人的用户名不会改，users 的变化不用重读
+LiveQueryModel *Database::livePrescriptionsForPatientModel(int patientId, QObject *parent)
+{
+    LiveQuerySpec spec;
+    spec.query = prescriptionsForPatientSpec(patientId);
+    spec.table = "prescriptions";
+    spec.ownerTable = "patients";
+    spec.ownerId = patientId;
+    return new LiveQueryModel(spec, parent);
+}
+
 Database::~Database()
 {
+    // 只在线程结束时调用：先释放缓存的语句，再关闭并移除本线程的连接
+    stmtCache.clear();
+    patientUpdateStmts.clear();
     if (db.isOpen()) db.close();
+    db = QSqlDatabase();
+    QSqlDatabase::removeDatabase(connectionName);
 }
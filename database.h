@@ -4,44 +4,302 @@
 #include<QSqlError>
 #include<QSqlQuery>
 #include<QString>
+#include<QStringList>
 #include<QVariantMap>
 #include<QSqlQueryModel>
+#include<QVector>
+#include<unordered_map>
+#include<functional>
+#include "records.h"
+#include "recordcache.h"
+#include "changenotifier.h"
+#include<QtGlobal>
+
+class LiveQueryModel;
+class PagedQueryModel;
+
+// 登录结果：一次查询得到的用户记录 + 判定
+struct AuthResult
+{
+    enum Status { Ok, UnknownUser, BadPassword, Inactive, RoleMismatch, Error };
+    Status status = Error;
+    UserRecord user; // UnknownUser / Error 时为空；passwordHash 只在登录流程内部使用
+};
+
+// 注册请求：users 一行 + 按角色写 patients 或 doctors 一行
+struct RegistrationRequest
+{
+    QString username;
+    QString email;
+    QString password;
+    QString passwordHash;   // 已算好的哈希；为空时 registerAccount 用 password 现算
+    QString role;           // "患者" / "医生"，其他角色只写 users
+    QString fullName;
+    QString phone;
+    // 患者
+    QDate dateOfBirth;
+    QString idNumber;
+    QString post;
+    QString gender;
+    // 医生
+    QString specialty;
+    QString licenseNumber;  // 空字符串按 NULL 存
+    QString clinicAddress;
+};
+
+struct RegistrationResult
+{
+    enum Status { Ok, UsernameTaken, IdNumberTaken, LicenseTaken, Error };
+    Status status = Error;
+    int userId = 0;
+};
+
+// 批量导入的进度（import_progress 表的一行），计数是从第一次导入开始的累计值
+struct ImportProgress
+{
+    QString source;           // 导入文件的绝对路径
+    qint64 fileSize = 0;
+    qint64 byteOffset = 0;    // 已提交的最后一行之后的位置，续传时从这里读
+    qint64 lineNo = 0;
+    qint64 rowsRead = 0;
+    qint64 inserted = 0;
+    qint64 rejected = 0;      // 含解析失败和下面三种冲突
+    qint64 usernameConflicts = 0;
+    qint64 idNumberConflicts = 0;
+    qint64 licenseConflicts = 0;
+    bool finished = false;
+};
+
+// 时间线查询：按时间倒序（同一时刻按类型、id 倒序），键集翻页
+struct TimelineQuery
+{
+    int types = TimelineEvent::AllTypes;  // TimelineEvent::TypeMask 的组合
+    QDateTime from;                        // 可选，包含
+    QDateTime to;                          // 可选，不包含
+    int limit = 100;
+    // 上一页的最后一条（来自 timeline() 的 next）；type 为 0 表示从最新的开始
+    struct Cursor {
+        qint64 at = 0;
+        int type = 0;
+        qint64 id = 0;
+    } after;
+};
+
 class Database
 {
 
     //打开和关闭已经是自带的了
 public:
-    Database();
+    // 每个线程一个长期存在的连接：第一次调用时打开并初始化，线程结束时才关闭
+    static Database &instance();
     ~Database();
+    Database(const Database &) = delete;
+    Database &operator=(const Database &) = delete;
+
+    // 连接获取的统计（instance() 每次调用的耗时，单位纳秒）
+    struct ConnectionStats {
+        quint64 acquisitions = 0;   // instance() 调用次数
+        quint64 opens = 0;          // 实际打开连接的次数（每线程一次）
+        quint64 budgetOverruns = 0; // 超过预算的次数
+        qint64 maxAcquireNs = 0;    // 首次打开之外的最大获取耗时
+    };
+    static ConnectionStats connectionStats();
+    static void setAcquireBudgetNs(qint64 ns); // 默认 50us，超出计入 budgetOverruns，最多每 10 秒 qWarning 一次
+
+    // 连接配置：打开连接时执行一次对应的 PRAGMA。要在第一次 instance() 之前设置才对所有线程生效
+    struct ConnectionProfile {
+        QString databaseName = "medical_system.db"; // SQLite 文件路径
+        QString journalMode = "WAL";           // WAL 下读不阻塞写
+        QString synchronous = "NORMAL";        // WAL + NORMAL：掉电可能丢最后几次提交，但不会损坏
+        int cacheSizeKiB = 16 * 1024;          // 每连接页缓存
+        qint64 mmapSize = 256LL * 1024 * 1024; // 0 关闭 mmap
+        int busyTimeoutMs = 5000;
+        QString tempStore = "MEMORY";
+        // 检查点策略
+        int walAutoCheckpointPages = 1000;               // SQLite 自带的 PASSIVE 自动检查点
+        qint64 journalSizeLimit = 64LL * 1024 * 1024;    // 检查点后 -wal 文件最多保留的大小
+        qint64 walSizeLimitBytes = 256LL * 1024 * 1024;  // 超过后写路径做 PASSIVE 检查点，空闲时 TRUNCATE
+        int walCheckInterval = 500;                      // 每多少次写检查一次 -wal 大小
+    };
+    static ConnectionProfile connectionProfile();
+    static void setConnectionProfile(const ConnectionProfile &profile);
+    bool checkpoint(bool truncate = false); // 手动 WAL 检查点
+    bool checkpointIfIdle(); // -wal 超过 walSizeLimitBytes 时做 TRUNCATE 检查点，只在没有待办写的时候调用
 
     //关于用户的信息 （注册和登陆时可能会用到的）
     bool insertUser(const QString &username, const QString &email, const QString &passwordPlain, const QString &role);
+    // findUser / findPatient / findDoctor 先查进程内缓存（见 recordcache.h），事务里不走缓存
+    bool findUser(const QString &username, UserRecord &out); // 按列下标填充，不经过 QVariantMap
     bool findUserByUsername(const QString &username, QVariantMap &outUser); // returns true and fills outUser if found
+    bool findPatient(int patientId, PatientRecord &out);
+    bool findDoctor(int doctorId, DoctorRecord &out);
     bool verifyUserPassword(const QString &username, const QString &passwordPlain);
+    // 登录：只读一次 users（走 username 唯一索引），依次判断用户名、密码、is_active、角色。
+    // expectedRole 为空时不检查角色；查询出错返回 Error，不当作用户不存在
+    AuthResult authenticate(const QString &username, const QString &passwordPlain, const QString &expectedRole = QString());
+    // authenticate 拆成两步，供异步登录在两步之间把验密放到哈希线程池
+    AuthResult lookupLogin(const QString &username);
+    static void judgeLogin(AuthResult &r, bool passwordOk, const QString &expectedRole);
+    bool updatePasswordHash(int userId, const QString &passwordHash);
     //患者表:插入患者的数据 在注册中可以直接插入
-    bool insertPatient(const QString& fullName, const QString& dateOfBirth, const QString& idNumber, const QString& phone, const QString& post, const QString& gender);
+    bool insertPatient(const QString& fullName, const QDate& dateOfBirth, const QString& idNumber, const QString& phone, const QString& post, const QString& gender);
     bool insertDoctor(int userId, const QString &fullName, const QString &phone, const QString &specialty, const QString &licenseNumber, const QString &clinicAddress);
-    bool createTablesIfNeeded();//建立sql表
+    // 注册：一个事务里写 users 和 patients/doctors，新 id 取自插入本身；
+    // 重名等冲突靠 UNIQUE 约束报错识别，不做预查询。任何一步失败都整体回滚，不会留下孤立的 users 行
+    RegistrationResult registerAccount(const RegistrationRequest &req);
+    // 批量注册：整批一个事务，任何一行失败整批回滚；results 按输入顺序返回各行结果（失败时停在出错的那一行）
+    bool registerAccounts(const QVector<RegistrationRequest> &reqs, QVector<RegistrationResult> *results = nullptr);
+    // 批量导入（见 bulkimporter.h）：rows 在一个事务里写入，每行一个 SAVEPOINT，冲突的行单独撤销；
+    // progress 的计数按结果累加后与数据在同一事务里写进 import_progress。返回 false 表示整块回滚
+    bool importAccounts(const QVector<RegistrationRequest> &rows, ImportProgress &progress,
+                        QVector<RegistrationResult::Status> *statuses = nullptr);
+    bool loadImportProgress(const QString &source, ImportProgress &out); // 没有记录返回 false
+    bool resetImportProgress(const QString &source);
+    bool migrateSchema();//按 user_version 升级 sql 表（见 migrations.cpp）
+    QStringList queryPlanProblems(); // 热点查询的 EXPLAIN QUERY PLAN 检查，空列表表示都走索引
     // 病历/预约/诊断/医嘱/处方 插入
        bool insertMedicalCase(int patientId, int createdByDoctorId, const QString &title, const QString &description, const QString &attachments);
-       bool insertAppointment(int patientId, int doctorId, const QString &scheduledAt, const QString &status, const QString &reason);
+       bool insertAppointment(int patientId, int doctorId, const QDateTime &scheduledAt, const QString &status, const QString &reason);
+       // 带时长的预约：同一事务（BEGIN IMMEDIATE）里先查该医生有没有重叠的有效预约，没有才写入，
+       // 跨连接、跨进程都不会重复预约。有冲突时返回 false 且 conflict 为 true；成功后 r.id 已填好。
+       // 一般经由 AppointmentScheduler::book() 调用
+       bool insertAppointmentIfFree(AppointmentRecord &r, bool &conflict);
+       // 排班用：某医生 scheduled_at >= from 的未取消预约（只填 id / scheduledAt / durationMinutes）
+       bool bookedSlotsForDoctor(int doctorId, const QDateTime &from, QVector<AppointmentRecord> &out);
+       // 排班用：某个科室的所有医生 id（走 idx_doctors_specialty）
+       bool doctorsForSpecialty(const QString &specialty, QVector<int> &out);
        bool insertDiagnosis(int caseId, int appointmentId, int doctorId, int patientId, const QString &diagnosisText, const QString &icdCodes);
        bool insertMedicalOrder(int diagnosisId, int doctorId, int patientId, const QString &orderText, const QString &orderType, const QString &status);
        bool insertPrescription(int diagnosisId, int doctorId, int patientId, const QString &medicationName, const QString &dosage, const QString &frequency, const QString &duration, const QString &notes);
 
+       // 批量插入：整批一个事务、复用同一条预编译语句；全部成功或全部失败，outIds 按输入顺序返回新 id
+       bool insertDiagnoses(const QVector<DiagnosisRecord> &rows, QVector<int> *outIds = nullptr);
+       bool insertMedicalOrders(const QVector<MedicalOrderRecord> &rows, QVector<int> *outIds = nullptr);
+       bool insertPrescriptions(const QVector<PrescriptionRecord> &rows, QVector<int> *outIds = nullptr);
+       // 一次就诊的诊断、医嘱、处方一起保存（一个事务），成功后各记录的 id 已填好
+       bool saveEncounter(DiagnosisRecord &diagnosis, QVector<MedicalOrderRecord> &orders, QVector<PrescriptionRecord> &prescriptions);
+
        // 更新 / 删除（示例：患者）
-       bool updatePatient(int patientId, const QVariantMap &fields); // fields: column->value
+       bool updatePatient(int patientId, const QVariantMap &fields); // fields: column->value（只接受 patients 的可更新列）；空 QVariant 写 NULL，认不出的 date_of_birth 返回 false
+       bool updatePatient(int patientId, const PatientUpdate &update); // 只写 set 过的列
        bool deletePatient(int patientId);
 
-       // 查询模型（方便直接绑定到 QTableView）
+       // 查询模型（方便直接绑定到 QTableView），时间列显示为本地时间（见 sqltime.h）
        QSqlQueryModel* modelForTable(const QString &tableName); // caller owns the returned model
        QSqlQueryModel* appointmentsForDoctorModel(int doctorId); // caller owns the returned model
        QSqlQueryModel* casesForPatientModel(int patientId); // caller owns the returned model
        QSqlQueryModel* prescriptionsForPatientModel(int patientId); // caller owns the returned model
 
+       // 全文检索病历描述、诊断、处方（见 fulltextsearch.h）：按相关度排序，offset / limit 分页，patientId 为 0 时不限患者。
+       // 中文按二元组匹配，一个字也能查；snippet 是原文里命中附近的一段，命中的词用 highlightOpen / highlightClose 包起来
+       bool searchRecords(const QString &query, int patientId, int offset, int limit, QVector<SearchHit> &out,
+                          const QString &highlightOpen = "[", const QString &highlightClose = "]");
+       bool rebuildSearchIndex(); // 清空重建检索索引（一个事务）；绕过本类改过源表之后调用
+
+       // 管理端统计（见 aggregates.h）：只读增量维护的汇总表，读取量与结果行数成正比，与历史数据量无关。
+       // 日期是本地日期，from / to 都包含，无效表示不限
+       bool appointmentCountsForDoctor(int doctorId, const QDate &from, const QDate &to, QVector<AppointmentDayCount> &out);
+       bool appointmentCountsForDay(const QDate &day, QVector<AppointmentDayCount> &out); // 所有医生
+       bool topMedications(int limit, QVector<NamedCount> &out);  // 处方数从多到少
+       bool topIcdCodes(int limit, QVector<NamedCount> &out);     // 诊断数从多到少
+       bool rebuildAggregates(); // 清空重建 diagnosis_codes 和汇总表（一个事务）；绕过本类改过源表、或者改了时区之后调用
+       // 与源表现算的结果比较（全表扫描，维护用）：返回不一致的行数，出错返回 -1；
+       // repair 为 true 且有不一致时接着 rebuildAggregates()
+       int verifyAggregates(QStringList *mismatches = nullptr, bool repair = false);
+
+       // ICD 编码查询（diagnosis_codes，编码按 Aggregates::icdCodes() 规整：去空格、大写）。
+       // 有某个编码的患者：按 patient_id 升序，afterPatientId 是上一页的最后一个，返回少于 limit 条表示没有更多了
+       bool patientsWithIcdCode(const QString &code, int afterPatientId, int limit, QVector<IcdPatientHit> &out);
+       // 以 prefix 开头的编码截成前 groupLength 个字符分组计数，按前缀排序：
+       // prefix 为空、groupLength 为 1 是按章节字母，"J" 和 3 是 J 下的各个类目；prefix 含多个编码时结果为空。
+       // from / to 可选（诊断时间，to 不包含）；有时间范围时只读这段时间的行，否则只读这个前缀的行
+       bool icdRollup(const QString &prefix, int groupLength, const QDateTime &from, const QDateTime &to,
+                      QVector<IcdRollup> &out);
+
+       // 患者时间线：五张表按时间合并成一个有序结果。每张表沿 (patient_id, 时间) 索引倒序最多读 limit 条，
+       // 在内存里多路归并，读取量与 limit 成正比，与患者的历史长短无关。
+       // next 是这一页最后一条的位置，作为下一次的 query.after；返回的条数少于 limit 表示没有更多了
+       bool timeline(int patientId, const TimelineQuery &query, QVector<TimelineEvent> &out,
+                     TimelineQuery::Cursor *next = nullptr);
+
+       // 直接返回结构体的列表查询
+       bool appointmentsForDoctor(int doctorId, QVector<AppointmentRecord> &out);
+       bool prescriptionsForPatient(int patientId, QVector<PrescriptionRecord> &out);
+
+       // 分页懒加载模型（用 (排序键, id) 键集翻页，内存占用与表大小无关）。
+       // 可以在任何线程调用，模型属于调用线程，数据由 AsyncDatabase 后台线程读取
+       static PagedQueryModel* pagedModelForTable(const QString &tableName, QObject *parent = nullptr);
+       static PagedQueryModel* pagedAppointmentsForDoctorModel(int doctorId, QObject *parent = nullptr);
+       static PagedQueryModel* pagedCasesForPatientModel(int patientId, QObject *parent = nullptr);
+       static PagedQueryModel* pagedPrescriptionsForPatientModel(int patientId, QObject *parent = nullptr);
+
+       // 实时模型（见 livequerymodel.h）：全部结果常驻内存，之后按 ChangeNotifier 的通知只重读变化的行。
+       // 要在主线程调用，数据由 AsyncDatabase 后台线程读取
+       static LiveQueryModel* liveAppointmentsForDoctorModel(int doctorId, QObject *parent = nullptr);
+       static LiveQueryModel* liveCasesForPatientModel(int patientId, QObject *parent = nullptr);
+       static LiveQueryModel* livePrescriptionsForPatientModel(int patientId, QObject *parent = nullptr);
+
+       // 通用只读查询，? 占位按顺序绑定 args；结果是纯数据，可跨线程传递
+       typedef QVector<QVector<QVariant>> Rows;
+       bool selectRows(const QString &sql, const QVariantList &args, Rows &out, QStringList *columnNames = nullptr);
+       // 大结果集：只进游标逐行回调，内存占用与行数无关（导出用，见 recordexporter.h）
+       bool streamRows(const QString &sql, const QVariantList &args,
+                       const std::function<bool(const QSqlQuery &)> &onRow, QStringList *columnNames = nullptr);
+
+       // 审计日志批量写入（AuditLog 写入线程用）
+       bool insertAuditEvents(const QVector<AuditRecord> &events);
+
+       // 预编译语句缓存的命中统计（本线程连接）
+       struct StatementCacheStats {
+           quint64 hits = 0;
+           quint64 misses = 0;
+       };
+       StatementCacheStats statementCacheStats() const;
+
 private:
+    Database();
      QString hashPasswordDemo(const QString &plain) const;
+    QSqlQuery *prepared(const char *sql); // 取缓存的预编译语句，prepare 失败返回 nullptr
+    bool execTimed(QSqlQuery &q, const char *label); // q.exec() + 耗时统计，label 必须是字符串字面量
+    void applyProfile();
+    void noteWrite(); // 自动提交的写之后调用，按策略做检查点
+    bool walOversized() const;
+    // 写事务（可嵌套，只有最外层真正 BEGIN/COMMIT）
+    bool beginTx();
+    bool commitTx();
+    void rollbackTx();
+    // 写路径调用：不在事务里时立即让缓存失效，否则等提交
+    void uncacheUser(int userId, const QString &username = QString());
+    void uncachePatient(int patientId);
+    void uncacheDoctor(int doctorId);
+    void flushUncache();
+    void noteChange(const char *table, RowChange::Op op, qint64 rowId);
+    struct PendingMark { int audit = 0, changes = 0, usernames = 0, userIds = 0, patientIds = 0, doctorIds = 0; };
+    PendingMark pendingMark() const;
+    void discardPendingSince(const PendingMark &m); // ROLLBACK TO 一个 SAVEPOINT 之后调用
+    void audit(const char *action, const char *objectType, qint64 objectId,
+               const QString &details = QString(), int userId = 0);
+    int lookupUser(const QString &username, UserRecord &out); // 1 找到，0 不存在，-1 查询出错
+    RegistrationResult::Status insertAccountRows(const RegistrationRequest &req, int &userId);
+    bool execInsert(DiagnosisRecord &r);
+    bool execInsert(MedicalOrderRecord &r);
+    bool execInsert(PrescriptionRecord &r);
+    bool indexForSearch(int docType, qint64 id, int patientId, const QString &text); // docType: FullTextSearch::DocType
+    bool insertDiagnosisCodes(const DiagnosisRecord &r);
+    template <typename Record>
+    bool insertBatch(QVector<Record> rows, QVector<int> *outIds);
+    QString connectionName;
     QSqlDatabase db;
+    std::unordered_map<const char *, QSqlQuery> stmtCache; // 节点地址稳定，返回的指针不会因扩容失效
+    std::unordered_map<int, QSqlQuery> patientUpdateStmts; // key: PatientUpdate::fields
+    StatementCacheStats stmtStats;
+    int txDepth = 0;
+    bool txFailed = false;
+    QVector<AuditRecord> pendingAudit; // 当前事务里的审计事件，提交后入队
+    RecordCache::Invalidation pendingUncache; // 当前事务里要失效的缓存条目，提交后生效
+    QVector<RowChange> pendingChanges; // 当前事务里改过的行，提交后交给 ChangeNotifier
+    ConnectionProfile profile;
+    int writesSinceWalCheck = 0;
 
 };
 
@@ -0,0 +1,200 @@
+#include "fulltextsearch.h"
+#include <QDebug>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QStringView>
+#include <QVector>
+
+namespace {
+// 汉字（含扩展区和兼容区）、假名、谚文
+bool isCjk(uint c)
+{
+    return (c >= 0x3040 && c <= 0x30FF) || (c >= 0x3400 && c <= 0x4DBF) || (c >= 0x4E00 && c <= 0x9FFF)
+        || (c >= 0xF900 && c <= 0xFAFF) || (c >= 0xAC00 && c <= 0xD7AF) || (c >= 0x20000 && c <= 0x2FA1F);
+}
+
+// 一段连续的 CJK 字（每个字一个元素，扩展区的字占两个 UTF-16 单元）或一个普通单词（一个元素）。
+// 单词按 unicode61 的规则切：字母和数字以外的都是分隔符
+struct Segment
+{
+    bool cjk = false;
+    QStringList chars;
+};
+
+QVector<Segment> segments(const QString &text)
+{
+    QVector<Segment> out;
+    QString word;
+    auto flushWord = [&]() {
+        if (word.isEmpty()) return;
+        Segment s;
+        s.chars << word;
+        out.append(s);
+        word.clear();
+    };
+    bool inCjk = false;
+    for (int i = 0; i < text.size();) {
+        uint c = text.at(i).unicode();
+        int len = 1;
+        if (text.at(i).isHighSurrogate() && i + 1 < text.size() && text.at(i + 1).isLowSurrogate()) {
+            c = QChar::surrogateToUcs4(text.at(i), text.at(i + 1));
+            len = 2;
+        }
+        if (isCjk(c)) {
+            flushWord();
+            if (!inCjk) {
+                out.append(Segment());
+                out.last().cjk = true;
+            }
+            out.last().chars << text.mid(i, len);
+            inCjk = true;
+        } else {
+            inCjk = false;
+            if (QChar::isLetterOrNumber(c)) word += text.mid(i, len);
+            else flushWord();
+        }
+        i += len;
+    }
+    flushWord();
+    return out;
+}
+
+// FTS5 的字符串字面量：双引号括起来，内部的双引号写两次
+QString quoted(const QString &s)
+{
+    QString q = s;
+    q.replace(QLatin1Char('"'), QLatin1String("\"\""));
+    return QLatin1Char('"') + q + QLatin1Char('"');
+}
+
+// 三张源表的索引文本：几个字段用换行连接（Database 的插入接口按同样的方式拼接）
+const struct { FullTextSearch::DocType type; const char *sql; } kSources[] = {
+    { FullTextSearch::MedicalCase,
+      "SELECT id, patient_id, COALESCE(title, '') || char(10) || COALESCE(description, '') FROM medical_cases" },
+    { FullTextSearch::Diagnosis,
+      "SELECT id, patient_id, COALESCE(diagnosis_text, '') || char(10) || COALESCE(icd_codes, '') FROM diagnoses" },
+    { FullTextSearch::Prescription,
+      "SELECT id, patient_id, COALESCE(medication_name, '') || char(10) || COALESCE(notes, '') FROM prescriptions" },
+};
+}
+
+QString FullTextSearch::indexText(const QString &text)
+{
+    QStringList tokens;
+    for (const Segment &s : segments(text)) {
+        if (!s.cjk) {
+            tokens << s.chars.first();
+            continue;
+        }
+        for (int i = 0; i + 1 < s.chars.size(); ++i) tokens << s.chars.at(i) + s.chars.at(i + 1);
+        tokens << s.chars.last();
+    }
+    return tokens.join(QLatin1Char(' '));
+}
+
+QString FullTextSearch::matchExpression(const QString &query)
+{
+    QStringList terms;
+    for (const Segment &s : segments(query)) {
+        if (!s.cjk) {
+            terms << quoted(s.chars.first());
+        } else if (s.chars.size() == 1) {
+            // 单字：匹配以它开头的二元组，以及串尾的单字
+            terms << quoted(s.chars.first()) + QLatin1Char('*');
+        } else {
+            // 多字：相邻二元组组成的短语，等价于原文里连续出现
+            QStringList bigrams;
+            for (int i = 0; i + 1 < s.chars.size(); ++i) bigrams << s.chars.at(i) + s.chars.at(i + 1);
+            terms << quoted(bigrams.join(QLatin1Char(' ')));
+        }
+    }
+    return terms.join(QLatin1String(" AND "));
+}
+
+QStringList FullTextSearch::highlightTerms(const QString &query)
+{
+    QStringList terms;
+    for (const Segment &s : segments(query)) {
+        const QString term = s.chars.join(QString());
+        if (!terms.contains(term, Qt::CaseInsensitive)) terms << term;
+    }
+    return terms;
+}
+
+QString FullTextSearch::snippet(const QString &text, const QStringList &terms, int maxChars,
+                                const QString &open, const QString &close)
+{
+    int first = -1;
+    for (const QString &t : terms) {
+        const int pos = text.indexOf(t, 0, Qt::CaseInsensitive);
+        if (pos >= 0 && (first < 0 || pos < first)) first = pos;
+    }
+    // 命中位置放在窗口前三分之一处
+    int start = qMax(0, first - maxChars / 3);
+    const int end = qMin(text.size(), start + maxChars);
+    start = qMax(0, qMin(start, end - maxChars));
+    if (start > 0 && text.at(start).isLowSurrogate()) ++start;
+
+    const QString window = text.mid(start, end - start);
+    QString out;
+    if (start > 0) out += QChar(0x2026);
+    for (int i = 0; i < window.size();) {
+        // 同一位置取最长的命中词
+        int len = 0;
+        for (const QString &t : terms) {
+            if (t.size() > len && QStringView(window).mid(i, t.size()).compare(QStringView(t), Qt::CaseInsensitive) == 0)
+                len = t.size();
+        }
+        if (len > 0) {
+            out += open + window.mid(i, len) + close;
+            i += len;
+        } else {
+            const QChar c = window.at(i++);
+            out += (c == QLatin1Char('\n') || c == QLatin1Char('\r')) ? QChar(QLatin1Char(' ')) : c;
+        }
+    }
+    if (end < text.size()) out += QChar(0x2026);
+    return out;
+}
+
+bool FullTextSearch::rebuild(QSqlDatabase &db)
+{
+    QSqlQuery q(db);
+    if (!q.exec("DELETE FROM search_index")) {
+        qWarning() << "rebuild search index: clear error:" << q.lastError().text();
+        return false;
+    }
+    QSqlQuery ins(db);
+    if (!ins.prepare("INSERT INTO search_index (rowid, patient_id, body) VALUES (?, ?, ?)")) {
+        qWarning() << "rebuild search index: prepare error:" << ins.lastError().text();
+        return false;
+    }
+    qint64 indexed = 0;
+    for (const auto &src : kSources) {
+        QSqlQuery rows(db);
+        rows.setForwardOnly(true);
+        if (!rows.exec(src.sql)) {
+            qWarning() << "rebuild search index: read error:" << rows.lastError().text();
+            return false;
+        }
+        while (rows.next()) {
+            const QString body = indexText(rows.value(2).toString());
+            if (body.isEmpty()) continue;
+            ins.bindValue(0, rowId(src.type, rows.value(0).toLongLong()));
+            ins.bindValue(1, rows.value(1));
+            ins.bindValue(2, body);
+            if (!ins.exec()) {
+                qWarning() << "rebuild search index: insert error:" << ins.lastError().text();
+                return false;
+            }
+            ++indexed;
+        }
+    }
+    // 重建会产生很多小段，合并成一个段查询最快
+    if (!q.exec("INSERT INTO search_index (search_index) VALUES ('optimize')")) {
+        qWarning() << "rebuild search index: optimize error:" << q.lastError().text();
+        return false;
+    }
+    qDebug() << "search index rebuilt:" << indexed << "documents";
+    return true;
+}
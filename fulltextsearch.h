@@ -0,0 +1,38 @@
+#ifndef FULLTEXTSEARCH_H
+#define FULLTEXTSEARCH_H
+#include<QSqlDatabase>
+#include<QString>
+#include<QStringList>
+
+// 病历描述、诊断、处方的全文检索（schema v7 的 FTS5 表 search_index）。
+//
+// 中文没有空格分词，unicode61 会把一整串汉字当成一个词；trigram 又查不了两个字的词（“咳嗽”“发热”）。
+// 所以写入前在这里把 CJK 连续串切成重叠的二元组：“咳嗽痰” -> “咳嗽 嗽痰 痰”（末尾单字用于单字前缀查询），
+// 其余文字原样交给 unicode61。查询时同样切分：多字词是二元组短语，单字是前缀查询。
+//
+// search_index 的 rowid = 源表 id * 4 + DocType，源表行删除时由触发器删掉对应的索引行；
+// 插入由 Database 的插入接口在同一事务里写入。绕过 Database 直接改源表后要调用 rebuild()
+class FullTextSearch
+{
+public:
+    enum DocType { MedicalCase = 1, Diagnosis = 2, Prescription = 3 };
+
+    static qint64 rowId(DocType type, qint64 id) { return id * 4 + type; }
+    static DocType typeOf(qint64 rowId) { return DocType(rowId % 4); }
+    static qint64 idOf(qint64 rowId) { return rowId / 4; }
+
+    // 写入索引的文本（二元组切分后）
+    static QString indexText(const QString &text);
+    // 用户输入 -> FTS5 MATCH 表达式，空白分隔的各词之间是 AND；没有可查的词时返回空串
+    static QString matchExpression(const QString &query);
+    // 用户输入里要高亮的词（CJK 串和单词）
+    static QStringList highlightTerms(const QString &query);
+    // 从原文里截取第一个命中附近的 maxChars 个字符，命中的词用 open / close 包起来
+    static QString snippet(const QString &text, const QStringList &terms, int maxChars,
+                           const QString &open, const QString &close);
+
+    // 清空并按三张源表重建 search_index，之后合并索引段。调用方负责事务（migration 的 step 也用它）
+    static bool rebuild(QSqlDatabase &db);
+};
+
+#endif // FULLTEXTSEARCH_H
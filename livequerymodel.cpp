@@ -0,0 +1,269 @@
+#include "livequerymodel.h"
+#include "asyncdatabase.h"
+#include <QHash>
+#include <algorithm>
+
+namespace {
+// 一次按 id 重读的上限：批量导入之类一次改很多行时，整体重读更划算
+const int kMaxFetchIds = 200;
+
+// 排序键在 v6 之后都是整数；不是整数的按字符串比较
+int compareValues(const QVariant &a, const QVariant &b)
+{
+    bool okA = false;
+    bool okB = false;
+    const qint64 x = a.toLongLong(&okA);
+    const qint64 y = b.toLongLong(&okB);
+    if (okA && okB) return x < y ? -1 : (x > y ? 1 : 0);
+    return QString::compare(a.toString(), b.toString());
+}
+}
+
+LiveQueryModel::LiveQueryModel(const LiveQuerySpec &spec, QObject *parent)
+    : QAbstractTableModel(parent), spec(spec)
+{
+    connect(&ChangeNotifier::instance(), &ChangeNotifier::rowsChanged, this, &LiveQueryModel::onRowsChanged);
+    reload();
+}
+
+int LiveQueryModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : rows.size();
+}
+
+int LiveQueryModel::columnCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : headers.size();
+}
+
+QVariant LiveQueryModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || role != Qt::DisplayRole || index.row() >= rows.size()) return QVariant();
+    return SqlTime::display(timeKinds.value(index.column(), SqlTime::None), rows.at(index.row()).value(index.column()));
+}
+
+QVariant LiveQueryModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (orientation == Qt::Horizontal && role == Qt::DisplayRole && section < headers.size())
+        return headers.at(section);
+    return QAbstractTableModel::headerData(section, orientation, role);
+}
+
+// idCount > 0 时只取这些 id 的行（id 参数接在 whereArgs 之后）
+QString LiveQueryModel::selectSql(int idCount) const
+{
+    const PagedQuerySpec &q = spec.query;
+    QStringList conds;
+    if (!q.where.isEmpty()) conds << QString("(%1)").arg(q.where);
+    if (idCount > 0) {
+        QStringList marks;
+        for (int i = 0; i < idCount; ++i) marks << "?";
+        conds << QString("%1 IN (%2)").arg(q.idKey, marks.join(", "));
+    }
+    QString sql = QString("SELECT %1 FROM %2").arg(q.columns, q.from);
+    if (!conds.isEmpty()) sql += " WHERE " + conds.join(" AND ");
+    if (idCount == 0) {
+        const QString dir = q.descending ? "DESC" : "ASC";
+        sql += QString(" ORDER BY %1 %3, %2 %3").arg(q.sortKey, q.idKey, dir);
+    }
+    return sql;
+}
+
+void LiveQueryModel::reload()
+{
+    ++generation;
+    loading = true;
+    pendingIds.clear();
+    pendingJoinKeys.clear();
+    ++st.reloads;
+    const QString sql = selectSql(0);
+    const QVariantList args = spec.query.whereArgs;
+    const int gen = generation;
+    struct Result { Rows rows; QStringList names; };
+    AsyncDatabase::instance().post<Result>([sql, args](Database &db) {
+        Result r;
+        if (!db.selectRows(sql, args, r.rows, &r.names)) r.rows.clear();
+        return r;
+    }, this, [this, gen](Result r) {
+        onLoaded(gen, r.rows, r.names);
+    });
+}
+
+void LiveQueryModel::onLoaded(int gen, const Rows &result, const QStringList &names)
+{
+    if (gen != generation) return;
+    beginResetModel();
+    rows = result;
+    rowOf.clear();
+    reindexFrom(0);
+    endResetModel();
+    setHeaders(names);
+    loading = false;
+    emit loaded();
+    for (const auto &key : pendingJoinKeys) collectJoinRows(key.first, key.second, pendingIds);
+    pendingJoinKeys.clear();
+    // 读取期间提交的变化可能没有包含在结果里，补读一次（重读同一行是幂等的）
+    if (!pendingIds.isEmpty()) {
+        const QVector<qint64> ids(pendingIds.cbegin(), pendingIds.cend());
+        pendingIds.clear();
+        fetchRows(ids);
+    }
+}
+
+void LiveQueryModel::onRowsChanged(const QVector<RowChange> &changes)
+{
+    QSet<qint64> ids;
+    for (const RowChange &c : changes) {
+        const QLatin1String table(c.table);
+        if (!spec.ownerTable.isEmpty() && table == spec.ownerTable && c.rowId == spec.ownerId
+            && c.op == RowChange::Delete) {
+            ++generation;
+            loading = false;
+            pendingIds.clear();
+            pendingJoinKeys.clear();
+            beginResetModel();
+            rows.clear();
+            rowOf.clear();
+            endResetModel();
+            return;
+        }
+        if (table == spec.table) {
+            ids.insert(c.rowId);
+            continue;
+        }
+        // JOIN 的表新插入的行还没有被任何结果引用（引用它的主表行插入时会另有通知）
+        if (c.op == RowChange::Insert) continue;
+        for (int j = 0; j < spec.joins.size(); ++j) {
+            if (table != spec.joins.at(j).table) continue;
+            if (loading) pendingJoinKeys.append(qMakePair(j, c.rowId));
+            else collectJoinRows(j, c.rowId, ids);
+        }
+    }
+    if (ids.isEmpty()) return;
+    if (loading) {
+        pendingIds += ids;
+        return;
+    }
+    if (ids.size() > kMaxFetchIds) {
+        reload();
+        return;
+    }
+    fetchRows(QVector<qint64>(ids.cbegin(), ids.cend()));
+}
+
+// 按 id 重读：不满足 where 的（例如别的医生的预约）读不到，按删除处理，不在结果里就什么都不做
+void LiveQueryModel::fetchRows(const QVector<qint64> &ids)
+{
+    ++st.fetches;
+    const QString sql = selectSql(ids.size());
+    QVariantList args = spec.query.whereArgs;
+    for (qint64 id : ids) args << id;
+    const int gen = generation;
+    struct Result { Rows rows; QStringList names; };
+    AsyncDatabase::instance().post<Result>([sql, args](Database &db) {
+        Result r;
+        if (!db.selectRows(sql, args, r.rows, &r.names)) r.rows.clear();
+        return r;
+    }, this, [this, gen, ids](Result r) {
+        applyRows(gen, ids, r.rows, r.names);
+    });
+}
+
+void LiveQueryModel::applyRows(int gen, const QVector<qint64> &ids, const Rows &result, const QStringList &names)
+{
+    if (gen != generation) return;
+    setHeaders(names);
+    const int idColumn = spec.query.idColumn;
+    QHash<qint64, int> fetched;
+    for (int i = 0; i < result.size(); ++i) fetched.insert(result.at(i).value(idColumn).toLongLong(), i);
+
+    for (qint64 id : ids) {
+        const int at = findRow(id);
+        auto it = fetched.constFind(id);
+        if (it == fetched.constEnd()) {
+            if (at < 0) continue;
+            beginRemoveRows(QModelIndex(), at, at);
+            rows.remove(at);
+            rowOf.remove(id);
+            reindexFrom(at);
+            endRemoveRows();
+            ++st.removed;
+            continue;
+        }
+        const QVector<QVariant> &row = result.at(it.value());
+        if (at >= 0) {
+            // 排序键没变、仍在两个邻居之间：原地更新
+            const bool afterPrev = at == 0 || !lessThan(row, rows.at(at - 1));
+            const bool beforeNext = at + 1 >= rows.size() || !lessThan(rows.at(at + 1), row);
+            if (afterPrev && beforeNext) {
+                rows[at] = row;
+                if (!headers.isEmpty()) emit dataChanged(index(at, 0), index(at, headers.size() - 1));
+                ++st.updated;
+                continue;
+            }
+            beginRemoveRows(QModelIndex(), at, at);
+            rows.remove(at);
+            rowOf.remove(id);
+            reindexFrom(at);
+            endRemoveRows();
+        }
+        const int pos = insertPosition(row);
+        beginInsertRows(QModelIndex(), pos, pos);
+        rows.insert(pos, row);
+        reindexFrom(pos);
+        endInsertRows();
+        if (at >= 0) ++st.updated;
+        else ++st.inserted;
+    }
+}
+
+// 列名从第一次读到的结果里取（空结果也带列名），末尾 hiddenColumns 列不显示
+void LiveQueryModel::setHeaders(const QStringList &names)
+{
+    const int visible = names.size() - qMax(0, spec.hiddenColumns);
+    if (!headers.isEmpty() || visible <= 0) return;
+    beginInsertColumns(QModelIndex(), 0, visible - 1);
+    headers = names.mid(0, visible);
+    timeKinds.clear();
+    for (const QString &name : headers) timeKinds << SqlTime::kindOf(name);
+    endInsertColumns();
+}
+
+int LiveQueryModel::findRow(qint64 id) const
+{
+    return rowOf.value(id, -1);
+}
+
+// rows 从 pos 起插入或删除了一行之后，更新这之后各行的下标（与 QVector 的移动同样是 O(n - pos)）
+void LiveQueryModel::reindexFrom(int pos)
+{
+    const int idColumn = spec.query.idColumn;
+    for (int i = pos; i < rows.size(); ++i) rowOf.insert(rows.at(i).value(idColumn).toLongLong(), i);
+}
+
+// 引用了 joins[join] 这张表 key 这一行的结果行
+void LiveQueryModel::collectJoinRows(int join, qint64 key, QSet<qint64> &ids) const
+{
+    const int keyColumn = spec.joins.at(join).keyColumn;
+    const int idColumn = spec.query.idColumn;
+    for (const QVector<QVariant> &row : rows) {
+        if (row.value(keyColumn).toLongLong() == key) ids.insert(row.value(idColumn).toLongLong());
+    }
+}
+
+int LiveQueryModel::insertPosition(const QVector<QVariant> &row) const
+{
+    return int(std::upper_bound(rows.cbegin(), rows.cend(), row,
+                                [this](const QVector<QVariant> &a, const QVector<QVariant> &b) {
+                                    return lessThan(a, b);
+                                }) - rows.cbegin());
+}
+
+// 与 ORDER BY sortKey, idKey（同一方向）一致
+bool LiveQueryModel::lessThan(const QVector<QVariant> &a, const QVector<QVariant> &b) const
+{
+    const PagedQuerySpec &q = spec.query;
+    int c = compareValues(a.value(q.sortColumn), b.value(q.sortColumn));
+    if (c == 0) c = compareValues(a.value(q.idColumn), b.value(q.idColumn));
+    return q.descending ? c > 0 : c < 0;
+}
@@ -0,0 +1,91 @@
+#ifndef LIVEQUERYMODEL_H
+#define LIVEQUERYMODEL_H
+
+#include <QAbstractTableModel>
+#include <QHash>
+#include <QPair>
+#include <QSet>
+#include <QStringList>
+#include <QVariant>
+#include <QVector>
+#include "changenotifier.h"
+#include "pagedquerymodel.h"
+#include "sqltime.h"
+
+// 实时模型的查询：SELECT / 排序与分页模型相同，另外说明结果依赖哪些表
+struct LiveQuerySpec
+{
+    PagedQuerySpec query;
+    QString table;          // 主表，query.idKey 是它的 id：这张表的行变化按 id 只重读那几行
+    // JOIN 进来显示的表（例如患者姓名）。keyColumn 是结果里这张表的 id 所在的列：
+    // 这张表某一行修改或删除时，只重读引用它的那些结果行；插入不影响已有的结果，不处理
+    struct Join {
+        QString table;
+        int keyColumn = 0;
+    };
+    QVector<Join> joins;
+    int hiddenColumns = 0;  // query.columns 末尾只给 joins 用、不显示的列数
+    QString ownerTable;     // 结果都属于这一行（例如某个患者的处方）：它被删除时清空，
+    qint64 ownerId = 0;     // 级联删除的子行不会逐行通知
+};
+
+// 一直保持最新的只读表格模型：第一次读取全部结果，之后订阅 ChangeNotifier，
+// 主表有行插入 / 修改 / 删除时只按 id 重读这些行（JOIN 的表变化时重读引用它的行），
+// 在排好序的结果里插入、原地更新或移除，
+// 视图只收到对应行的 rowsInserted / dataChanged / rowsRemoved。
+// 读取都在 AsyncDatabase 后台线程执行；模型要在主线程创建（通知在主线程发出）
+class LiveQueryModel : public QAbstractTableModel
+{
+    Q_OBJECT
+
+public:
+    explicit LiveQueryModel(const LiveQuerySpec &spec, QObject *parent = nullptr);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+
+    struct Stats {
+        quint64 reloads = 0;     // 整体读取次数（含第一次）
+        quint64 fetches = 0;     // 按 id 增量读取的次数
+        quint64 inserted = 0;
+        quint64 updated = 0;
+        quint64 removed = 0;
+    };
+    Stats stats() const { return st; }
+
+public slots:
+    void reload();
+
+signals:
+    void loaded(); // 整体读取完成
+
+private:
+    typedef QVector<QVector<QVariant>> Rows;
+
+    void onRowsChanged(const QVector<RowChange> &changes);
+    void onLoaded(int gen, const Rows &result, const QStringList &names);
+    void fetchRows(const QVector<qint64> &ids);
+    void applyRows(int gen, const QVector<qint64> &ids, const Rows &result, const QStringList &names);
+    void setHeaders(const QStringList &names);
+    QString selectSql(int idCount) const;
+    int findRow(qint64 id) const;
+    void reindexFrom(int pos);
+    void collectJoinRows(int join, qint64 key, QSet<qint64> &ids) const;
+    int insertPosition(const QVector<QVariant> &row) const;
+    bool lessThan(const QVector<QVariant> &a, const QVector<QVariant> &b) const;
+
+    LiveQuerySpec spec;
+    Rows rows;
+    QHash<qint64, int> rowOf;  // id -> rows 里的下标
+    QStringList headers;
+    QVector<SqlTime::Kind> timeKinds;
+    int generation = 0;        // reload() 之后，之前发出的读取结果直接丢弃
+    bool loading = false;
+    QSet<qint64> pendingIds;   // 整体读取期间收到的变化，读完后再补读
+    QVector<QPair<int, qint64>> pendingJoinKeys; // 同上，JOIN 的表的变化：(joins 下标, 行 id)
+    Stats st;
+};
+
+#endif // LIVEQUERYMODEL_H
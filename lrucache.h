@@ -0,0 +1,96 @@
+#ifndef LRUCACHE_H
+#define LRUCACHE_H
+
+#include <QHash>
+#include <QtGlobal>
+#include <functional>
+#include <list>
+
+// 按代价（通常是估算的字节数）限制总量的 LRU 缓存：命中把条目移到队首，超出上限从队尾淘汰。
+// 不加锁，由使用方保护。与 QCache 不同的是值按拷贝返回、淘汰时可以回调（用来维护二级索引）
+template <typename Key, typename T>
+class LruCache
+{
+public:
+    explicit LruCache(qint64 maxCost = 0) : maxTotal(maxCost) {}
+
+    void setMaxCost(qint64 maxCost)
+    {
+        maxTotal = maxCost;
+        trim();
+    }
+    void setEvictionCallback(std::function<void(const Key &, const T &)> callback) { onEvict = std::move(callback); }
+
+    // 命中时拷贝到 out 并标记为最近使用
+    bool get(const Key &key, T &out)
+    {
+        auto it = index.constFind(key);
+        if (it == index.constEnd()) return false;
+        order.splice(order.begin(), order, it.value());
+        out = it.value()->value;
+        return true;
+    }
+
+    // 已有的同键条目被替换；单个条目超过上限时不缓存，返回 false
+    bool put(const Key &key, const T &value, qint64 cost)
+    {
+        remove(key);
+        if (cost > maxTotal) return false;
+        order.push_front(Node{ key, value, cost });
+        index.insert(key, order.begin());
+        total += cost;
+        trim();
+        return true;
+    }
+
+    bool remove(const Key &key, T *removed = nullptr)
+    {
+        auto it = index.find(key);
+        if (it == index.end()) return false;
+        if (removed) *removed = it.value()->value;
+        total -= it.value()->cost;
+        order.erase(it.value());
+        index.erase(it);
+        return true;
+    }
+
+    void clear()
+    {
+        order.clear();
+        index.clear();
+        total = 0;
+    }
+
+    int size() const { return index.size(); }
+    qint64 totalCost() const { return total; }
+    qint64 maxCost() const { return maxTotal; }
+    quint64 evictions() const { return evicted; }
+
+private:
+    struct Node {
+        Key key;
+        T value;
+        qint64 cost;
+    };
+
+    void trim()
+    {
+        while (total > maxTotal && !order.empty()) {
+            const Node &last = order.back();
+            if (onEvict) onEvict(last.key, last.value);
+            total -= last.cost;
+            index.remove(last.key);
+            order.pop_back();
+            ++evicted;
+        }
+    }
+
+    std::list<Node> order; // 队首是最近使用的
+    QHash<Key, typename std::list<Node>::iterator> index;
+    std::function<void(const Key &, const T &)> onEvict;
+    qint64 maxTotal = 0;
+    qint64 total = 0;
+    quint64 evicted = 0;
+};
+
+#endif // LRUCACHE_H
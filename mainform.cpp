@@ -2,7 +2,7 @@
 #include "ui_mainform.h"
 #include "register.h"
 #include <QMessageBox>
-#include "database.h"
+#include "asyncdatabase.h"
 #include <QPixmap>
 #include <QPainter>
 
@@ -30,32 +30,44 @@ void MainForm::onLoginClicked()
         return;
     }
 
-    Database db;
-    QVariantMap u;
-    if (!db.findUserByUsername(user, u)) {
+    // 查询在数据库后台线程（一次查询），验密在哈希线程池，UI 线程只等回调
+    const QString role = ui->comboBox_role->currentText();
+    ui->pushButton_login->setEnabled(false);
+    AsyncDatabase::instance().login(user, pwd, role, this, [this](AuthResult r) {
+        ui->pushButton_login->setEnabled(true);
+        onLoginChecked(r);
+    });
+}
+
+void MainForm::onLoginChecked(const AuthResult &r)
+{
+    switch (r.status) {
+    case AuthResult::UnknownUser:
         QMessageBox::warning(this, "登录失败", "用户名不存在！");
         return;
-    }
-    if (!db.verifyUserPassword(user, pwd)) {
+    case AuthResult::BadPassword:
         QMessageBox::warning(this, "登录失败", "密码错误！");
         return;
-    }
-    // 密码已验证通过
-    QString realRole = u["role"].toString();
-    if (realRole != ui->comboBox_role->currentText()) {
+    case AuthResult::Inactive:
+        QMessageBox::warning(this, "登录失败", "账号已停用！");
+        return;
+    case AuthResult::RoleMismatch:
         QMessageBox::warning(this, "登录失败", "身份选择错误！");
         return;
+    case AuthResult::Error:
+        QMessageBox::warning(this, "登录失败", "数据库错误！");
+        return;
+    case AuthResult::Ok:
+        break;
     }
 
-    QString role = u["role"].toString();
     QMessageBox::information(this, "登录成功",
-                             QString("欢迎 %1（%2）").arg(user, role));
+                             QString("欢迎 %1（%2）").arg(r.user.username, r.user.role));
 
 
 
     //触发信号   在需要使用目前登录id的界面的构造函数中connect链接 并写槽函数就行
-       int id=ui->lineEdit_user->text().toInt();
-       emit sendCurrentLoginID(id);
+       emit sendCurrentLoginID(r.user.id);
 
 }
 void MainForm::onRegClicked()
@@ -8,6 +8,7 @@ namespace Ui { class MainForm; }
 QT_END_NAMESPACE
 
 class Register; // 前向声明
+struct AuthResult;
 
 class MainForm : public QMainWindow
 {
@@ -24,6 +25,7 @@ private slots:
     void onRegClicked();
 
 private:
+    void onLoginChecked(const AuthResult &r);
     Ui::MainForm *ui;
     Register *regWindow;
 };
@@ -0,0 +1,514 @@
+#include "migrations.h"
+#include "aggregates.h"
+#include "fulltextsearch.h"
+#include <QDebug>
+#include <QSqlError>
+#include <QSqlQuery>
+
+namespace {
+// 整表重建（SQLite 改不了列类型）：建新表、转换着拷贝、删旧表、改名。
+// 删旧表会触发外键的级联动作，所以这种 migration 要在 foreign_keys = OFF 下执行（见 Migration::foreignKeysOff）。
+// AUTOINCREMENT 的表把 sqlite_sequence 带过去，删掉过的 id 不会被重新分配
+QStringList rebuildTable(const QString &table, const QString &columnsDdl, const QString &copySelect, bool autoincrement)
+{
+    const QString tmp = table + "_rebuild";
+    QStringList sql;
+    sql << QString("CREATE TABLE %1 (%2)").arg(tmp, columnsDdl)
+        << QString("INSERT INTO %1 SELECT %2 FROM %3").arg(tmp, copySelect, table);
+    if (autoincrement) {
+        sql << QString("DELETE FROM sqlite_sequence WHERE name = '%1'").arg(tmp)
+            << QString("INSERT INTO sqlite_sequence (name, seq) SELECT '%1', seq FROM sqlite_sequence WHERE name = '%2'")
+                   .arg(tmp, table);
+    }
+    sql << QString("DROP TABLE %1").arg(table)
+        << QString("ALTER TABLE %1 RENAME TO %2").arg(tmp, table);
+    return sql;
+}
+
+// v6 的转换表达式。strftime('%s') 认 CURRENT_TIMESTAMP 和 ISO 8601 格式，认不出的得到 NULL。
+// created_at / issued_at / updated_at 原来是 CURRENT_TIMESTAMP 默认值或程序按 UTC 格式化写入的，按 UTC 转换；
+// audit_logs.created_at 原来带毫秒，转换后与其他表一样是 Unix 秒，毫秒部分丢掉（之后写入的审计也只存到秒）
+const char *const kNowEpoch = "CAST(strftime('%s', 'now') AS INTEGER)";
+const char *const kTimestampDefault = "INTEGER NOT NULL DEFAULT (CAST(strftime('%s', 'now') AS INTEGER))";
+
+QString epochOrNow(const char *column)
+{
+    return QString("COALESCE(CAST(strftime('%s', %1) AS INTEGER), %2)").arg(QString(column), QString(kNowEpoch));
+}
+
+// scheduled_at 原来是界面上填写的本机时间，不带时区：按本机时区（'utc' 修饰符）转成 UTC。
+// 带 Z 或 ±hh:mm 后缀的已经有时区，strftime 自己会换算，不能再加 'utc'
+QString localEpoch(const char *column)
+{
+    return QString("CAST(CASE WHEN %1 GLOB '*[Zz]' OR %1 GLOB '*[+-][0-9][0-9]:[0-9][0-9]' "
+                   "THEN strftime('%s', %1) ELSE strftime('%s', %1, 'utc') END AS INTEGER)").arg(QString(column));
+}
+
+QStringList integerTimestamps()
+{
+    const QString ts = kTimestampDefault;
+    QStringList sql;
+    sql << rebuildTable("users",
+                        "id INTEGER PRIMARY KEY AUTOINCREMENT, username TEXT UNIQUE NOT NULL, email TEXT, "
+                        "password_hash TEXT NOT NULL, role TEXT NOT NULL, is_active INTEGER NOT NULL DEFAULT 1, "
+                        "created_at " + ts,
+                        "id, username, email, password_hash, role, is_active, " + epochOrNow("created_at"), true)
+        << rebuildTable("doctors",
+                        "id INTEGER PRIMARY KEY, full_name TEXT NOT NULL, phone TEXT, specialty TEXT, "
+                        "license_number TEXT UNIQUE, clinic_address TEXT, created_at " + ts + ", "
+                        "FOREIGN KEY(id) REFERENCES users(id) ON DELETE CASCADE",
+                        "id, full_name, phone, specialty, license_number, clinic_address, " + epochOrNow("created_at"),
+                        false)
+        // date_of_birth：1970-01-01 起的天数；认不出的生日存 NULL
+        << rebuildTable("patients",
+                        "id INTEGER PRIMARY KEY, full_name TEXT NOT NULL, date_of_birth INTEGER, id_number TEXT UNIQUE, "
+                        "phone TEXT, post TEXT, gender TEXT, created_at " + ts + ", "
+                        "FOREIGN KEY(id) REFERENCES users(id) ON DELETE CASCADE",
+                        "id, full_name, CAST(julianday(date(replace(trim(date_of_birth), '/', '-'))) - 2440587.5 AS INTEGER), "
+                        "id_number, phone, post, gender, " + epochOrNow("created_at"), false)
+        << rebuildTable("medical_cases",
+                        "id INTEGER PRIMARY KEY AUTOINCREMENT, patient_id INTEGER NOT NULL, created_by_doctor_id INTEGER, "
+                        "title TEXT, description TEXT, attachments TEXT, created_at " + ts + ", "
+                        "FOREIGN KEY(patient_id) REFERENCES patients(id) ON DELETE CASCADE, "
+                        "FOREIGN KEY(created_by_doctor_id) REFERENCES doctors(id)",
+                        "id, patient_id, created_by_doctor_id, title, description, attachments, " + epochOrNow("created_at"),
+                        true)
+        // scheduled_at 认不出时退回 created_at，保证 NOT NULL
+        << rebuildTable("appointments",
+                        "id INTEGER PRIMARY KEY AUTOINCREMENT, patient_id INTEGER NOT NULL, doctor_id INTEGER NOT NULL, "
+                        "scheduled_at INTEGER NOT NULL, status TEXT DEFAULT 'scheduled', reason TEXT, created_at " + ts + ", "
+                        "duration_minutes INTEGER NOT NULL DEFAULT 30, "
+                        "FOREIGN KEY(patient_id) REFERENCES patients(id) ON DELETE CASCADE, "
+                        "FOREIGN KEY(doctor_id) REFERENCES doctors(id) ON DELETE CASCADE",
+                        "id, patient_id, doctor_id, COALESCE(" + localEpoch("scheduled_at") + ", "
+                        + epochOrNow("created_at") + "), status, reason, " + epochOrNow("created_at") + ", duration_minutes",
+                        true)
+        << rebuildTable("diagnoses",
+                        "id INTEGER PRIMARY KEY AUTOINCREMENT, case_id INTEGER, appointment_id INTEGER, "
+                        "doctor_id INTEGER NOT NULL, patient_id INTEGER NOT NULL, diagnosis_text TEXT NOT NULL, "
+                        "icd_codes TEXT, created_at " + ts + ", "
+                        "FOREIGN KEY(case_id) REFERENCES medical_cases(id), "
+                        "FOREIGN KEY(appointment_id) REFERENCES appointments(id), "
+                        "FOREIGN KEY(doctor_id) REFERENCES doctors(id), FOREIGN KEY(patient_id) REFERENCES patients(id)",
+                        "id, case_id, appointment_id, doctor_id, patient_id, diagnosis_text, icd_codes, "
+                        + epochOrNow("created_at"), true)
+        << rebuildTable("medical_orders",
+                        "id INTEGER PRIMARY KEY AUTOINCREMENT, diagnosis_id INTEGER, doctor_id INTEGER NOT NULL, "
+                        "patient_id INTEGER NOT NULL, order_text TEXT NOT NULL, order_type TEXT, status TEXT, "
+                        "created_at " + ts + ", "
+                        "FOREIGN KEY(diagnosis_id) REFERENCES diagnoses(id), "
+                        "FOREIGN KEY(doctor_id) REFERENCES doctors(id), FOREIGN KEY(patient_id) REFERENCES patients(id)",
+                        "id, diagnosis_id, doctor_id, patient_id, order_text, order_type, status, " + epochOrNow("created_at"),
+                        true)
+        << rebuildTable("prescriptions",
+                        "id INTEGER PRIMARY KEY AUTOINCREMENT, diagnosis_id INTEGER, doctor_id INTEGER NOT NULL, "
+                        "patient_id INTEGER NOT NULL, medication_name TEXT NOT NULL, dosage TEXT, frequency TEXT, "
+                        "duration TEXT, notes TEXT, issued_at " + ts + ", "
+                        "FOREIGN KEY(diagnosis_id) REFERENCES diagnoses(id), "
+                        "FOREIGN KEY(doctor_id) REFERENCES doctors(id), FOREIGN KEY(patient_id) REFERENCES patients(id)",
+                        "id, diagnosis_id, doctor_id, patient_id, medication_name, dosage, frequency, duration, notes, "
+                        + epochOrNow("issued_at"), true)
+        << rebuildTable("audit_logs",
+                        "id INTEGER PRIMARY KEY AUTOINCREMENT, user_id INTEGER, action TEXT NOT NULL, object_type TEXT, "
+                        "object_id INTEGER, details TEXT, created_at " + ts,
+                        "id, user_id, action, object_type, object_id, details, " + epochOrNow("created_at"), true)
+        << rebuildTable("import_progress",
+                        "source TEXT PRIMARY KEY, file_size INTEGER NOT NULL, byte_offset INTEGER NOT NULL, "
+                        "line_no INTEGER NOT NULL, rows_read INTEGER NOT NULL DEFAULT 0, inserted INTEGER NOT NULL DEFAULT 0, "
+                        "rejected INTEGER NOT NULL DEFAULT 0, username_conflicts INTEGER NOT NULL DEFAULT 0, "
+                        "id_number_conflicts INTEGER NOT NULL DEFAULT 0, license_conflicts INTEGER NOT NULL DEFAULT 0, "
+                        "finished INTEGER NOT NULL DEFAULT 0, updated_at " + ts,
+                        "source, file_size, byte_offset, line_no, rows_read, inserted, rejected, username_conflicts, "
+                        "id_number_conflicts, license_conflicts, finished, " + epochOrNow("updated_at"), false);
+    // 删表时索引一起没了，按 v2 / v3 的定义重建
+    sql << "CREATE INDEX idx_appointments_doctor_scheduled ON appointments(doctor_id, scheduled_at)"
+        << "CREATE INDEX idx_appointments_patient_scheduled ON appointments(patient_id, scheduled_at)"
+        << "CREATE INDEX idx_cases_patient_created ON medical_cases(patient_id, created_at)"
+        << "CREATE INDEX idx_cases_doctor ON medical_cases(created_by_doctor_id)"
+        << "CREATE INDEX idx_prescriptions_patient_issued ON prescriptions(patient_id, issued_at DESC, id DESC)"
+        << "CREATE INDEX idx_prescriptions_doctor ON prescriptions(doctor_id)"
+        << "CREATE INDEX idx_prescriptions_diagnosis ON prescriptions(diagnosis_id)"
+        << "CREATE INDEX idx_diagnoses_patient_created ON diagnoses(patient_id, created_at)"
+        << "CREATE INDEX idx_diagnoses_case ON diagnoses(case_id)"
+        << "CREATE INDEX idx_diagnoses_appointment ON diagnoses(appointment_id)"
+        << "CREATE INDEX idx_diagnoses_doctor ON diagnoses(doctor_id)"
+        << "CREATE INDEX idx_orders_patient_created ON medical_orders(patient_id, created_at)"
+        << "CREATE INDEX idx_orders_diagnosis ON medical_orders(diagnosis_id)"
+        << "CREATE INDEX idx_orders_doctor ON medical_orders(doctor_id)"
+        << "CREATE INDEX idx_audit_object ON audit_logs(object_type, object_id)"
+        << "CREATE INDEX idx_audit_user_created ON audit_logs(user_id, created_at)";
+    return sql;
+}
+
+// v8 的汇总表和维护它们的触发器（见 aggregates.h）。
+// 减到 0 的行删掉，汇总表的大小只与出现过的 (医生, 日期, 状态) / 药名 / 编码的种类数有关
+QStringList aggregateTables()
+{
+    const QString newDay = Aggregates::localDaySql("new.scheduled_at");
+    const QString oldDay = Aggregates::localDaySql("old.scheduled_at");
+    const QString addAppointment = QString(
+        "INSERT INTO stats_appointments_daily (doctor_id, day, status, n) "
+        "VALUES (new.doctor_id, %1, COALESCE(new.status, ''), 1) "
+        "ON CONFLICT (doctor_id, day, status) DO UPDATE SET n = n + 1;").arg(newDay);
+    const QString removeAppointment = QString(
+        "UPDATE stats_appointments_daily SET n = n - 1 "
+        "WHERE doctor_id = old.doctor_id AND day = %1 AND status = COALESCE(old.status, ''); "
+        "DELETE FROM stats_appointments_daily "
+        "WHERE doctor_id = old.doctor_id AND day = %1 AND status = COALESCE(old.status, '') AND n <= 0;").arg(oldDay);
+    const QString addPrescription =
+        "INSERT INTO stats_medications (medication_name, n) VALUES (new.medication_name, 1) "
+        "ON CONFLICT (medication_name) DO UPDATE SET n = n + 1;";
+    const QString removePrescription =
+        "UPDATE stats_medications SET n = n - 1 WHERE medication_name = old.medication_name; "
+        "DELETE FROM stats_medications WHERE medication_name = old.medication_name AND n <= 0;";
+
+    QStringList sql;
+    sql << "CREATE TABLE stats_appointments_daily (doctor_id INTEGER NOT NULL, day INTEGER NOT NULL, "
+           "status TEXT NOT NULL, n INTEGER NOT NULL, PRIMARY KEY (doctor_id, day, status)) WITHOUT ROWID"
+        // 某一天所有医生（索引里带着主键，按 doctor_id, status 有序）
+        << "CREATE INDEX idx_stats_appointments_day ON stats_appointments_daily(day)"
+        << "CREATE TABLE stats_medications (medication_name TEXT PRIMARY KEY, n INTEGER NOT NULL) WITHOUT ROWID"
+        << "CREATE INDEX idx_stats_medications_n ON stats_medications(n DESC)"
+        << "CREATE TABLE stats_icd_codes (code TEXT PRIMARY KEY, n INTEGER NOT NULL) WITHOUT ROWID"
+        << "CREATE INDEX idx_stats_icd_codes_n ON stats_icd_codes(n DESC)"
+        << "CREATE TRIGGER stats_appointments_ai AFTER INSERT ON appointments BEGIN " + addAppointment + " END"
+        << "CREATE TRIGGER stats_appointments_ad AFTER DELETE ON appointments BEGIN " + removeAppointment + " END"
+        << QString("CREATE TRIGGER stats_appointments_au AFTER UPDATE OF doctor_id, scheduled_at, status ON appointments "
+                   "WHEN old.doctor_id IS NOT new.doctor_id OR old.status IS NOT new.status OR %1 IS NOT %2 BEGIN ")
+                   .arg(oldDay, newDay) + removeAppointment + " " + addAppointment + " END"
+        << "CREATE TRIGGER stats_medications_ai AFTER INSERT ON prescriptions BEGIN " + addPrescription + " END"
+        << "CREATE TRIGGER stats_medications_ad AFTER DELETE ON prescriptions BEGIN " + removePrescription + " END"
+        << "CREATE TRIGGER stats_medications_au AFTER UPDATE OF medication_name ON prescriptions "
+           "WHEN old.medication_name IS NOT new.medication_name BEGIN " + removePrescription + " " + addPrescription + " END"
+        // 插入由 Database 拆开编码后累加；删除时按 Aggregates::icdCodes() 的规则（去空格、大写）在编码表里逐个匹配，
+        // 编码表只有几百到几千行，删除诊断又很少见
+        << "CREATE TRIGGER stats_icd_codes_ad AFTER DELETE ON diagnoses WHEN old.icd_codes IS NOT NULL BEGIN "
+           "UPDATE stats_icd_codes SET n = n - 1 "
+           "WHERE instr(',' || upper(replace(old.icd_codes, ' ', '')) || ',', ',' || code || ',') > 0; "
+           "DELETE FROM stats_icd_codes WHERE n <= 0; END";
+    return sql;
+}
+}
+
+// 新的 schema 变更只能追加到末尾，已发布的 migration 不要修改
+const QVector<Migration> &Migrations::all()
+{
+    static const QVector<Migration> list = {
+        // v1：初始表结构。保留 IF NOT EXISTS，兼容没有 user_version 的旧数据库
+        { 1, "initial schema", {
+            // users
+            R"(
+            CREATE TABLE IF NOT EXISTS users (
+                id INTEGER PRIMARY KEY AUTOINCREMENT,
+                username TEXT UNIQUE NOT NULL,
+                email TEXT,
+                password_hash TEXT NOT NULL,
+                role TEXT NOT NULL,
+                is_active INTEGER NOT NULL DEFAULT 1,
+                created_at TEXT DEFAULT CURRENT_TIMESTAMP
+            );
+            )",
+            // doctors
+            R"(
+            CREATE TABLE IF NOT EXISTS doctors (
+                id INTEGER PRIMARY KEY, -- user id
+                full_name TEXT NOT NULL,
+                phone TEXT,
+                specialty TEXT,
+                license_number TEXT UNIQUE,
+                clinic_address TEXT,
+                created_at TEXT DEFAULT CURRENT_TIMESTAMP,
+                FOREIGN KEY(id) REFERENCES users(id) ON DELETE CASCADE
+            );
+            )",
+            // patients
+            R"(
+            CREATE TABLE IF NOT EXISTS patients (
+                id INTEGER PRIMARY KEY, -- user id
+                full_name TEXT NOT NULL,
+                date_of_birth TEXT,
+                id_number TEXT UNIQUE,
+                phone TEXT,
+                post TEXT,
+                gender TEXT,
+                created_at TEXT DEFAULT CURRENT_TIMESTAMP,
+                FOREIGN KEY(id) REFERENCES users(id) ON DELETE CASCADE
+            );
+            )",
+            // medical_cases
+            R"(
+            CREATE TABLE IF NOT EXISTS medical_cases (
+                id INTEGER PRIMARY KEY AUTOINCREMENT,
+                patient_id INTEGER NOT NULL,
+                created_by_doctor_id INTEGER,
+                title TEXT,
+                description TEXT,
+                attachments TEXT,
+                created_at TEXT DEFAULT CURRENT_TIMESTAMP,
+                FOREIGN KEY(patient_id) REFERENCES patients(id) ON DELETE CASCADE,
+                FOREIGN KEY(created_by_doctor_id) REFERENCES doctors(id)
+            );
+            )",
+            // appointments
+            R"(
+            CREATE TABLE IF NOT EXISTS appointments (
+                id INTEGER PRIMARY KEY AUTOINCREMENT,
+                patient_id INTEGER NOT NULL,
+                doctor_id INTEGER NOT NULL,
+                scheduled_at TEXT NOT NULL,
+                status TEXT DEFAULT 'scheduled',
+                reason TEXT,
+                created_at TEXT DEFAULT CURRENT_TIMESTAMP,
+                FOREIGN KEY(patient_id) REFERENCES patients(id) ON DELETE CASCADE,
+                FOREIGN KEY(doctor_id) REFERENCES doctors(id) ON DELETE CASCADE
+            );
+            )",
+            // diagnoses
+            R"(
+            CREATE TABLE IF NOT EXISTS diagnoses (
+                id INTEGER PRIMARY KEY AUTOINCREMENT,
+                case_id INTEGER,
+                appointment_id INTEGER,
+                doctor_id INTEGER NOT NULL,
+                patient_id INTEGER NOT NULL,
+                diagnosis_text TEXT NOT NULL,
+                icd_codes TEXT,
+                created_at TEXT DEFAULT CURRENT_TIMESTAMP,
+                FOREIGN KEY(case_id) REFERENCES medical_cases(id),
+                FOREIGN KEY(appointment_id) REFERENCES appointments(id),
+                FOREIGN KEY(doctor_id) REFERENCES doctors(id),
+                FOREIGN KEY(patient_id) REFERENCES patients(id)
+            );
+            )",
+            // medical_orders
+            R"(
+            CREATE TABLE IF NOT EXISTS medical_orders (
+                id INTEGER PRIMARY KEY AUTOINCREMENT,
+                diagnosis_id INTEGER,
+                doctor_id INTEGER NOT NULL,
+                patient_id INTEGER NOT NULL,
+                order_text TEXT NOT NULL,
+                order_type TEXT,
+                status TEXT,
+                created_at TEXT DEFAULT CURRENT_TIMESTAMP,
+                FOREIGN KEY(diagnosis_id) REFERENCES diagnoses(id),
+                FOREIGN KEY(doctor_id) REFERENCES doctors(id),
+                FOREIGN KEY(patient_id) REFERENCES patients(id)
+            );
+            )",
+            // prescriptions
+            R"(
+            CREATE TABLE IF NOT EXISTS prescriptions (
+                id INTEGER PRIMARY KEY AUTOINCREMENT,
+                diagnosis_id INTEGER,
+                doctor_id INTEGER NOT NULL,
+                patient_id INTEGER NOT NULL,
+                medication_name TEXT NOT NULL,
+                dosage TEXT,
+                frequency TEXT,
+                duration TEXT,
+                notes TEXT,
+                issued_at TEXT DEFAULT CURRENT_TIMESTAMP,
+                FOREIGN KEY(diagnosis_id) REFERENCES diagnoses(id),
+                FOREIGN KEY(doctor_id) REFERENCES doctors(id),
+                FOREIGN KEY(patient_id) REFERENCES patients(id)
+            );
+            )",
+            // audit_logs
+            R"(
+            CREATE TABLE IF NOT EXISTS audit_logs (
+                id INTEGER PRIMARY KEY AUTOINCREMENT,
+                user_id INTEGER,
+                action TEXT NOT NULL,
+                object_type TEXT,
+                object_id INTEGER,
+                details TEXT,
+                created_at TEXT DEFAULT CURRENT_TIMESTAMP
+            );
+            )"
+        } },
+        // v2：热点查询的二级索引（见 Database::queryPlanProblems()）
+        { 2, "secondary indexes", {
+            // appointments：医生日程 (doctor_id, scheduled_at)，患者侧同时作为 ON DELETE CASCADE 的子表索引
+            "CREATE INDEX IF NOT EXISTS idx_appointments_doctor_scheduled ON appointments(doctor_id, scheduled_at)",
+            "CREATE INDEX IF NOT EXISTS idx_appointments_patient_scheduled ON appointments(patient_id, scheduled_at)",
+            // medical_cases：按患者倒序列出病历
+            "CREATE INDEX IF NOT EXISTS idx_cases_patient_created ON medical_cases(patient_id, created_at)",
+            "CREATE INDEX IF NOT EXISTS idx_cases_doctor ON medical_cases(created_by_doctor_id)",
+            // prescriptions：按患者倒序列出处方
+            "CREATE INDEX IF NOT EXISTS idx_prescriptions_patient_issued ON prescriptions(patient_id, issued_at DESC)",
+            "CREATE INDEX IF NOT EXISTS idx_prescriptions_doctor ON prescriptions(doctor_id)",
+            "CREATE INDEX IF NOT EXISTS idx_prescriptions_diagnosis ON prescriptions(diagnosis_id)",
+            // diagnoses / medical_orders：外键子表索引，删除父行时不必全表扫描
+            "CREATE INDEX IF NOT EXISTS idx_diagnoses_patient_created ON diagnoses(patient_id, created_at)",
+            "CREATE INDEX IF NOT EXISTS idx_diagnoses_case ON diagnoses(case_id)",
+            "CREATE INDEX IF NOT EXISTS idx_diagnoses_appointment ON diagnoses(appointment_id)",
+            "CREATE INDEX IF NOT EXISTS idx_diagnoses_doctor ON diagnoses(doctor_id)",
+            "CREATE INDEX IF NOT EXISTS idx_orders_patient_created ON medical_orders(patient_id, created_at)",
+            "CREATE INDEX IF NOT EXISTS idx_orders_diagnosis ON medical_orders(diagnosis_id)",
+            "CREATE INDEX IF NOT EXISTS idx_orders_doctor ON medical_orders(doctor_id)",
+            // audit_logs：按对象 / 按操作人查询
+            "CREATE INDEX IF NOT EXISTS idx_audit_object ON audit_logs(object_type, object_id)",
+            "CREATE INDEX IF NOT EXISTS idx_audit_user_created ON audit_logs(user_id, created_at)"
+        } },
+        // v3：分页模型按 (issued_at, id) 倒序键集翻页，索引带上 id 才能免排序
+        { 3, "keyset paging index for prescriptions", {
+            "DROP INDEX IF EXISTS idx_prescriptions_patient_issued",
+            "CREATE INDEX idx_prescriptions_patient_issued ON prescriptions(patient_id, issued_at DESC, id DESC)"
+        } },
+        // v4：批量导入的断点。每个分块提交时在同一事务里更新，崩溃后从 byte_offset 继续
+        { 4, "bulk import progress", {
+            R"(
+            CREATE TABLE IF NOT EXISTS import_progress (
+                source TEXT PRIMARY KEY,          -- 导入文件的绝对路径
+                file_size INTEGER NOT NULL,
+                byte_offset INTEGER NOT NULL,     -- 已提交的最后一行之后的位置
+                line_no INTEGER NOT NULL,
+                rows_read INTEGER NOT NULL DEFAULT 0,
+                inserted INTEGER NOT NULL DEFAULT 0,
+                rejected INTEGER NOT NULL DEFAULT 0,
+                username_conflicts INTEGER NOT NULL DEFAULT 0,
+                id_number_conflicts INTEGER NOT NULL DEFAULT 0,
+                license_conflicts INTEGER NOT NULL DEFAULT 0,
+                finished INTEGER NOT NULL DEFAULT 0,
+                updated_at TEXT DEFAULT CURRENT_TIMESTAMP
+            );
+            )"
+        } },
+        // v5：预约时长，排班的冲突检查按 [scheduled_at, scheduled_at + duration) 判断重叠
+        { 5, "appointment duration", {
+            "ALTER TABLE appointments ADD COLUMN duration_minutes INTEGER NOT NULL DEFAULT 30"
+        } },
+        // v6：时间改存整数（时间戳是 Unix 秒，生日是 1970-01-01 起的天数），整数比较、索引更小，
+        // 格式不一的字符串也不会再打乱排序。要重建所有表
+        { 6, "integer timestamps", integerTimestamps(), nullptr, true },
+        // v7：病历描述、诊断、处方的全文检索（见 fulltextsearch.h）。正文由 C++ 切分后写入，所以插入不靠触发器；
+        // 删除靠触发器，患者删除时级联删掉的行也能跟着清掉。已有数据在 step 里建索引
+        { 7, "full-text search index", {
+            "CREATE VIRTUAL TABLE search_index USING fts5(patient_id UNINDEXED, body, tokenize = 'unicode61 remove_diacritics 2')",
+            "CREATE TRIGGER search_index_cases_ad AFTER DELETE ON medical_cases BEGIN "
+            "DELETE FROM search_index WHERE rowid = old.id * 4 + 1; END",
+            "CREATE TRIGGER search_index_diagnoses_ad AFTER DELETE ON diagnoses BEGIN "
+            "DELETE FROM search_index WHERE rowid = old.id * 4 + 2; END",
+            "CREATE TRIGGER search_index_prescriptions_ad AFTER DELETE ON prescriptions BEGIN "
+            "DELETE FROM search_index WHERE rowid = old.id * 4 + 3; END"
+        }, FullTextSearch::rebuild },
+        // v8：管理端统计的汇总表（见 aggregates.h），由触发器和插入接口增量维护，已有数据在 step 里汇总
+        { 8, "dashboard aggregates", aggregateTables(), Aggregates::rebuild },
+        // v9：诊断的 ICD 编码拆成 diagnosis_codes，一条诊断的每个编码一行，带上患者和诊断时间，
+        // 按编码找患者、按编码前缀 / 时间汇总都走索引，不再扫 diagnoses 解析文本。
+        // 插入由 Database 在同一事务里写；诊断删除时由触发器删掉。stats_icd_codes 改由这张表的触发器维护。
+        // step 从已有诊断的 icd_codes 拆出 diagnosis_codes 并重建全部汇总
+        { 9, "diagnosis codes", {
+            "CREATE TABLE diagnosis_codes (diagnosis_id INTEGER NOT NULL, code TEXT NOT NULL, "
+            "patient_id INTEGER NOT NULL, created_at INTEGER NOT NULL, PRIMARY KEY (diagnosis_id, code)) WITHOUT ROWID",
+            // 按编码 / 编码前缀（带 patient_id 按患者分组、翻页），按时间范围汇总；都是覆盖索引
+            "CREATE INDEX idx_diagnosis_codes_code ON diagnosis_codes(code, patient_id, created_at)",
+            "CREATE INDEX idx_diagnosis_codes_created ON diagnosis_codes(created_at, code, patient_id)",
+            "CREATE TRIGGER diagnosis_codes_ad AFTER DELETE ON diagnoses BEGIN "
+            "DELETE FROM diagnosis_codes WHERE diagnosis_id = old.id; END",
+            "DROP TRIGGER stats_icd_codes_ad",
+            "CREATE TRIGGER stats_icd_codes_ai AFTER INSERT ON diagnosis_codes BEGIN "
+            "INSERT INTO stats_icd_codes (code, n) VALUES (new.code, 1) ON CONFLICT (code) DO UPDATE SET n = n + 1; END",
+            "CREATE TRIGGER stats_icd_codes_ad AFTER DELETE ON diagnosis_codes BEGIN "
+            "UPDATE stats_icd_codes SET n = n - 1 WHERE code = old.code; "
+            "DELETE FROM stats_icd_codes WHERE code = old.code AND n <= 0; END"
+        }, Aggregates::rebuild },
+        // v10：按科室找医生（AppointmentScheduler::nextFreeSlotsForSpecialty），原来每次都扫整张 doctors
+        { 10, "doctors specialty index", {
+            "CREATE INDEX idx_doctors_specialty ON doctors(specialty)"
+        } },
+    };
+    return list;
+}
+
+int Migrations::latestVersion()
+{
+    return all().isEmpty() ? 0 : all().last().version;
+}
+
+int Migrations::currentVersion(QSqlDatabase &db)
+{
+    QSqlQuery q(db);
+    if (!q.exec("PRAGMA user_version") || !q.next()) {
+        qWarning() << "read user_version error:" << q.lastError().text();
+        return -1;
+    }
+    return q.value(0).toInt();
+}
+
+bool Migrations::migrate(QSqlDatabase &db)
+{
+    if (!db.isOpen()) return false;
+    const int latest = latestVersion();
+    int version = currentVersion(db);
+    if (version < 0) return false;
+    if (version >= latest) return true; // 常见路径：没有任何 DDL
+
+    QSqlQuery q(db);
+    // 有要重建表的 migration 时关掉外键：PRAGMA foreign_keys 在事务里不生效，只能在 BEGIN 之前改，结束后恢复
+    bool foreignKeysOff = false;
+    for (const Migration &m : all()) {
+        if (m.version > version && m.foreignKeysOff) foreignKeysOff = true;
+    }
+    bool foreignKeysWereOn = false;
+    if (foreignKeysOff) {
+        foreignKeysWereOn = q.exec("PRAGMA foreign_keys") && q.next() && q.value(0).toInt() != 0;
+        q.finish();
+        q.exec("PRAGMA foreign_keys = OFF");
+    }
+    const bool ok = migrateLocked(db, q);
+    if (foreignKeysWereOn) q.exec("PRAGMA foreign_keys = ON");
+    return ok;
+}
+
+bool Migrations::migrateLocked(QSqlDatabase &db, QSqlQuery &q)
+{
+    // IMMEDIATE：先拿到写锁，避免两个进程同时升级
+    if (!q.exec("BEGIN IMMEDIATE")) {
+        qWarning() << "migrate begin error:" << q.lastError().text();
+        return false;
+    }
+    // 拿到锁之后再读一次，别的进程可能已经升级过了
+    const int version = currentVersion(db);
+    if (version < 0) {
+        q.exec("ROLLBACK");
+        return false;
+    }
+
+    for (const Migration &m : all()) {
+        if (m.version <= version) continue;
+        for (const QString &sql : m.statements) {
+            if (!q.exec(sql)) {
+                qWarning() << "migration" << m.version << m.description << "error:" << q.lastError().text();
+                q.exec("ROLLBACK");
+                return false;
+            }
+        }
+        if (m.step && !m.step(db)) {
+            qWarning() << "migration" << m.version << m.description << "step failed";
+            q.exec("ROLLBACK");
+            return false;
+        }
+        // PRAGMA 不支持绑定参数
+        if (!q.exec(QString("PRAGMA user_version = %1").arg(m.version))) {
+            qWarning() << "set user_version error:" << q.lastError().text();
+            q.exec("ROLLBACK");
+            return false;
+        }
+        qDebug() << "migrated schema to version" << m.version << m.description;
+    }
+
+    // 关着外键重建过表：提交前确认没有悬空引用（只报告，重建本身不会产生新的）
+    if (q.exec("PRAGMA foreign_key_check")) {
+        int dangling = 0;
+        while (q.next()) ++dangling;
+        if (dangling > 0) qWarning() << "migrate: foreign_key_check reports" << dangling << "dangling references";
+    }
+    if (!q.exec("COMMIT")) {
+        qWarning() << "migrate commit error:" << q.lastError().text();
+        q.exec("ROLLBACK");
+        return false;
+    }
+    return true;
+}
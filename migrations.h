@@ -0,0 +1,33 @@
+#ifndef MIGRATIONS_H
+#define MIGRATIONS_H
+#include<QSqlDatabase>
+#include<QSqlQuery>
+#include<QStringList>
+#include<QVector>
+
+// 一个 schema 版本：先按顺序执行 statements，再执行可选的 C++ 数据转换步骤
+struct Migration
+{
+    int version;                               // 升级后的 PRAGMA user_version
+    const char *description;
+    QStringList statements;
+    bool (*step)(QSqlDatabase &db) = nullptr;  // 需要逐行转换数据时使用
+    bool foreignKeysOff = false;               // 要重建表时设置：整个升级事务在 foreign_keys = OFF 下执行
+};
+
+class Migrations
+{
+public:
+    static const QVector<Migration> &all();  // 按 version 递增排列
+    static int latestVersion();
+    static int currentVersion(QSqlDatabase &db);
+
+    // 把数据库升级到最新版本：已是最新时只读一次 user_version，
+    // 否则在一个事务里执行所有未应用的 migration，失败则整体回滚
+    static bool migrate(QSqlDatabase &db);
+
+private:
+    static bool migrateLocked(QSqlDatabase &db, QSqlQuery &q);
+};
+
+#endif // MIGRATIONS_H
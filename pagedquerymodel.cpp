@@ -0,0 +1,203 @@
+#include "pagedquerymodel.h"
+#include "asyncdatabase.h"
+#include <QDebug>
+
+PagedQueryModel::PagedQueryModel(const PagedQuerySpec &spec, int pageSize, int maxResidentPages, QObject *parent)
+    : QAbstractTableModel(parent), spec(spec), pageSize(qMax(1, pageSize)),
+      maxResidentPages(qMax(2, maxResidentPages))
+{
+    refresh();
+}
+
+void PagedQueryModel::refresh()
+{
+    beginResetModel();
+    ++generation;
+    pages.clear();
+    inFlight.clear();
+    pageStart.clear();
+    totalRows = 0;
+    countKnown = false;
+    lastPage = 0;
+    endResetModel();
+
+    // 不等 COUNT(*)，直接读第一页；行数先按读到的算
+    requestPage(0);
+}
+
+// 精确行数：第一页读满之后才统计，不耽误第一次显示
+void PagedQueryModel::requestCount()
+{
+    QString sql = QString("SELECT COUNT(*) FROM %1").arg(spec.from);
+    if (!spec.where.isEmpty()) sql += QString(" WHERE %1").arg(spec.where);
+    const QVariantList args = spec.whereArgs;
+    const int gen = generation;
+    AsyncDatabase::instance().post<int>([sql, args](Database &db) {
+        Database::Rows rows;
+        if (!db.selectRows(sql, args, rows) || rows.isEmpty()) return -1;
+        return rows.first().value(0).toInt();
+    }, this, [this, gen](int count) {
+        if (gen != generation || countKnown || count < 0) return;
+        countKnown = true;
+        setTotalRows(count);
+    });
+}
+
+void PagedQueryModel::setTotalRows(int rows)
+{
+    if (rows > totalRows) {
+        beginInsertRows(QModelIndex(), totalRows, rows - 1);
+        totalRows = rows;
+        endInsertRows();
+    } else if (rows < totalRows) {
+        beginRemoveRows(QModelIndex(), rows, totalRows - 1);
+        totalRows = rows;
+        endRemoveRows();
+    }
+}
+
+int PagedQueryModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : totalRows;
+}
+
+int PagedQueryModel::columnCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : headers.size();
+}
+
+QVariant PagedQueryModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || role != Qt::DisplayRole) return QVariant();
+    const int page = index.row() / pageSize;
+    auto it = pages.constFind(page);
+    if (page != lastPage) {
+        lastPage = page;
+        // 当前页已在内存时顺带预取下一页（起点键已知，走键集翻页）
+        if (it != pages.constEnd()) requestPage(page + 1);
+    }
+    if (it == pages.constEnd()) {
+        requestPage(page); // 到达后 dataChanged 会让视图重绘
+        return QVariant();
+    }
+    const int r = index.row() - page * pageSize;
+    if (r >= it->size()) return QVariant();
+    // 键集翻页用的是原始整数，只在显示时转换
+    return SqlTime::display(timeKinds.value(index.column(), SqlTime::None), it->at(r).value(index.column()));
+}
+
+QVariant PagedQueryModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (orientation == Qt::Horizontal && role == Qt::DisplayRole && section < headers.size())
+        return headers.at(section);
+    return QAbstractTableModel::headerData(section, orientation, role);
+}
+
+QString PagedQueryModel::pageSql(int page, QVariantList &args) const
+{
+    const QString dir = spec.descending ? "DESC" : "ASC";
+    QStringList conds;
+    args = spec.whereArgs;
+    if (!spec.where.isEmpty()) conds << QString("(%1)").arg(spec.where);
+
+    QString tail = QString(" ORDER BY %1 %3, %2 %3 LIMIT %4").arg(spec.sortKey, spec.idKey, dir).arg(pageSize);
+    auto start = pageStart.constFind(page);
+    if (page > 0 && start != pageStart.constEnd()) {
+        // 键集翻页：从上一页最后一行之后开始，走 (sortKey, id) 索引，不随页号变慢
+        conds << QString("(%1, %2) %3 (?, ?)").arg(spec.sortKey, spec.idKey, QString(spec.descending ? "<" : ">"));
+        args << start->first << start->second;
+    } else if (page > 0) {
+        // 跳页且不知道起点，只能 OFFSET；取回后这一页之后的页又可以走键集
+        tail += QString(" OFFSET %1").arg(qint64(page) * pageSize);
+    }
+
+    QString sql = QString("SELECT %1 FROM %2").arg(spec.columns, spec.from);
+    if (!conds.isEmpty()) sql += " WHERE " + conds.join(" AND ");
+    return sql + tail;
+}
+
+void PagedQueryModel::requestPage(int page) const
+{
+    // 行数还不确定时，只能读到已知行之后紧接着的那一页
+    if (page < 0 || qint64(page) * pageSize > totalRows || (countKnown && qint64(page) * pageSize >= totalRows)) return;
+    if (pages.contains(page) || inFlight.contains(page)) return;
+    inFlight.insert(page);
+
+    QVariantList args;
+    const QString sql = pageSql(page, args);
+    const int gen = generation;
+    PagedQueryModel *self = const_cast<PagedQueryModel *>(this);
+    struct Result { Database::Rows rows; QStringList names; };
+    AsyncDatabase::instance().post<Result>([sql, args](Database &db) {
+        Result r;
+        if (!db.selectRows(sql, args, r.rows, &r.names)) r.rows.clear();
+        return r;
+    }, self, [self, gen, page](Result r) {
+        self->onPageLoaded(gen, page, r.rows, r.names);
+    });
+}
+
+void PagedQueryModel::onPageLoaded(int gen, int page, const Rows &rows, const QStringList &names)
+{
+    if (gen != generation) return;
+    inFlight.remove(page);
+
+    if (headers.isEmpty() && !names.isEmpty()) {
+        beginInsertColumns(QModelIndex(), 0, names.size() - 1);
+        headers = names;
+        timeKinds.clear();
+        for (const QString &name : names) timeKinds << SqlTime::kindOf(name);
+        endInsertColumns();
+    }
+
+    pages.insert(page, rows);
+    if (!rows.isEmpty()) {
+        const QVector<QVariant> &last = rows.last();
+        pageStart.insert(page + 1, Key(last.value(spec.sortColumn), last.value(spec.idColumn)));
+    }
+    if (!countKnown) {
+        const int end = page * pageSize + rows.size();
+        if (rows.size() < pageSize) {
+            // 不满的一页就是最后一页，行数确定了，不用再 COUNT(*)
+            countKnown = true;
+            setTotalRows(end);
+        } else {
+            setTotalRows(qMax(totalRows, end));
+            if (page == 0 && spec.exactCount) requestCount();
+        }
+    }
+    // 正在看的这一页到了，预取下一页
+    if (page == lastPage) requestPage(page + 1);
+    evictFarPages();
+
+    const int first = page * pageSize;
+    const int lastRow = qMin(totalRows, first + pageSize) - 1;
+    if (lastRow >= first && !headers.isEmpty())
+        emit dataChanged(index(first, 0), index(lastRow, headers.size() - 1));
+    emit pageLoaded(page);
+}
+
+void PagedQueryModel::evictFarPages()
+{
+    while (pages.size() > maxResidentPages) {
+        int farthest = -1;
+        int farthestDist = -1;
+        for (auto it = pages.constBegin(); it != pages.constEnd(); ++it) {
+            const int dist = qAbs(it.key() - lastPage);
+            if (dist > farthestDist) {
+                farthestDist = dist;
+                farthest = it.key();
+            }
+        }
+        pages.remove(farthest); // 起点键保留在 pageStart 里，再回来时仍走键集翻页
+    }
+    // 起点键同样只留附近的，内存不随翻过的页数增长；丢掉的页再回去时退回 OFFSET
+    const int maxCursors = 4 * maxResidentPages;
+    while (pageStart.size() > maxCursors) {
+        auto farthest = pageStart.begin();
+        for (auto it = pageStart.begin(); it != pageStart.end(); ++it) {
+            if (qAbs(it.key() - lastPage) > qAbs(farthest.key() - lastPage)) farthest = it;
+        }
+        pageStart.erase(farthest);
+    }
+}
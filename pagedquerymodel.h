@@ -0,0 +1,85 @@
+#ifndef PAGEDQUERYMODEL_H
+#define PAGEDQUERYMODEL_H
+
+#include <QAbstractTableModel>
+#include <QHash>
+#include <QPair>
+#include <QSet>
+#include <QStringList>
+#include <QVariant>
+#include <QVector>
+#include "sqltime.h"
+
+// 分页查询：SELECT <columns> FROM <from> [WHERE <where>] ORDER BY <sortKey>, <idKey>
+// sortKey 必须 NOT NULL，(sortKey, idKey) 最好有对应的复合索引
+struct PagedQuerySpec
+{
+    QString columns;
+    QString from;
+    QString where;          // 可为空；用 ? 占位
+    QVariantList whereArgs;
+    QString sortKey;
+    QString idKey;
+    bool descending = false;
+    int sortColumn = 0;     // sortKey 在 columns 里的下标
+    int idColumn = 0;       // idKey 在 columns 里的下标
+    // false 时不做 COUNT(*)：行数随读到的页增长，读到不满的一页才确定。整表（如 audit_logs）用这个，
+    // 否则第一页显示之后再在后台统计精确行数
+    bool exactCount = true;
+};
+
+// 按页懒加载的只读表格模型，替代一次取完全部结果的 QSqlQueryModel。
+// 页通过 (sortKey, id) 键集翻页在数据库后台线程读取，访问某页时顺带预取下一页，
+// 内存里最多保留 maxResidentPages 页，离当前位置最远的页先被丢弃；翻页用的起点键也只保留当前位置附近的。
+// 第一页不等 COUNT(*)，行数先按已读到的行算，精确行数之后再补上（见 PagedQuerySpec::exactCount）。
+class PagedQueryModel : public QAbstractTableModel
+{
+    Q_OBJECT
+
+public:
+    explicit PagedQueryModel(const PagedQuerySpec &spec, int pageSize = 200, int maxResidentPages = 8,
+                             QObject *parent = nullptr);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+
+    int residentPages() const { return pages.size(); }
+
+public slots:
+    // 数据有变化时调用：丢掉所有页，重新统计行数
+    void refresh();
+
+signals:
+    void pageLoaded(int page);
+
+private:
+    typedef QVector<QVector<QVariant>> Rows;
+    typedef QPair<QVariant, QVariant> Key; // (sortKey, id)
+
+    void requestPage(int page) const;
+    void onPageLoaded(int gen, int page, const Rows &rows, const QStringList &names);
+    void evictFarPages();
+    void setTotalRows(int rows);
+    void requestCount();
+    QString pageSql(int page, QVariantList &args) const;
+
+    PagedQuerySpec spec;
+    int pageSize;
+    int maxResidentPages;
+    int totalRows = 0;
+    bool countKnown = false;      // totalRows 是精确行数；否则只是已读到的行数
+    QStringList headers;
+    QVector<SqlTime::Kind> timeKinds; // 按列名判断的时间列，显示时转成本地时间
+    int generation = 0;           // refresh() 后旧的请求结果直接丢弃
+
+    // data() 是 const，但会触发加载
+    mutable QHash<int, Rows> pages;
+    mutable QSet<int> inFlight;
+    mutable QHash<int, Key> pageStart; // 第 p 页之前的最后一个键；已知时用键集翻页，否则退回 OFFSET。
+                                       // 最多 4 * maxResidentPages 个，离当前位置最远的先丢
+    mutable int lastPage = 0;
+};
+
+#endif // PAGEDQUERYMODEL_H
@@ -0,0 +1,272 @@
+#include "passwordhasher.h"
+#include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QMessageAuthenticationCode>
+#include <QPointer>
+#include <QRandomGenerator>
+#include <QRunnable>
+#include <QStringList>
+#include <QThread>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+class FunctionRunnable : public QRunnable
+{
+public:
+    explicit FunctionRunnable(std::function<void()> f) : f(std::move(f)) {}
+    void run() override { f(); }
+private:
+    std::function<void()> f;
+};
+
+inline quint32 rotl(quint32 x, int n)
+{
+    return (x << n) | (x >> (32 - n));
+}
+
+// Salsa20/8 核心（RFC 7914 第 3 节）
+void salsa208(quint32 b[16])
+{
+    quint32 x[16];
+    memcpy(x, b, sizeof(x));
+    for (int i = 0; i < 8; i += 2) {
+        x[ 4] ^= rotl(x[ 0] + x[12],  7); x[ 8] ^= rotl(x[ 4] + x[ 0],  9);
+        x[12] ^= rotl(x[ 8] + x[ 4], 13); x[ 0] ^= rotl(x[12] + x[ 8], 18);
+        x[ 9] ^= rotl(x[ 5] + x[ 1],  7); x[13] ^= rotl(x[ 9] + x[ 5],  9);
+        x[ 1] ^= rotl(x[13] + x[ 9], 13); x[ 5] ^= rotl(x[ 1] + x[13], 18);
+        x[14] ^= rotl(x[10] + x[ 6],  7); x[ 2] ^= rotl(x[14] + x[10],  9);
+        x[ 6] ^= rotl(x[ 2] + x[14], 13); x[10] ^= rotl(x[ 6] + x[ 2], 18);
+        x[ 3] ^= rotl(x[15] + x[11],  7); x[ 7] ^= rotl(x[ 3] + x[15],  9);
+        x[11] ^= rotl(x[ 7] + x[ 3], 13); x[15] ^= rotl(x[11] + x[ 7], 18);
+        x[ 1] ^= rotl(x[ 0] + x[ 3],  7); x[ 2] ^= rotl(x[ 1] + x[ 0],  9);
+        x[ 3] ^= rotl(x[ 2] + x[ 1], 13); x[ 0] ^= rotl(x[ 3] + x[ 2], 18);
+        x[ 6] ^= rotl(x[ 5] + x[ 4],  7); x[ 7] ^= rotl(x[ 6] + x[ 5],  9);
+        x[ 4] ^= rotl(x[ 7] + x[ 6], 13); x[ 5] ^= rotl(x[ 4] + x[ 7], 18);
+        x[11] ^= rotl(x[10] + x[ 9],  7); x[ 8] ^= rotl(x[11] + x[10],  9);
+        x[ 9] ^= rotl(x[ 8] + x[11], 13); x[10] ^= rotl(x[ 9] + x[ 8], 18);
+        x[12] ^= rotl(x[15] + x[14],  7); x[13] ^= rotl(x[12] + x[15],  9);
+        x[14] ^= rotl(x[13] + x[12], 13); x[15] ^= rotl(x[14] + x[13], 18);
+    }
+    for (int i = 0; i < 16; ++i) b[i] += x[i];
+}
+
+// scryptBlockMix：b 为 2r 个 64 字节块，y 为同样大小的临时区
+void blockMix(quint32 *b, quint32 *y, int r)
+{
+    quint32 x[16];
+    memcpy(x, &b[(2 * r - 1) * 16], 64);
+    for (int i = 0; i < 2 * r; ++i) {
+        for (int k = 0; k < 16; ++k) x[k] ^= b[i * 16 + k];
+        salsa208(x);
+        // 偶数块放前半，奇数块放后半
+        memcpy(&y[((i & 1) * r + i / 2) * 16], x, 64);
+    }
+    memcpy(b, y, size_t(128) * r);
+}
+
+// scryptROMix：内存占用 128 * r * N 字节，这就是"内存困难"的来源
+void roMix(quint8 *block, int r, quint64 n)
+{
+    const size_t words = size_t(32) * r; // 128r 字节
+    std::vector<quint32> x(words), y(words), v(words * n);
+    for (size_t k = 0; k < words; ++k) {
+        const quint8 *p = block + 4 * k;
+        x[k] = quint32(p[0]) | (quint32(p[1]) << 8) | (quint32(p[2]) << 16) | (quint32(p[3]) << 24);
+    }
+    for (quint64 i = 0; i < n; ++i) {
+        memcpy(&v[i * words], x.data(), words * 4);
+        blockMix(x.data(), y.data(), r);
+    }
+    for (quint64 i = 0; i < n; ++i) {
+        const quint64 j = x[(2 * r - 1) * 16] & (n - 1); // Integerify
+        for (size_t k = 0; k < words; ++k) x[k] ^= v[j * words + k];
+        blockMix(x.data(), y.data(), r);
+    }
+    for (size_t k = 0; k < words; ++k) {
+        quint8 *p = block + 4 * k;
+        p[0] = quint8(x[k]); p[1] = quint8(x[k] >> 8); p[2] = quint8(x[k] >> 16); p[3] = quint8(x[k] >> 24);
+    }
+}
+
+// PBKDF2-HMAC-SHA256，scrypt 只需要迭代 1 次
+QByteArray pbkdf2Sha256(const QByteArray &password, const QByteArray &salt, int dkLen)
+{
+    QByteArray out;
+    out.reserve(dkLen + 32);
+    QMessageAuthenticationCode mac(QCryptographicHash::Sha256, password);
+    for (quint32 i = 1; out.size() < dkLen; ++i) {
+        mac.reset();
+        mac.addData(salt);
+        const char be[4] = { char(i >> 24), char(i >> 16), char(i >> 8), char(i) };
+        mac.addData(QByteArray(be, 4));
+        out += mac.result();
+    }
+    out.truncate(dkLen);
+    return out;
+}
+
+QByteArray scrypt(const QByteArray &password, const QByteArray &salt, int logN, int r, int p, int dkLen)
+{
+    QByteArray b = pbkdf2Sha256(password, salt, 128 * r * p);
+    for (int i = 0; i < p; ++i)
+        roMix(reinterpret_cast<quint8 *>(b.data()) + 128 * r * i, r, quint64(1) << logN);
+    return pbkdf2Sha256(password, b, dkLen);
+}
+
+// 比较时间与内容无关，避免按耗时猜出哈希前缀
+bool constantTimeEquals(const QByteArray &a, const QByteArray &b)
+{
+    if (a.size() != b.size()) return false;
+    quint8 diff = 0;
+    for (int i = 0; i < a.size(); ++i) diff |= quint8(a.at(i) ^ b.at(i));
+    return diff == 0;
+}
+
+const int kSaltBytes = 16;
+const int kHashBytes = 32;
+
+} // namespace
+
+PasswordHasher &PasswordHasher::instance()
+{
+    static PasswordHasher inst;
+    return inst;
+}
+
+PasswordHasher::PasswordHasher()
+{
+    pool.setMaxThreadCount(qMax(1, QThread::idealThreadCount()));
+}
+
+PasswordHasher::Params PasswordHasher::params() const
+{
+    QMutexLocker locker(&mutex);
+    return current;
+}
+
+void PasswordHasher::setParams(const Params &params)
+{
+    QMutexLocker locker(&mutex);
+    current = params;
+}
+
+bool PasswordHasher::isLegacyHash(const QString &stored)
+{
+    if (stored.size() != 64) return false;
+    for (QChar c : stored) {
+        if (!c.isDigit() && !(c >= 'a' && c <= 'f')) return false;
+    }
+    return true;
+}
+
+QString PasswordHasher::hashWith(const QString &plain, const Params &params, const QByteArray &salt)
+{
+    const QByteArray dk = scrypt(plain.toUtf8(), salt, params.logN, params.r, params.p, kHashBytes);
+    return QString("$scrypt$ln=%1,r=%2,p=%3$%4$%5")
+        .arg(params.logN).arg(params.r).arg(params.p)
+        .arg(QString::fromLatin1(salt.toBase64()), QString::fromLatin1(dk.toBase64()));
+}
+
+QString PasswordHasher::hash(const QString &plain) const
+{
+    QByteArray salt(kSaltBytes, Qt::Uninitialized);
+    for (int i = 0; i < kSaltBytes; ++i)
+        salt[i] = char(QRandomGenerator::system()->bounded(256));
+    return hashWith(plain, params(), salt);
+}
+
+PasswordHasher::VerifyResult PasswordHasher::verify(const QString &plain, const QString &stored) const
+{
+    VerifyResult v;
+    const Params now = params();
+
+    if (isLegacyHash(stored)) {
+        // 旧格式：无盐 SHA-256 十六进制
+        const QByteArray h = QCryptographicHash::hash(plain.toUtf8(), QCryptographicHash::Sha256).toHex();
+        v.ok = constantTimeEquals(h, stored.toLatin1());
+        if (v.ok) v.rehash = hash(plain);
+        return v;
+    }
+
+    // $scrypt$ln=14,r=8,p=1$salt$hash
+    const QStringList parts = stored.split('$');
+    if (parts.size() != 5 || parts.at(1) != "scrypt") {
+        qWarning() << "PasswordHasher: unknown hash format";
+        return v;
+    }
+    Params p;
+    p.logN = 0;
+    for (const QString &kv : parts.at(2).split(',')) {
+        const int eq = kv.indexOf('=');
+        const QString key = kv.left(eq);
+        const int value = kv.mid(eq + 1).toInt();
+        if (key == "ln") p.logN = value;
+        else if (key == "r") p.r = value;
+        else if (key == "p") p.p = value;
+    }
+    // 参数来自数据库，限制范围避免异常值导致耗尽内存
+    if (p.logN < 1 || p.logN > 24 || p.r < 1 || p.r > 32 || p.p < 1 || p.p > 16) {
+        qWarning() << "PasswordHasher: hash parameters out of range";
+        return v;
+    }
+    const QByteArray salt = QByteArray::fromBase64(parts.at(3).toLatin1());
+    const QByteArray expected = QByteArray::fromBase64(parts.at(4).toLatin1());
+    const QByteArray actual = scrypt(plain.toUtf8(), salt, p.logN, p.r, p.p, expected.size());
+    v.ok = !expected.isEmpty() && constantTimeEquals(actual, expected);
+    if (v.ok && (p.logN != now.logN || p.r != now.r || p.p != now.p)) v.rehash = hash(plain);
+    return v;
+}
+
+// 回调投递到主线程执行（PasswordHasher 本身不是 QObject）。guard 只能在主线程里检查：
+// 线程池里读 QPointer 与 context 在主线程被删除之间有竞争
+void PasswordHasher::hashAsync(const QString &plain, QObject *context, std::function<void(QString)> done)
+{
+    QPointer<QObject> guard(context);
+    pool.start(new FunctionRunnable([this, plain, guard, done]() {
+        const QString h = hash(plain);
+        QMetaObject::invokeMethod(QCoreApplication::instance(), [guard, done, h]() {
+            if (guard) done(h);
+        }, Qt::QueuedConnection);
+    }));
+}
+
+void PasswordHasher::verifyAsync(const QString &plain, const QString &stored, QObject *context,
+                                 std::function<void(VerifyResult)> done)
+{
+    QPointer<QObject> guard(context);
+    pool.start(new FunctionRunnable([this, plain, stored, guard, done]() {
+        const VerifyResult v = verify(plain, stored);
+        QMetaObject::invokeMethod(QCoreApplication::instance(), [guard, done, v]() {
+            if (guard) done(v);
+        }, Qt::QueuedConnection);
+    }));
+}
+
+PasswordHasher::Params PasswordHasher::calibrate(int targetMs, const Params &base, double *measuredMs)
+{
+    const QByteArray salt(kSaltBytes, 'x');
+    auto timeMs = [&](int logN) {
+        QElapsedTimer t;
+        t.start();
+        scrypt("calibration", salt, logN, base.r, base.p, kHashBytes);
+        return double(t.nsecsElapsed()) / 1e6;
+    };
+
+    // 耗时与 N 成正比：先用小的 N 测一次，按比例推算，再实测确认
+    Params p = base;
+    const int probe = 12;
+    const double probeMs = qMax(0.01, timeMs(probe));
+    p.logN = qBound(10, probe + int(std::lround(std::log2(targetMs / probeMs))), 22);
+    double ms = timeMs(p.logN);
+    if (ms > targetMs * 1.5 && p.logN > 10) {
+        --p.logN;
+        ms = timeMs(p.logN);
+    }
+    if (measuredMs) *measuredMs = ms;
+    return p;
+}
@@ -0,0 +1,56 @@
+#ifndef PASSWORDHASHER_H
+#define PASSWORDHASHER_H
+
+#include <QMutex>
+#include <QObject>
+#include <QString>
+#include <QThreadPool>
+#include <functional>
+
+// 密码哈希：scrypt（加盐、内存困难），格式自描述：
+//   $scrypt$ln=<log2 N>,r=<r>,p=<p>$<salt base64>$<hash base64>
+// 旧数据里的 64 位十六进制串是无盐 SHA-256，仍然可以验证，验证通过后应当重新哈希。
+// 一次哈希按默认参数约占 16MiB 内存、几十毫秒，所以放在独立的有界线程池里算，不占 UI 线程和数据库线程。
+class PasswordHasher
+{
+public:
+    struct Params {
+        int logN = 14;  // N = 2^logN
+        int r = 8;
+        int p = 1;
+    };
+
+    struct VerifyResult {
+        bool ok = false;
+        QString rehash; // 非空表示存储的哈希已过时（旧 SHA-256 或参数变了），应当替换成它
+    };
+
+    static PasswordHasher &instance();
+
+    Params params() const;
+    void setParams(const Params &params);
+
+    // 同步接口：在调用线程里计算
+    QString hash(const QString &plain) const;
+    VerifyResult verify(const QString &plain, const QString &stored) const;
+
+    // 异步接口：在哈希线程池里计算，完成后在主线程回调（context 被销毁则不回调）。context 须属于主线程
+    void hashAsync(const QString &plain, QObject *context, std::function<void(QString)> done);
+    void verifyAsync(const QString &plain, const QString &stored, QObject *context,
+                     std::function<void(VerifyResult)> done);
+
+    // 基准模式：在本机上测出耗时最接近 targetMs 的 logN（r、p 不变），measuredMs 返回实测耗时
+    static Params calibrate(int targetMs, const Params &base = Params(), double *measuredMs = nullptr);
+
+    static bool isLegacyHash(const QString &stored);
+
+private:
+    PasswordHasher();
+    static QString hashWith(const QString &plain, const Params &params, const QByteArray &salt);
+
+    mutable QMutex mutex;
+    Params current;
+    QThreadPool pool;
+};
+
+#endif // PASSWORDHASHER_H
@@ -0,0 +1,268 @@
+#include "querystats.h"
+#include <QDebug>
+#include <QHash>
+#include <QMutex>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QStringList>
+#include <QtAlgorithms>
+#include <algorithm>
+#include <unordered_map>
+
+// 开启后每条语句都要拿一次全局锁，所有数据库线程在这里排队，所以发布构建默认关闭
+#ifdef QT_DEBUG
+std::atomic<bool> QueryStats::on{true};
+#else
+std::atomic<bool> QueryStats::on{false};
+#endif
+
+namespace {
+// 对数分桶：每个 2 的幂区间再分 8 份。小于 8ns 的值各占一个桶
+class LatencyHistogram
+{
+public:
+    static const int kSubBits = 3;
+    static const int kSub = 1 << kSubBits;
+    static const int kBuckets = (64 - kSubBits + 1) * kSub;
+
+    void add(qint64 ns)
+    {
+        const quint64 v = quint64(qMax<qint64>(0, ns));
+        ++buckets[bucketFor(v)];
+        ++count;
+        maxNs = qMax(maxNs, qint64(v));
+    }
+
+    void merge(const LatencyHistogram &other)
+    {
+        for (int i = 0; i < kBuckets; ++i) buckets[i] += other.buckets[i];
+        count += other.count;
+        maxNs = qMax(maxNs, other.maxNs);
+    }
+
+    // 返回所在桶的上界（不超过实际最大值）
+    qint64 percentile(double p) const
+    {
+        if (count == 0) return 0;
+        const quint64 target = qMax<quint64>(1, quint64(p * double(count) + 0.999999));
+        quint64 seen = 0;
+        for (int i = 0; i < kBuckets; ++i) {
+            seen += buckets[i];
+            if (seen >= target) return qMin(qint64(upperBound(i)), maxNs);
+        }
+        return maxNs;
+    }
+
+    quint64 count = 0;
+    qint64 maxNs = 0;
+
+private:
+    static int bucketFor(quint64 v)
+    {
+        if (v < quint64(kSub)) return int(v);
+        const int msb = 63 - int(qCountLeadingZeroBits(v));
+        const int sub = int((v >> (msb - kSubBits)) & (kSub - 1));
+        return (msb - kSubBits + 1) * kSub + sub;
+    }
+
+    static quint64 upperBound(int bucket)
+    {
+        if (bucket < kSub) return quint64(bucket);
+        const int msb = bucket / kSub + kSubBits - 1;
+        const quint64 sub = quint64(bucket % kSub);
+        const quint64 width = quint64(1) << (msb - kSubBits);
+        return ((quint64(kSub) + sub) << (msb - kSubBits)) + width - 1;
+    }
+
+    quint64 buckets[kBuckets] = {};
+};
+
+struct Entry {
+    quint64 errors = 0;
+    quint64 busy = 0;
+    qint64 rows = 0;
+    qint64 totalNs = 0;
+    LatencyHistogram hist;
+};
+
+QMutex g_mutex;
+std::unordered_map<const char *, Entry> g_entries; // key 是标签字面量的地址
+QVector<QueryStats::SlowQuery> g_slow;             // 环形：g_slowNext 是下一个写入位置
+int g_slowNext = 0;
+int g_slowCapacity = 200;
+std::atomic<qint64> g_slowThresholdNs{100LL * 1000 * 1000};
+
+QString shapeOf(const QVariant &v)
+{
+    if (v.isNull()) return "NULL";
+    switch (v.userType()) {
+    case QMetaType::QString: return QString("text(%1)").arg(v.toString().size());
+    case QMetaType::QByteArray: return QString("blob(%1)").arg(v.toByteArray().size());
+    case QMetaType::Int:
+    case QMetaType::UInt:
+    case QMetaType::LongLong:
+    case QMetaType::ULongLong:
+    case QMetaType::Bool:
+        return "int";
+    case QMetaType::Double: return "real";
+    default: return QString::fromLatin1(v.typeName());
+    }
+}
+
+QString paramShapes(const QSqlQuery &q)
+{
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+    const QVariantList values = q.boundValues();
+#else
+    const QVariantList values = q.boundValues().values();
+#endif
+    QStringList shapes;
+    for (const QVariant &v : values) shapes << shapeOf(v);
+    return shapes.join(", ");
+}
+}
+
+void QueryStats::setEnabled(bool enabled)
+{
+    on.store(enabled, std::memory_order_relaxed);
+}
+
+void QueryStats::setSlowThresholdMs(double ms)
+{
+    g_slowThresholdNs.store(ms > 0 ? qint64(ms * 1e6) : 0, std::memory_order_relaxed);
+}
+
+void QueryStats::setSlowLogCapacity(int entries)
+{
+    QMutexLocker lock(&g_mutex);
+    g_slowCapacity = qMax(1, entries);
+    g_slow.clear();
+    g_slowNext = 0;
+}
+
+bool QueryStats::isBusyError(const QSqlError &error)
+{
+    // SQLITE_BUSY = 5，SQLITE_LOCKED = 6（扩展错误码的低 8 位）
+    bool ok = false;
+    const int code = error.nativeErrorCode().toInt(&ok);
+    if (ok && ((code & 0xff) == 5 || (code & 0xff) == 6)) return true;
+    return error.databaseText().contains("database is locked") || error.databaseText().contains("database table is locked");
+}
+
+void QueryStats::record(const char *label, qint64 elapsedNs, qint64 rows, bool ok, bool busy, const QSqlQuery &q)
+{
+    const qint64 threshold = g_slowThresholdNs.load(std::memory_order_relaxed);
+    const bool slow = threshold > 0 && elapsedNs >= threshold;
+    SlowQuery s;
+    if (slow) {
+        // 格式化放在锁外
+        s.label = QString::fromUtf8(label);
+        s.sql = q.lastQuery().simplified().left(200);
+        s.params = paramShapes(q);
+        s.elapsedNs = elapsedNs;
+        s.rows = rows;
+        s.at = QDateTime::currentDateTime();
+        qWarning().noquote() << QString("slow query [%1] %2 ms, params (%3): %4")
+                                    .arg(s.label).arg(elapsedNs / 1e6, 0, 'f', 1).arg(s.params, s.sql);
+    }
+
+    QMutexLocker lock(&g_mutex);
+    Entry &e = g_entries[label];
+    e.hist.add(elapsedNs);
+    e.totalNs += elapsedNs;
+    if (rows > 0) e.rows += rows;
+    if (!ok) ++e.errors;
+    if (busy) ++e.busy;
+    if (slow) {
+        if (g_slow.size() < g_slowCapacity) {
+            g_slow.append(s);
+        } else {
+            g_slow[g_slowNext] = s;
+        }
+        g_slowNext = (g_slowNext + 1) % g_slowCapacity;
+    }
+}
+
+void QueryStats::addRowsSlow(const char *label, qint64 rows)
+{
+    QMutexLocker lock(&g_mutex);
+    g_entries[label].rows += rows;
+}
+
+QVector<QueryStats::LabelStats> QueryStats::snapshot()
+{
+    // 同名标签（不同编译单元的字面量地址可能不同）合并
+    QHash<QString, Entry> merged;
+    {
+        QMutexLocker lock(&g_mutex);
+        for (const auto &kv : g_entries) {
+            Entry &m = merged[QString::fromUtf8(kv.first)];
+            m.errors += kv.second.errors;
+            m.busy += kv.second.busy;
+            m.rows += kv.second.rows;
+            m.totalNs += kv.second.totalNs;
+            m.hist.merge(kv.second.hist);
+        }
+    }
+    QVector<LabelStats> out;
+    out.reserve(merged.size());
+    for (auto it = merged.constBegin(); it != merged.constEnd(); ++it) {
+        LabelStats s;
+        s.label = it.key();
+        s.count = it->hist.count;
+        s.errors = it->errors;
+        s.busy = it->busy;
+        s.rows = it->rows;
+        s.totalNs = it->totalNs;
+        s.p50Ns = it->hist.percentile(0.50);
+        s.p99Ns = it->hist.percentile(0.99);
+        s.maxNs = it->hist.maxNs;
+        out.append(s);
+    }
+    std::sort(out.begin(), out.end(), [](const LabelStats &a, const LabelStats &b) { return a.totalNs > b.totalNs; });
+    return out;
+}
+
+QVector<QueryStats::SlowQuery> QueryStats::slowQueries()
+{
+    QMutexLocker lock(&g_mutex);
+    if (g_slow.size() < g_slowCapacity) return g_slow;
+    QVector<SlowQuery> out;
+    out.reserve(g_slow.size());
+    for (int i = 0; i < g_slow.size(); ++i) out.append(g_slow.at((g_slowNext + i) % g_slow.size()));
+    return out;
+}
+
+QString QueryStats::dump()
+{
+    auto us = [](qint64 ns) { return QString::number(ns / 1000.0, 'f', 1); };
+    QStringList lines;
+    lines << QString("%1 %2 %3 %4 %5 %6 %7 %8 %9")
+                 .arg(QString("label"), -32).arg(QString("count"), 9).arg(QString("rows"), 10)
+                 .arg(QString("err"), 5).arg(QString("busy"), 5).arg(QString("p50(us)"), 10)
+                 .arg(QString("p99(us)"), 10).arg(QString("max(us)"), 10).arg(QString("total(ms)"), 10);
+    for (const LabelStats &s : snapshot()) {
+        lines << QString("%1 %2 %3 %4 %5 %6 %7 %8 %9")
+                     .arg(s.label, -32).arg(s.count, 9).arg(s.rows, 10).arg(s.errors, 5).arg(s.busy, 5)
+                     .arg(us(s.p50Ns), 10).arg(us(s.p99Ns), 10).arg(us(s.maxNs), 10)
+                     .arg(QString::number(s.totalNs / 1e6, 'f', 1), 10);
+    }
+    const QVector<SlowQuery> slow = slowQueries();
+    if (!slow.isEmpty()) {
+        lines << QString() << QString("slow queries (%1):").arg(slow.size());
+        for (const SlowQuery &s : slow) {
+            lines << QString("%1 [%2] %3 ms rows=%4 params (%5): %6")
+                         .arg(s.at.toString(Qt::ISODate), s.label)
+                         .arg(s.elapsedNs / 1e6, 0, 'f', 1).arg(s.rows).arg(s.params, s.sql);
+        }
+    }
+    return lines.join('\n');
+}
+
+void QueryStats::reset()
+{
+    QMutexLocker lock(&g_mutex);
+    g_entries.clear();
+    g_slow.clear();
+    g_slowNext = 0;
+}
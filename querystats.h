@@ -0,0 +1,71 @@
+#ifndef QUERYSTATS_H
+#define QUERYSTATS_H
+
+#include <QDateTime>
+#include <QString>
+#include <QVector>
+#include <atomic>
+#include <chrono>
+
+class QSqlError;
+class QSqlQuery;
+
+// Database 执行语句的耗时统计：按语句标签分别记次数、行数、出错和 SQLITE_BUSY 次数、
+// 延迟分布（对数分桶，误差约 12%），超过阈值的语句记入慢查询日志（只记参数的类型和长度，不记值）。
+// 全进程共用，开启时每条语句要拿一次全局锁；关闭时每条语句只多一次原子读，慢查询日志也不记。
+// 标签 "begin" 是 BEGIN IMMEDIATE 的耗时，也就是等写锁的时间
+class QueryStats
+{
+public:
+    struct LabelStats {
+        QString label;
+        quint64 count = 0;
+        quint64 errors = 0;
+        quint64 busy = 0;      // SQLITE_BUSY / SQLITE_LOCKED（busy_timeout 用完仍拿不到锁）
+        qint64 rows = 0;       // 写：影响的行数；读：读到的行数
+        qint64 totalNs = 0;
+        qint64 p50Ns = 0;
+        qint64 p99Ns = 0;
+        qint64 maxNs = 0;
+    };
+
+    struct SlowQuery {
+        QString label;
+        QString sql;           // 截断到 200 字符
+        QString params;        // 例如 "text(11), int, NULL"
+        qint64 elapsedNs = 0;
+        qint64 rows = -1;
+        QDateTime at;
+    };
+
+    static bool enabled() { return on.load(std::memory_order_relaxed); }
+    static void setEnabled(bool enabled);               // 默认只在调试构建开启；dbbench 会打开
+    static void setSlowThresholdMs(double ms);          // 默认 100ms，<= 0 关闭慢查询日志
+    static void setSlowLogCapacity(int entries);        // 默认保留最近 200 条
+
+    static qint64 nowNs()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+    static bool isBusyError(const QSqlError &error);
+
+    // 由 Database 调用。label 必须是字符串字面量
+    static void record(const char *label, qint64 elapsedNs, qint64 rows, bool ok, bool busy, const QSqlQuery &q);
+    static void addRows(const char *label, qint64 rows)
+    {
+        if (enabled()) addRowsSlow(label, rows);
+    }
+
+    // 查询 / 导出
+    static QVector<LabelStats> snapshot();   // 按总耗时降序
+    static QVector<SlowQuery> slowQueries(); // 按时间先后
+    static QString dump();                   // 文本表格，方便直接打到日志里
+    static void reset();
+
+private:
+    static void addRowsSlow(const char *label, qint64 rows);
+    static std::atomic<bool> on;
+};
+
+#endif // QUERYSTATS_H
@@ -0,0 +1,173 @@
+#include "recordcache.h"
+
+namespace {
+QMutex g_optionsMutex;
+RecordCache::Options g_options;
+
+// 条目的大致内存占用：结构体 + 字符串内容（UTF-16）+ 链表和哈希节点
+const qint64 kNodeOverhead = 64;
+
+qint64 strings(std::initializer_list<const QString *> list)
+{
+    qint64 n = 0;
+    for (const QString *s : list) n += s->size() * qint64(sizeof(QChar));
+    return n;
+}
+
+qint64 costOf(const UserRecord &u)
+{
+    return qint64(sizeof(UserRecord)) + kNodeOverhead
+         + strings({ &u.username, &u.username, &u.email, &u.passwordHash, &u.role }); // 用户名也是键
+}
+
+qint64 costOf(const PatientRecord &p)
+{
+    return qint64(sizeof(PatientRecord)) + kNodeOverhead
+         + strings({ &p.fullName, &p.idNumber, &p.phone, &p.post, &p.gender });
+}
+
+qint64 costOf(const DoctorRecord &d)
+{
+    return qint64(sizeof(DoctorRecord)) + kNodeOverhead
+         + strings({ &d.fullName, &d.phone, &d.specialty, &d.licenseNumber, &d.clinicAddress });
+}
+}
+
+void RecordCache::setOptions(const Options &options)
+{
+    QMutexLocker lock(&g_optionsMutex);
+    g_options = options;
+}
+
+RecordCache &RecordCache::instance()
+{
+    static RecordCache inst;
+    return inst;
+}
+
+RecordCache::RecordCache()
+{
+    Options opts;
+    {
+        QMutexLocker lock(&g_optionsMutex);
+        opts = g_options;
+    }
+    users.setMaxCost(qMax(0, opts.userCacheKiB) * 1024LL);
+    patients.setMaxCost(qMax(0, opts.patientCacheKiB) * 1024LL);
+    doctors.setMaxCost(qMax(0, opts.doctorCacheKiB) * 1024LL);
+    // 在 users 的淘汰回调里调用，此时已持有 mutex
+    users.setEvictionCallback([this](const QString &, const UserRecord &u) { userNames.remove(u.id); });
+}
+
+quint64 RecordCache::generation() const
+{
+    QMutexLocker lock(&mutex);
+    return gen;
+}
+
+bool RecordCache::findUser(const QString &username, UserRecord &out)
+{
+    QMutexLocker lock(&mutex);
+    const bool hit = users.get(username, out);
+    if (hit) ++counters.users.hits;
+    else ++counters.users.misses;
+    return hit;
+}
+
+bool RecordCache::findPatient(int patientId, PatientRecord &out)
+{
+    QMutexLocker lock(&mutex);
+    const bool hit = patients.get(patientId, out);
+    if (hit) ++counters.patients.hits;
+    else ++counters.patients.misses;
+    return hit;
+}
+
+bool RecordCache::findDoctor(int doctorId, DoctorRecord &out)
+{
+    QMutexLocker lock(&mutex);
+    const bool hit = doctors.get(doctorId, out);
+    if (hit) ++counters.doctors.hits;
+    else ++counters.doctors.misses;
+    return hit;
+}
+
+void RecordCache::putUser(const UserRecord &u, quint64 generation)
+{
+    QMutexLocker lock(&mutex);
+    if (generation != gen) {
+        ++counters.stalePuts;
+        return;
+    }
+    // 同一个 id 换了用户名（理论上不会）时先去掉旧键
+    auto it = userNames.constFind(u.id);
+    if (it != userNames.constEnd() && it.value() != u.username) users.remove(it.value());
+    if (users.put(u.username, u, costOf(u))) userNames.insert(u.id, u.username);
+}
+
+void RecordCache::putPatient(const PatientRecord &p, quint64 generation)
+{
+    QMutexLocker lock(&mutex);
+    if (generation != gen) {
+        ++counters.stalePuts;
+        return;
+    }
+    patients.put(p.id, p, costOf(p));
+}
+
+void RecordCache::putDoctor(const DoctorRecord &d, quint64 generation)
+{
+    QMutexLocker lock(&mutex);
+    if (generation != gen) {
+        ++counters.stalePuts;
+        return;
+    }
+    doctors.put(d.id, d, costOf(d));
+}
+
+void RecordCache::invalidate(const Invalidation &inv)
+{
+    if (inv.isEmpty()) return;
+    QMutexLocker lock(&mutex);
+    ++gen;
+    ++counters.invalidations;
+    for (const QString &name : inv.usernames) {
+        UserRecord u;
+        if (users.remove(name, &u)) userNames.remove(u.id);
+    }
+    for (int id : inv.userIds) {
+        auto it = userNames.find(id);
+        if (it == userNames.end()) continue;
+        users.remove(it.value());
+        userNames.erase(it);
+    }
+    for (int id : inv.patientIds) patients.remove(id);
+    for (int id : inv.doctorIds) doctors.remove(id);
+}
+
+void RecordCache::invalidateAll()
+{
+    QMutexLocker lock(&mutex);
+    ++gen;
+    ++counters.invalidations;
+    users.clear();
+    userNames.clear();
+    patients.clear();
+    doctors.clear();
+}
+
+RecordCache::Stats RecordCache::stats() const
+{
+    QMutexLocker lock(&mutex);
+    Stats s = counters;
+    s.users.evictions = users.evictions();
+    s.users.entries = users.size();
+    s.users.bytes = users.totalCost();
+    s.patients.evictions = patients.evictions();
+    s.patients.entries = patients.size();
+    s.patients.bytes = patients.totalCost();
+    s.doctors.evictions = doctors.evictions();
+    s.doctors.entries = doctors.size();
+    s.doctors.bytes = doctors.totalCost();
+    return s;
+}
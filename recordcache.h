@@ -0,0 +1,82 @@
+#ifndef RECORDCACHE_H
+#define RECORDCACHE_H
+
+#include "lrucache.h"
+#include "records.h"
+#include <QMutex>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+// 进程内的只读缓存：用户（按用户名，登录用）、患者和医生（按 id，显示姓名电话用）。
+// 所有线程共享一份，每类按估算的内存大小限量，LRU 淘汰。
+//
+// 写路径（Database 的 insertUser / updatePasswordHash / insertDoctor / updatePatient / deletePatient 等）
+// 在提交之后调用 invalidate()。为了不把提交前读到的旧值放回缓存，读的一方先取 generation()，
+// 读完数据库再 put() 时带上它：期间发生过失效就不放。
+// 别的进程写库不会通知这里，多进程共用一个库时把 Options 的上限设为 0 关闭缓存
+class RecordCache
+{
+public:
+    struct Options {
+        int userCacheKiB = 4 * 1024;
+        int patientCacheKiB = 4 * 1024;
+        int doctorCacheKiB = 1024;
+    };
+    // 要在第一次 instance() 之前设置
+    static void setOptions(const Options &options);
+
+    static RecordCache &instance();
+    RecordCache(const RecordCache &) = delete;
+    RecordCache &operator=(const RecordCache &) = delete;
+
+    quint64 generation() const;
+
+    bool findUser(const QString &username, UserRecord &out);
+    bool findPatient(int patientId, PatientRecord &out);
+    bool findDoctor(int doctorId, DoctorRecord &out);
+    void putUser(const UserRecord &u, quint64 generation);
+    void putPatient(const PatientRecord &p, quint64 generation);
+    void putDoctor(const DoctorRecord &d, quint64 generation);
+
+    // 一次写操作要失效的条目，事务里攒着，提交后一起生效
+    struct Invalidation {
+        QStringList usernames;
+        QVector<int> userIds;
+        QVector<int> patientIds;
+        QVector<int> doctorIds;
+        bool isEmpty() const { return usernames.isEmpty() && userIds.isEmpty() && patientIds.isEmpty() && doctorIds.isEmpty(); }
+        void clear() { *this = Invalidation(); }
+    };
+    void invalidate(const Invalidation &inv);
+    void invalidateAll();
+
+    struct Stats {
+        struct Kind {
+            quint64 hits = 0;
+            quint64 misses = 0;
+            quint64 evictions = 0;
+            int entries = 0;
+            qint64 bytes = 0;
+        };
+        Kind users;
+        Kind patients;
+        Kind doctors;
+        quint64 invalidations = 0;
+        quint64 stalePuts = 0; // 读的期间发生失效、没有放进缓存的次数
+    };
+    Stats stats() const;
+
+private:
+    RecordCache();
+
+    mutable QMutex mutex;
+    LruCache<QString, UserRecord> users;
+    LruCache<int, PatientRecord> patients;
+    LruCache<int, DoctorRecord> doctors;
+    QHash<int, QString> userNames; // 用户 id -> 用户名，按 id 失效用；随 users 的淘汰一起删
+    quint64 gen = 0;
+    Stats counters; // evictions / entries / bytes 在 stats() 里从缓存取
+};
+
+#endif // RECORDCACHE_H
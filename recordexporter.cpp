@@ -0,0 +1,387 @@
+#include "recordexporter.h"
+#include "database.h"
+#include <QCoreApplication>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QPointer>
+#include <QSaveFile>
+#include <QThread>
+#include <memory>
+#include <vector>
+#if defined(Q_OS_WIN)
+#include <windows.h>
+#include <psapi.h>
+#elif defined(Q_OS_UNIX)
+#include <sys/resource.h>
+#endif
+
+namespace {
+// 攒满 capacity 字节才真正写文件；写到 QSaveFile，成功 commit() 后才替换目标文件，
+// 中途失败或取消不会留下半个文件。finish() 只把缓冲写完，commit() 由调用方在所有文件都写完后再调用
+class BufferedWriter
+{
+public:
+    BufferedWriter(const QString &path, int capacity) : file(path), capacity(qMax(4096, capacity))
+    {
+        buf.reserve(this->capacity + 4096);
+    }
+
+    bool open()
+    {
+        if (file.open(QIODevice::WriteOnly)) return true;
+        qWarning() << "RecordExporter: cannot open" << file.fileName() << file.errorString();
+        return false;
+    }
+
+    QByteArray &buffer() { return buf; }
+
+    // 每行写完调用一次
+    bool rowDone()
+    {
+        return buf.size() < capacity || flush();
+    }
+
+    bool flush()
+    {
+        if (buf.isEmpty()) return true;
+        if (file.write(buf) != buf.size()) {
+            qWarning() << "RecordExporter: write error" << file.fileName() << file.errorString();
+            return false;
+        }
+        written += buf.size();
+        buf.clear();
+        buf.reserve(capacity + 4096);
+        return true;
+    }
+
+    // 写完这个文件：剩下的缓冲写进临时文件并释放，还不替换目标文件
+    bool finish()
+    {
+        const bool ok = flush();
+        buf = QByteArray();
+        return ok;
+    }
+
+    bool commit()
+    {
+        if (!flush()) {
+            file.cancelWriting();
+            file.commit();
+            return false;
+        }
+        return file.commit();
+    }
+
+    void discard()
+    {
+        file.cancelWriting();
+        file.commit();
+    }
+
+    qint64 bytes() const { return written + buf.size(); }
+    QString fileName() const { return file.fileName(); }
+
+private:
+    QSaveFile file;
+    QByteArray buf;
+    const int capacity;
+    qint64 written = 0;
+};
+
+bool isNumber(const QVariant &v)
+{
+    switch (v.userType()) {
+    case QMetaType::Int:
+    case QMetaType::UInt:
+    case QMetaType::LongLong:
+    case QMetaType::ULongLong:
+    case QMetaType::Double:
+        return true;
+    default:
+        return false;
+    }
+}
+
+void appendJsonString(QByteArray &out, const QString &s)
+{
+    static const char hex[] = "0123456789abcdef";
+    const QByteArray utf8 = s.toUtf8();
+    out += '"';
+    for (char ch : utf8) {
+        const uchar c = uchar(ch);
+        switch (c) {
+        case '"': out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\n': out += "\\n"; break;
+        case '\r': out += "\\r"; break;
+        case '\t': out += "\\t"; break;
+        default:
+            if (c < 0x20) {
+                out += "\\u00";
+                out += hex[c >> 4];
+                out += hex[c & 0xf];
+            } else {
+                out += ch;
+            }
+        }
+    }
+    out += '"';
+}
+
+void appendJsonValue(QByteArray &out, const QVariant &v)
+{
+    if (v.isNull()) out += "null";
+    else if (isNumber(v)) out += v.toString().toUtf8();
+    else appendJsonString(out, v.toString());
+}
+
+void appendCsvField(QByteArray &out, const QString &s)
+{
+    const QByteArray utf8 = s.toUtf8();
+    const bool quote = utf8.contains(',') || utf8.contains('"') || utf8.contains('\n') || utf8.contains('\r');
+    if (!quote) {
+        out += utf8;
+        return;
+    }
+    out += '"';
+    for (char ch : utf8) {
+        if (ch == '"') out += '"';
+        out += ch;
+    }
+    out += '"';
+}
+}
+
+RecordExporter::RecordExporter(const Options &options)
+    : opts(options)
+{
+}
+
+QString RecordExporter::datasetName(Dataset dataset)
+{
+    switch (dataset) {
+    case MedicalCases: return "medical_cases";
+    case Diagnoses: return "diagnoses";
+    case MedicalOrders: return "medical_orders";
+    case Prescriptions: return "prescriptions";
+    }
+    return QString();
+}
+
+QString RecordExporter::outputFor(Dataset dataset) const
+{
+    if (opts.format == JsonLines || opts.datasets.size() == 1) return opts.outputPath;
+    const QFileInfo info(opts.outputPath);
+    return info.path() + "/" + info.completeBaseName() + "_" + datasetName(dataset) + ".csv";
+}
+
+// 库里的时间是 Unix 秒，导出成 ISO 8601（UTC）
+static QString isoColumn(const char *column)
+{
+    return QString("strftime('%Y-%m-%dT%H:%M:%SZ', x.%1, 'unixepoch') AS %1").arg(QLatin1String(column));
+}
+
+// 只有列和时间列不同；按患者导出时走 (patient_id, 时间) 索引，不需要排序
+QString RecordExporter::sqlFor(Dataset dataset) const
+{
+    QString columns;
+    QString doctorColumn = "doctor_id";
+    QString timeColumn = "created_at";
+    switch (dataset) {
+    case MedicalCases:
+        columns = "x.created_by_doctor_id AS doctor_id, d.full_name AS doctor_name, "
+                  "x.title, x.description, x.attachments, " + isoColumn("created_at");
+        doctorColumn = "created_by_doctor_id";
+        break;
+    case Diagnoses:
+        columns = "x.doctor_id, d.full_name AS doctor_name, "
+                  "x.case_id, x.appointment_id, x.diagnosis_text, x.icd_codes, " + isoColumn("created_at");
+        break;
+    case MedicalOrders:
+        columns = "x.doctor_id, d.full_name AS doctor_name, "
+                  "x.diagnosis_id, x.order_text, x.order_type, x.status, " + isoColumn("created_at");
+        break;
+    case Prescriptions:
+        columns = "x.doctor_id, d.full_name AS doctor_name, "
+                  "x.diagnosis_id, x.medication_name, x.dosage, x.frequency, x.duration, x.notes, " + isoColumn("issued_at");
+        timeColumn = "issued_at";
+        break;
+    }
+    QString sql = QString("SELECT x.id, x.patient_id, p.full_name AS patient_name, %1 FROM %2 x "
+                          "LEFT JOIN patients p ON p.id = x.patient_id "
+                          "LEFT JOIN doctors d ON d.id = x.%3")
+                      .arg(columns, datasetName(dataset), doctorColumn);
+    if (opts.patientId > 0)
+        sql += QString(" WHERE x.patient_id = ? ORDER BY x.%1, x.id").arg(timeColumn);
+    else
+        sql += " ORDER BY x.id";
+    return sql;
+}
+
+qint64 RecordExporter::peakRssKiB()
+{
+#if defined(Q_OS_WIN)
+    PROCESS_MEMORY_COUNTERS pmc;
+    if (K32GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc))) return qint64(pmc.PeakWorkingSetSize / 1024);
+    return 0;
+#elif defined(Q_OS_UNIX)
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#if defined(Q_OS_MACOS)
+    return qint64(usage.ru_maxrss / 1024); // macOS 单位是字节
+#else
+    return qint64(usage.ru_maxrss);        // Linux 单位是 KiB
+#endif
+#else
+    return 0;
+#endif
+}
+
+RecordExporter::Report RecordExporter::run(std::function<void(const Report &)> onProgress)
+{
+    Report report;
+    if (opts.datasets.isEmpty()) return report;
+    QElapsedTimer timer;
+    timer.start();
+    Database &db = Database::instance();
+
+    QVariantList args;
+    if (opts.patientId > 0) args << opts.patientId;
+    const bool csv = opts.format == Csv;
+    const qint64 progressEvery = qMax<qint64>(1, opts.progressEvery);
+    qint64 bytesBefore = 0; // 已关闭的文件的字节数
+
+    auto updateTiming = [&](const BufferedWriter *writer) {
+        report.bytes = bytesBefore + (writer ? writer->bytes() : 0);
+        report.elapsedMs = timer.elapsed();
+        const double secs = qMax<qint64>(1, report.elapsedMs) / 1000.0;
+        report.rowsPerSec = report.rows / secs;
+        report.mibPerSec = report.bytes / (1024.0 * 1024.0) / secs;
+    };
+
+    std::vector<std::unique_ptr<BufferedWriter>> writers; // 所有数据集都写完才一起提交
+    BufferedWriter *writer = nullptr;
+    for (int i = 0; i < opts.datasets.size() && report.error.isEmpty() && !cancelled; ++i) {
+        const Dataset dataset = opts.datasets.at(i);
+        if (!writer) {
+            const QString path = outputFor(dataset);
+            writers.emplace_back(new BufferedWriter(path, opts.bufferBytes));
+            writer = writers.back().get();
+            if (!writer->open()) {
+                report.error = QString("cannot open %1").arg(path);
+                break;
+            }
+            if (csv) writer->buffer() += "\xEF\xBB\xBF"; // BOM，Excel 才能认出 UTF-8
+            report.files << path;
+        }
+
+        // JSONL 每行的固定前缀 {"record_type":"...",
+        QByteArray prefix = "{\"record_type\":\"" + datasetName(dataset).toUtf8() + "\"";
+        QStringList names;
+        QVector<QByteArray> jsonKeys;
+        bool headerDone = false;
+        auto writeHeader = [&]() {
+            headerDone = true;
+            if (csv) {
+                QByteArray &out = writer->buffer();
+                for (int c = 0; c < names.size(); ++c) {
+                    if (c > 0) out += ',';
+                    appendCsvField(out, names.at(c));
+                }
+                out += "\r\n";
+            } else {
+                for (const QString &name : names) {
+                    QByteArray key = ",";
+                    appendJsonString(key, name);
+                    jsonKeys << key + ':';
+                }
+            }
+        };
+        bool writeFailed = false;
+        const bool ok = db.streamRows(sqlFor(dataset), args, [&](const QSqlQuery &q) {
+            if (!headerDone) writeHeader();
+            QByteArray &out = writer->buffer();
+            if (csv) {
+                for (int c = 0; c < names.size(); ++c) {
+                    if (c > 0) out += ',';
+                    const QVariant v = q.value(c);
+                    if (!v.isNull()) appendCsvField(out, v.toString());
+                }
+                out += "\r\n";
+            } else {
+                out += prefix;
+                for (int c = 0; c < names.size(); ++c) {
+                    out += jsonKeys.at(c);
+                    appendJsonValue(out, q.value(c));
+                }
+                out += "}\n";
+            }
+            if (!writer->rowDone()) {
+                writeFailed = true;
+                return false;
+            }
+            if (++report.rows % progressEvery == 0 && onProgress) {
+                updateTiming(writer);
+                onProgress(report);
+            }
+            return !cancelled;
+        }, &names);
+        if (!headerDone && csv) writeHeader(); // 空表也写表头
+
+        if (writeFailed) report.error = "write error";
+        else if (!ok) report.error = QString("query error on %1").arg(datasetName(dataset));
+
+        // CSV 每个数据集一个文件，JSONL 所有数据集一个文件
+        const bool lastForFile = csv || i == opts.datasets.size() - 1;
+        if (lastForFile && report.error.isEmpty() && !cancelled) {
+            if (!writer->finish()) report.error = "write error";
+            bytesBefore += writer->bytes();
+            writer = nullptr;
+        }
+    }
+
+    // 全部写完才替换目标文件；某个文件提交失败时删掉已经提交的，不留下只有一部分数据集的结果
+    bool commitOk = report.error.isEmpty() && !cancelled;
+    QStringList committed;
+    for (const auto &w : writers) {
+        if (!commitOk) {
+            w->discard();
+        } else if (w->commit()) {
+            committed << w->fileName();
+        } else {
+            commitOk = false;
+            report.error = QString("cannot commit %1").arg(w->fileName());
+        }
+    }
+    if (!commitOk) {
+        for (const QString &path : committed) QFile::remove(path);
+    }
+
+    report.cancelled = cancelled;
+    if (report.cancelled || !report.error.isEmpty()) report.files.clear();
+    updateTiming(nullptr);
+    report.peakRssKiB = peakRssKiB();
+    qDebug() << "RecordExporter:" << report.rows << "rows" << report.bytes << "bytes in" << report.elapsedMs << "ms,"
+             << report.rowsPerSec << "rows/s, peak RSS" << report.peakRssKiB << "KiB";
+    return report;
+}
+
+std::shared_ptr<RecordExporter> RecordExporter::start(const Options &options, QObject *context,
+                                                      std::function<void(Report)> done)
+{
+    std::shared_ptr<RecordExporter> exporter = std::make_shared<RecordExporter>(options);
+    QPointer<QObject> guard(context);
+    QThread *thread = QThread::create([exporter, guard, done] {
+        const Report report = exporter->run();
+        // 投递到主线程，在那里再看 context 还在不在；导出线程里不碰 guard
+        QMetaObject::invokeMethod(QCoreApplication::instance(), [guard, done, report]() {
+            if (guard) done(report);
+        }, Qt::QueuedConnection);
+    });
+    thread->setObjectName("RecordExporter");
+    QObject::connect(thread, &QThread::finished, thread, &QObject::deleteLater);
+    thread->start();
+    return exporter;
+}
@@ -0,0 +1,71 @@
+#ifndef RECORDEXPORTER_H
+#define RECORDEXPORTER_H
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <atomic>
+#include <functional>
+#include <memory>
+
+// 病历 / 诊断 / 医嘱 / 处方导出为 CSV 或 JSONL，带患者和医生姓名。
+// 用只进游标逐行读、经缓冲区分块写文件，内存占用与表的行数无关。
+// patientId 非 0 时只导出这个患者的记录（按时间顺序），否则导出整张表（按 id）。
+//
+// JSONL：所有数据集写进同一个文件，每行带 "record_type"。
+// CSV：每个数据集的列不同，多个数据集时分别写到 <文件名>_<数据集>.csv。
+// 所有文件都写完才一起替换目标文件；失败或取消时不留下任何输出文件。
+class RecordExporter
+{
+public:
+    enum Dataset { MedicalCases, Diagnoses, MedicalOrders, Prescriptions };
+    enum Format { Csv, JsonLines };
+
+    struct Options {
+        QString outputPath;
+        Format format = JsonLines;
+        QVector<Dataset> datasets = { MedicalCases, Diagnoses, MedicalOrders, Prescriptions };
+        int patientId = 0;
+        int bufferBytes = 1024 * 1024;   // 攒够这么多字节写一次文件
+        qint64 progressEvery = 100000;   // 每多少行回调一次进度
+    };
+
+    struct Report {
+        qint64 rows = 0;
+        qint64 bytes = 0;
+        qint64 elapsedMs = 0;
+        double rowsPerSec = 0;
+        double mibPerSec = 0;
+        qint64 peakRssKiB = 0;           // 进程峰值常驻内存，取不到时为 0
+        QStringList files;
+        bool cancelled = false;
+        QString error;
+    };
+
+    explicit RecordExporter(const Options &options);
+
+    // 阻塞直到导出结束，使用调用线程的 Database 连接：不要在 UI 线程调用。
+    // onProgress 在调用线程里调用
+    Report run(std::function<void(const Report &)> onProgress = nullptr);
+
+    // 在新线程里导出，结束后在主线程调用 done（context 被销毁则不回调；context 须属于主线程）。
+    // 返回的导出器可以用来 cancel()，之后 done 收到 cancelled 为 true 的 Report
+    static std::shared_ptr<RecordExporter> start(const Options &options, QObject *context,
+                                                 std::function<void(Report)> done);
+
+    // 可以在任何线程调用
+    void cancel() { cancelled = true; }
+
+    static QString datasetName(Dataset dataset);
+    static qint64 peakRssKiB();
+
+private:
+    QString outputFor(Dataset dataset) const;
+    QString sqlFor(Dataset dataset) const;
+
+    Options opts;
+    std::atomic<bool> cancelled{false};
+};
+
+#endif // RECORDEXPORTER_H
@@ -0,0 +1,195 @@
+#ifndef RECORDS_H
+#define RECORDS_H
+#include<QDate>
+#include<QDateTime>
+#include<QString>
+
+// 业务表对应的简单结构体。id 为 0 表示还没有写入数据库（或可空外键为 NULL）。
+// 时间都是 UTC 的 QDateTime，日期是 QDate；库里的整数表示见 sqltime.h
+
+struct UserRecord
+{
+    int id = 0;
+    QString username;
+    QString email;
+    QString passwordHash;
+    QString role;
+    bool isActive = true;
+    QDateTime createdAt;
+};
+
+struct PatientRecord
+{
+    int id = 0;
+    QString fullName;
+    QDate dateOfBirth;
+    QString idNumber;
+    QString phone;
+    QString post;
+    QString gender;
+    QDateTime createdAt;
+};
+
+struct DoctorRecord
+{
+    int id = 0;
+    QString fullName;
+    QString phone;
+    QString specialty;
+    QString licenseNumber;
+    QString clinicAddress;
+    QDateTime createdAt;
+};
+
+struct AppointmentRecord
+{
+    int id = 0;
+    int patientId = 0;
+    int doctorId = 0;
+    QDateTime scheduledAt;
+    int durationMinutes = 30;
+    QString status;
+    QString reason;
+    QDateTime createdAt;
+};
+
+struct DiagnosisRecord
+{
+    int id = 0;
+    int caseId = 0;
+    int appointmentId = 0;
+    int doctorId = 0;
+    int patientId = 0;
+    QString diagnosisText;
+    QString icdCodes;
+};
+
+struct MedicalOrderRecord
+{
+    int id = 0;
+    int diagnosisId = 0;
+    int doctorId = 0;
+    int patientId = 0;
+    QString orderText;
+    QString orderType;
+    QString status;
+};
+
+struct PrescriptionRecord
+{
+    int id = 0;
+    int diagnosisId = 0;
+    int doctorId = 0;
+    int patientId = 0;
+    QString medicationName;
+    QString dosage;
+    QString frequency;
+    QString duration;
+    QString notes;
+    QDateTime issuedAt;
+};
+
+// 患者时间线上的一条记录（预约 / 病历 / 诊断 / 医嘱 / 处方），各表的列统一成下面几个字段
+struct TimelineEvent
+{
+    enum Type { Appointment = 1, MedicalCase = 2, Diagnosis = 3, MedicalOrder = 4, Prescription = 5 };
+    enum TypeMask {
+        AppointmentMask  = 1 << Appointment,
+        MedicalCaseMask  = 1 << MedicalCase,
+        DiagnosisMask    = 1 << Diagnosis,
+        MedicalOrderMask = 1 << MedicalOrder,
+        PrescriptionMask = 1 << Prescription,
+        AllTypes = AppointmentMask | MedicalCaseMask | DiagnosisMask | MedicalOrderMask | PrescriptionMask,
+    };
+    Type type = Appointment;
+    int id = 0;            // 对应表的 id
+    QDateTime at;          // 预约时间 / 创建时间 / 开具时间
+    int doctorId = 0;
+    QString title;         // 预约原因 / 病历标题 / 诊断 / 医嘱内容 / 药名
+    QString detail;        // 病历描述 / ICD 编码 / 医嘱类型 / 剂量 频次 疗程
+    QString status;        // 预约和医嘱的状态，其他为空
+    int parentId = 0;      // 诊断所属病历；医嘱、处方所属诊断
+};
+
+// 全文检索的一条结果
+struct SearchHit
+{
+    int docType = 0;   // FullTextSearch::DocType：病历 / 诊断 / 处方
+    int docId = 0;     // 对应表的 id
+    int patientId = 0;
+    double score = 0;  // bm25，越小越相关
+    QString snippet;
+};
+
+// 统计汇总（见 aggregates.h）：某医生某一天某个状态的预约数
+struct AppointmentDayCount
+{
+    int doctorId = 0;
+    QDate day;        // 本地日期
+    QString status;   // NULL 的状态是空串
+    qint64 count = 0;
+};
+
+// 统计汇总：药名 / ICD 编码及其次数
+struct NamedCount
+{
+    QString name;
+    qint64 count = 0;
+};
+
+// 有某个 ICD 编码的患者（diagnosis_codes 按患者分组）
+struct IcdPatientHit
+{
+    int patientId = 0;
+    qint64 diagnoses = 0;       // 带这个编码的诊断条数
+    QDateTime lastDiagnosedAt;
+};
+
+// ICD 编码按前缀分组的汇总
+struct IcdRollup
+{
+    QString prefix;             // 编码的前 groupLength 个字符
+    qint64 diagnoses = 0;
+    qint64 patients = 0;        // 不同患者数
+};
+
+// audit_logs 一行。action / objectType 必须是字符串字面量（只存指针，记录时不分配内存）
+struct AuditRecord
+{
+    int userId = 0;              // 0：由 AuditLog 填当前登录用户
+    const char *action = "";
+    const char *objectType = "";
+    qint64 objectId = 0;         // 0 存 NULL
+    QString details;
+    qint64 createdAtMs = 0;      // 事件发生时间（UTC 毫秒；audit_logs 里只存到秒）
+};
+
+// 患者的部分更新：只有 set 过的列会写入，列名固定，不接受外部传入的列名。
+// set 一个 null 的 QString / 无效的 QDate 表示清空（写 NULL）
+struct PatientUpdate
+{
+    enum Field {
+        FullName    = 1 << 0,
+        DateOfBirth = 1 << 1,
+        IdNumber    = 1 << 2,
+        Phone       = 1 << 3,
+        Post        = 1 << 4,
+        Gender      = 1 << 5,
+    };
+    int fields = 0;
+    QString fullName;
+    QDate dateOfBirth;
+    QString idNumber;
+    QString phone;
+    QString post;
+    QString gender;
+
+    void setFullName(const QString &v) { fullName = v; fields |= FullName; }
+    void setDateOfBirth(const QDate &v) { dateOfBirth = v; fields |= DateOfBirth; }
+    void setIdNumber(const QString &v) { idNumber = v; fields |= IdNumber; }
+    void setPhone(const QString &v) { phone = v; fields |= Phone; }
+    void setPost(const QString &v) { post = v; fields |= Post; }
+    void setGender(const QString &v) { gender = v; fields |= Gender; }
+};
+
+#endif // RECORDS_H
@@ -1,7 +1,7 @@
 #include "register.h"
 #include "ui_register.h"
 #include <QMessageBox>
-#include "database.h"
+#include "asyncdatabase.h"
 
 Register::Register(QWidget *parent)
     : QWidget(parent), ui(new Ui::Register)
@@ -28,55 +28,45 @@ void Register::onRegOKClicked()
         return;
     }
 
-    Database db;
-    QVariantMap u;
-    if (db.findUserByUsername(user, u)) {
-        QMessageBox::warning(this, "注册失败", "用户名已存在！");
-        return;
-    }
-
-    // ① 插入 users 表
-    if (!db.insertUser(user, "", pwd, role)) {
-        QMessageBox::warning(this, "注册失败", "写入用户表失败！");
-        return;
-    }
-
-    // ② 查出刚插入的 userId
-    if (!db.findUserByUsername(user, u)) {
-        QMessageBox::warning(this, "注册失败", "无法获取用户信息！");
-        return;
-    }
-    int userId = u["id"].toInt();
-
-    // ③ 获取 UI 上有的值
+    // 获取 UI 上有的值（后台线程不能访问控件，先取出来）
     QString age        = ui->lineEdit_age->text().trimmed();
     QString idNumber   = ui->lineEdit_IDNumber->text().trimmed();
     QString phone      = ui->lineEdit_PhoneNumber->text().trimmed();
     QString address    = ui->lineEdit_address->text().trimmed();
+    QString gender     = ui->comboBox_gender->currentText();
 
-    // ④ 根据角色插入 patients 或 doctors 表
-    if (role == "患者") {
-        QString fullName = ui->lineEdit_regUse->text().trimmed();      // 先用用户名顶替姓名
-        QString birth    = "";         //没生日先空着
-        QString gender   = ui->comboBox_gender->currentText();       // 你没性别输入，先空着
+    RegistrationRequest req;
+    req.username = user;
+    req.password = pwd;
+    req.role = role;
+    req.fullName = user;            // 先用用户名顶替姓名
+    req.phone = phone;
+    req.idNumber = idNumber;        // 没生日输入，dateOfBirth 先空着
+    req.post = address;
+    req.gender = gender;
+    req.clinicAddress = address;    // 没科室、执业证号输入，先空着
 
-        if (!db.insertPatient(fullName, birth, idNumber, phone, address, gender)) {
-            QMessageBox::warning(this, "注册失败", "写入患者表失败！");
+    // 密码哈希在哈希线程池里算，整个注册在数据库后台线程的一个事务里完成
+    ui->pushButton_regOK->setEnabled(false);
+    AsyncDatabase::instance().registerAccount(req, this, [this](RegistrationResult r) {
+        ui->pushButton_regOK->setEnabled(true);
+        switch (r.status) {
+        case RegistrationResult::Ok:
+            QMessageBox::information(this, "注册成功", "用户已注册并同步到对应表！");
+            this->close();
             return;
-        }
-    } else if (role == "医生") {
-        QString fullName = ui->lineEdit_regUse->text().trimmed();     // 先用用户名顶替姓名
-        QString specialty     = "";     // 没科室输入，先空着
-        QString licenseNumber = "";     // 没执业证号输入，先空着
-        QString clinicAddress = address;// 用输入的地址
-        QString gender   = ui->comboBox_gender->currentText();
-
-        if (!db.insertDoctor(userId, fullName, phone, specialty, licenseNumber, clinicAddress)) {
-            QMessageBox::warning(this, "注册失败", "写入医生表失败！");
+        case RegistrationResult::UsernameTaken:
+            QMessageBox::warning(this, "注册失败", "用户名已存在！");
+            return;
+        case RegistrationResult::IdNumberTaken:
+            QMessageBox::warning(this, "注册失败", "身份证号已被注册！");
+            return;
+        case RegistrationResult::LicenseTaken:
+            QMessageBox::warning(this, "注册失败", "执业证号已被使用！");
+            return;
+        case RegistrationResult::Error:
+            QMessageBox::warning(this, "注册失败", "写入数据库失败！");
             return;
         }
-    }
-
-    QMessageBox::information(this, "注册成功", "用户已注册并同步到对应表！");
-    this->close();
+    });
 }
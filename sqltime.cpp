@@ -0,0 +1,98 @@
+#include "sqltime.h"
+#include <QSqlRecord>
+
+namespace {
+// QDate::toJulianDay() 与 1970-01-01 的差
+const qint64 kEpochJulianDay = 2440588;
+}
+
+QVariant SqlTime::toSql(const QDateTime &t)
+{
+    return t.isValid() ? QVariant(t.toSecsSinceEpoch()) : QVariant();
+}
+
+QVariant SqlTime::toSql(const QDate &d)
+{
+    return d.isValid() ? QVariant(d.toJulianDay() - kEpochJulianDay) : QVariant();
+}
+
+QDateTime SqlTime::dateTime(const QVariant &v)
+{
+    if (v.isNull()) return QDateTime();
+    bool ok = false;
+    const qint64 secs = v.toLongLong(&ok);
+    return ok ? QDateTime::fromSecsSinceEpoch(secs, Qt::UTC) : QDateTime();
+}
+
+QDate SqlTime::date(const QVariant &v)
+{
+    if (v.isNull()) return QDate();
+    bool ok = false;
+    const qint64 days = v.toLongLong(&ok);
+    return ok ? QDate::fromJulianDay(days + kEpochJulianDay) : QDate();
+}
+
+QDate SqlTime::parseDate(const QString &text)
+{
+    const QString s = text.trimmed();
+    if (s.isEmpty()) return QDate();
+    for (const char *fmt : { "yyyy-MM-dd", "yyyy/M/d", "yyyy-M-d", "yyyyMMdd", "yyyy.M.d" }) {
+        const QDate d = QDate::fromString(s, fmt);
+        if (d.isValid()) return d;
+    }
+    const QDateTime t = parseDateTime(s);
+    return t.isValid() ? t.date() : QDate();
+}
+
+QDateTime SqlTime::parseDateTime(const QString &text)
+{
+    QString s = text.trimmed();
+    if (s.isEmpty()) return QDateTime();
+    // "yyyy-MM-dd HH:mm:ss"（CURRENT_TIMESTAMP 的格式）按 ISO 8601 解析
+    if (s.size() > 10 && s.at(10) == QLatin1Char(' ')) s[10] = QLatin1Char('T');
+    QDateTime t = QDateTime::fromString(s, Qt::ISODateWithMs);
+    if (!t.isValid()) return QDateTime();
+    if (t.timeSpec() == Qt::LocalTime) t.setTimeSpec(Qt::UTC);
+    return t;
+}
+
+SqlTime::Kind SqlTime::kindOf(const QString &columnName)
+{
+    if (columnName == QLatin1String("date_of_birth")) return Date;
+    if (columnName.endsWith(QLatin1String("_at"))) return Timestamp;
+    return None;
+}
+
+QVariant SqlTime::display(Kind kind, const QVariant &raw)
+{
+    switch (kind) {
+    case Timestamp: {
+        const QDateTime t = dateTime(raw);
+        return t.isValid() ? QVariant(t.toLocalTime().toString("yyyy-MM-dd HH:mm:ss")) : QVariant();
+    }
+    case Date: {
+        const QDate d = date(raw);
+        return d.isValid() ? QVariant(d.toString(Qt::ISODate)) : QVariant();
+    }
+    case None:
+        break;
+    }
+    return raw;
+}
+
+void TimestampQueryModel::queryChange()
+{
+    const QSqlRecord rec = record();
+    kinds.resize(rec.count());
+    for (int i = 0; i < rec.count(); ++i) kinds[i] = SqlTime::kindOf(rec.fieldName(i));
+}
+
+QVariant TimestampQueryModel::data(const QModelIndex &item, int role) const
+{
+    const int col = item.column();
+    if (col < 0 || col >= kinds.size() || kinds.at(col) == SqlTime::None || (role != Qt::DisplayRole && role != Qt::UserRole))
+        return QSqlQueryModel::data(item, role);
+    const QVariant raw = QSqlQueryModel::data(item, Qt::DisplayRole);
+    if (role == Qt::DisplayRole) return SqlTime::display(kinds.at(col), raw);
+    return kinds.at(col) == SqlTime::Date ? QVariant(SqlTime::date(raw)) : QVariant(SqlTime::dateTime(raw));
+}
@@ -0,0 +1,53 @@
+#ifndef SQLTIME_H
+#define SQLTIME_H
+
+#include <QDate>
+#include <QDateTime>
+#include <QSqlQueryModel>
+#include <QString>
+#include <QVariant>
+#include <QVector>
+
+// 库里的时间都是整数（schema v6 起）：
+//   时间戳（created_at / scheduled_at / issued_at / updated_at）= Unix 秒，UTC
+//   日期（date_of_birth）= 1970-01-01 起的天数
+// 接口上一律用 QDateTime / QDate，只在绑定参数、读取结果和模型显示时经过这里转换
+class SqlTime
+{
+public:
+    enum Kind { None, Timestamp, Date };
+
+    // 绑定参数：无效值存 NULL
+    static QVariant toSql(const QDateTime &t);
+    static QVariant toSql(const QDate &d);
+    static qint64 toEpoch(const QDateTime &t) { return t.toSecsSinceEpoch(); }
+    static qint64 now() { return QDateTime::currentSecsSinceEpoch(); }
+
+    // 读取结果：NULL 得到无效值
+    static QDateTime dateTime(const QVariant &v);
+    static QDate date(const QVariant &v);
+
+    // 外部输入（导入文件、旧接口的字符串）：接受 yyyy-MM-dd、yyyy/M/d、yyyyMMdd，以及带时间的 ISO 8601
+    static QDate parseDate(const QString &text);
+    static QDateTime parseDateTime(const QString &text); // 没有时区的按 UTC
+
+    // 模型显示：按列名判断类型（*_at 是时间戳，date_of_birth 是日期），显示为本地时间
+    static Kind kindOf(const QString &columnName);
+    static QVariant display(Kind kind, const QVariant &raw);
+};
+
+// QSqlQueryModel 的显示层：时间列显示成本地时间字符串，Qt::UserRole 返回 QDateTime / QDate
+class TimestampQueryModel : public QSqlQueryModel
+{
+public:
+    using QSqlQueryModel::QSqlQueryModel;
+    QVariant data(const QModelIndex &item, int role = Qt::DisplayRole) const override;
+
+protected:
+    void queryChange() override;
+
+private:
+    QVector<SqlTime::Kind> kinds;
+};
+
+#endif // SQLTIME_H